@@ -7,7 +7,9 @@
 #include "tntn/SurfacePoints.h"
 #include "tntn/Mesh.h"
 
+#include <array>
 #include <random>
+#include <vector>
 
 namespace tntn {
 namespace terra {
@@ -15,10 +17,29 @@ namespace terra {
 class DelaunayMesh
 {
   private:
-    std::shared_ptr<ObjPool<QuadEdge>> m_edges;
+    QuadEdgeStore m_edges;
     std::shared_ptr<ObjPool<DelaunayTriangle>> m_triangles;
     std::mt19937 m_random_gen;
 
+    DelaunayTriangle& triangle(dt_ptr t) const { return (*m_triangles)[t.index()]; }
+
+    // corners passed to init_mesh
+    BBox2D m_domain;
+
+    // edges near the cells of a grid over m_domain, start points for locate,
+    // empty unless enable_hint_grid was called
+    std::vector<qe_ptr> m_hints;
+    int m_hints_width = 0;
+    int m_hints_height = 0;
+    double m_hints_scale = 0.0;
+
+    qe_ptr* hint_cell(const Point2D& x);
+
+    // moves the anchor of t away from e, e is about to be deleted
+    void dont_anchor(dt_ptr t, qe_ptr e);
+    // makes t the left face of e and the other edges of its left ring
+    void reshape(dt_ptr t, qe_ptr e);
+
   protected:
     qe_ptr m_starting_edge;
     dt_ptr m_first_face;
@@ -33,6 +54,16 @@ class DelaunayMesh
     bool ccw_boundary(qe_ptr e);
     bool on_edge(const Point2D, qe_ptr e);
 
+    bool rightOf(const Point2D& x, qe_ptr e) const
+    {
+        return terra::rightOf(x, m_edges.Org(e), m_edges.Dest(e));
+    }
+
+    bool leftOf(const Point2D& x, qe_ptr e) const
+    {
+        return terra::leftOf(x, m_edges.Org(e), m_edges.Dest(e));
+    }
+
     unsigned int next_random_number()
     {
         return m_random_gen() % std::numeric_limits<unsigned int>::max();
@@ -40,16 +71,26 @@ class DelaunayMesh
 
   public:
     DelaunayMesh() :
-        m_edges(ObjPool<QuadEdge>::create()),
         m_triangles(ObjPool<DelaunayTriangle>::create()),
         m_random_gen(42) //fixed seed for deterministics sequence of random numbers
     {
-        m_edges->reserve(4096);
+        m_edges.reserve(1024);
         m_triangles->reserve(1024);
     }
 
     void init_mesh(const Point2D a, const Point2D b, const Point2D c, const Point2D d);
 
+    /**
+     keeps a grid of cell_size x cell_size cells over the mesh, each with an edge
+     near the points last inserted into it
+
+     locate(x) without a starting edge then walks from the edge of x's cell instead
+     of from the last located edge. This pays off when consecutive insertions are
+     far apart and no triangle near x is known, e.g. when inserting a list of points.
+     Call after init_mesh.
+    */
+    void enable_hint_grid(double cell_size);
+
     // convenience function using our 2D bounding box
     void init_mesh(const BBox2D& bb)
     {
@@ -70,10 +111,32 @@ class DelaunayMesh
     qe_ptr spoke(const Point2D x, qe_ptr e);
     void optimize(const Point2D x, qe_ptr e);
 
-    qe_ptr locate(const Point2D x) { return locate(x, m_starting_edge); }
+    qe_ptr locate(const Point2D x);
     qe_ptr locate(const Point2D, qe_ptr hint);
     void insert(const Point2D x, dt_ptr tri);
 
+    /**
+     exports the triangulation as indexed faces
+
+     points are the distinct integer corners of all triangles in row-major order
+     (sorted by y, then x), faces index into points and are oriented like the
+     faces of Mesh (clockwise in raster coordinates).
+    */
+    void export_indexed(std::vector<glm::ivec2>& points, std::vector<Face>& faces);
+
+    // face after t in the list of all faces, starting at m_first_face
+    dt_ptr next_face(dt_ptr t) const { return triangle(t).next_face; }
+
+    // corners of t, starting at the origin of its anchor edge
+    std::array<Point2D, 3> triangle_points(dt_ptr t) const
+    {
+        const qe_ptr anchor = triangle(t).anchor;
+        return {{m_edges.Org(anchor), m_edges.Dest(anchor), m_edges.Org(m_edges.Lprev(anchor))}};
+    }
+
+    ObjPool<QuadEdge>::Stats edge_stats() const { return m_edges.stats(); }
+    ObjPool<DelaunayTriangle>::Stats triangle_stats() const { return m_triangles->stats(); }
+
     //void overEdges(edge_callback, void *closure=NULL);
     //void overFaces(face_callback, void *closure=NULL);
 };
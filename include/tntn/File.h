@@ -160,11 +160,48 @@ class MemoryFile : public FileLike
 
     void flush() override {}
 
+    const std::vector<unsigned char>& data() const { return m_data; }
+
   private:
     std::vector<unsigned char> m_data;
     bool m_is_good = true;
 };
 
+/**
+ read-only memory mapping of a whole file
+
+ pages are loaded by the OS on first access, so reading through data()
+ needs neither copies nor buffers
+*/
+class MappedFile
+{
+  private:
+    //disallow copy and assign
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+
+  public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    bool open(const char* filename);
+    bool open(const std::string& filename);
+    void close();
+
+    std::string name() const { return m_filename; }
+    bool is_good() const { return m_is_open; }
+
+    // nullptr for empty files
+    const unsigned char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+  private:
+    const unsigned char* m_data = nullptr;
+    size_t m_size = 0;
+    bool m_is_open = false;
+    std::string m_filename;
+};
+
 FileLike::position_type getline(FileLike::position_type from_offset,
                                 FileLike& f,
                                 std::string& str);
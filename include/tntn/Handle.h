@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+namespace tntn {
+
+/**
+ 32 bit reference to an element of a container owned by someone else
+
+ Unlike pool_ptr a Handle doesn't know its container, so it is only a quarter
+ of the size. Handles are dereferenced by the owner of the elements
+ (e.g. terra::QuadEdgeStore), without checks in release builds.
+ T only keeps handles to different kinds of elements apart, it may be incomplete.
+*/
+template<typename T>
+class Handle
+{
+  public:
+    Handle() = default;
+    explicit Handle(const uint32_t index) noexcept : m_index(index) {}
+
+    uint32_t index() const noexcept { return m_index; }
+
+    void clear() noexcept { m_index = invalid_index; }
+
+    bool is_valid() const noexcept { return m_index != invalid_index; }
+    explicit operator bool() const noexcept { return is_valid(); }
+
+    bool operator==(const Handle& other) const noexcept { return m_index == other.m_index; }
+    bool operator!=(const Handle& other) const noexcept { return m_index != other.m_index; }
+    //for use in std::map/std::set
+    bool operator<(const Handle& other) const noexcept { return m_index < other.m_index; }
+
+  private:
+    enum : uint32_t
+    {
+        invalid_index = 0xffffffff
+    };
+
+    uint32_t m_index = invalid_index;
+};
+
+} //namespace tntn
+
+namespace std {
+template<typename T>
+struct hash<::tntn::Handle<T>>
+{
+    std::size_t operator()(const ::tntn::Handle<T>& h) const noexcept
+    {
+        return std::hash<uint32_t>()(h.index());
+    }
+};
+} //namespace std
@@ -2,6 +2,8 @@
 
 #include "glm/glm.hpp"
 
+#include <cstddef>
+
 namespace tntn {
 
 #define R_EARTH 6378137.0
@@ -45,4 +47,16 @@ class MercatorProjection
     BoundingBox TileBounds(const int _tx, const int _ty, const int _zoom) const;
 };
 
+/**
+ converts Web Mercator (EPSG:3857) metres with a height above the WGS84 ellipsoid
+ to earth-centered, earth-fixed coordinates (EPSG:4978)
+
+ Closed form of the transformation OGR does between the two EPSG codes,
+ it needs no projection database and is safe to call from any thread.
+*/
+glm::dvec3 web_mercator_to_ecef(const glm::dvec3& meters);
+
+// converts count points at once, in and out may be the same array
+void web_mercator_to_ecef(const glm::dvec3* in, size_t count, glm::dvec3* out);
+
 } //namespace tntn
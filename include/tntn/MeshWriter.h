@@ -2,6 +2,11 @@
 
 #include "tntn/geometrix.h"
 #include "tntn/Mesh.h"
+#include "tntn/File.h"
+
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace tntn {
 
@@ -9,6 +14,13 @@ class MeshWriter
 {
   public:
     virtual bool write_mesh_to_file(const char* filename, Mesh& mesh, const BBox3D& bbox) = 0;
+    virtual bool write_mesh(const std::shared_ptr<FileLike>& f,
+                            Mesh& mesh,
+                            const BBox3D& bbox) = 0;
+    // encodes into buffer, which is cleared first and may be reused between calls
+    virtual bool encode_mesh(Mesh& mesh,
+                             const BBox3D& bbox,
+                             std::vector<unsigned char>& buffer) = 0;
     virtual std::string file_extension() = 0;
     virtual ~MeshWriter(){};
 };
@@ -18,6 +30,12 @@ class ObjMeshWriter : public MeshWriter
     virtual bool write_mesh_to_file(const char* filename,
                                     Mesh& mesh,
                                     const BBox3D& bbox) override;
+    virtual bool write_mesh(const std::shared_ptr<FileLike>& f,
+                            Mesh& mesh,
+                            const BBox3D& bbox) override;
+    virtual bool encode_mesh(Mesh& mesh,
+                             const BBox3D& bbox,
+                             std::vector<unsigned char>& buffer) override;
 
     virtual std::string file_extension() override;
     virtual ~ObjMeshWriter(){};
@@ -28,6 +46,12 @@ class QuantizedMeshWriter : public MeshWriter
     virtual bool write_mesh_to_file(const char* filename,
                                     Mesh& mesh,
                                     const BBox3D& bbox) override;
+    virtual bool write_mesh(const std::shared_ptr<FileLike>& f,
+                            Mesh& mesh,
+                            const BBox3D& bbox) override;
+    virtual bool encode_mesh(Mesh& mesh,
+                             const BBox3D& bbox,
+                             std::vector<unsigned char>& buffer) override;
     virtual std::string file_extension() override;
     virtual ~QuantizedMeshWriter(){};
 };
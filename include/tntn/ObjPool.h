@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <utility>
 #include <memory>
@@ -70,6 +71,16 @@ class pool_ptr
     size_t m_index = invalid_index;
 };
 
+/**
+ pool of objects addressed by index
+
+ Objects live in chunks of CHUNK_SIZE elements which are never moved,
+ so growing the pool doesn't copy any objects and pointers to them stay valid.
+ Recycled slots go onto a free list and are reused by the next spawn().
+ A pool_ptr to a recycled object must not be dereferenced, the slot may
+ already hold another object.
+ T has to be default constructible and move assignable.
+*/
 template<typename T>
 class ObjPool
 {
@@ -87,25 +98,80 @@ class ObjPool
     };
 
   public:
+    enum : size_t
+    {
+        CHUNK_SIZE_LOG2 = 12,
+        CHUNK_SIZE = size_t(1) << CHUNK_SIZE_LOG2,
+    };
+
+    struct Stats
+    {
+        size_t live = 0;
+        size_t free = 0;
+        size_t peak_live = 0;
+        // slots in all allocated chunks
+        size_t capacity = 0;
+    };
+
     static std::shared_ptr<ObjPool> create() { return std::make_shared<ObjPool>(private_tag()); }
 
-    void reserve(size_t capacity) { m_pool.reserve(capacity); }
+    void reserve(size_t capacity)
+    {
+        while(m_chunks.size() * CHUNK_SIZE < capacity)
+        {
+            m_chunks.emplace_back(new T[CHUNK_SIZE]);
+        }
+    }
 
     template<typename... Args>
     pool_ptr<T> spawn(Args&&... args)
     {
-        m_pool.emplace_back(std::forward<Args>(args)...);
-        return pool_ptr<T>(this, m_pool.size() - 1);
+        size_t index;
+        if(!m_free.empty())
+        {
+            index = m_free.back();
+            m_free.pop_back();
+        }
+        else
+        {
+            index = m_size++;
+            reserve(m_size);
+        }
+
+        *get_addr(index) = T(std::forward<Args>(args)...);
+
+        m_live++;
+        m_peak_live = std::max(m_peak_live, m_live);
+        return pool_ptr<T>(this, index);
     }
 
+    // puts the object's slot onto the free list, every object may only be recycled once
     void recycle(const pool_ptr<T>& p)
     {
-        //noop until now - should be implemented with some kind of garbage collection and erase/remove-idiom
+        TNTN_ASSERT(contains(p));
+        TNTN_ASSERT(m_live > 0);
+        m_free.push_back(p.m_index);
+        m_live--;
     }
 
+    // object at the index of a pool_ptr, for owners that keep plain indices,
+    // unchecked in release builds
+    T& operator[](const size_t index) const { return *get_addr(index); }
+
+    // true if p points into this pool, recycled slots included
     bool contains(const pool_ptr<T>& p) const noexcept
     {
-        return p.m_pool == this && p.m_index < m_pool.size();
+        return p.m_pool == this && p.m_index < m_size;
+    }
+
+    Stats stats() const noexcept
+    {
+        Stats s;
+        s.live = m_live;
+        s.free = m_free.size();
+        s.peak_live = m_peak_live;
+        s.capacity = m_chunks.size() * CHUNK_SIZE;
+        return s;
     }
 
     //do not use this ctor, it's a workaround to make std::make_shared work
@@ -117,11 +183,16 @@ class ObjPool
 
     T* get_addr(size_t index) const
     {
-        TNTN_ASSERT(index < m_pool.size());
-        return const_cast<T*>(&m_pool[index]);
+        TNTN_ASSERT(index < m_size);
+        return &m_chunks[index >> CHUNK_SIZE_LOG2][index & (CHUNK_SIZE - 1)];
     }
 
-    std::vector<T> m_pool;
+    std::vector<std::unique_ptr<T[]>> m_chunks;
+    // slots handed out so far, recycled ones included
+    size_t m_size = 0;
+    size_t m_live = 0;
+    size_t m_peak_live = 0;
+    std::vector<size_t> m_free;
 };
 
 template<typename T>
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 #include "tntn/geometrix.h"
 #include "tntn/Mesh.h"
 
@@ -8,4 +9,18 @@ namespace tntn {
 bool generate_delaunay_faces(const std::vector<Vertex>& vlist, std::vector<Face>& faces);
 std::unique_ptr<Mesh> generate_delaunay_mesh(std::vector<Vertex>&& vlist);
 
+/**
+ finds points that have another point closer than precision in the xy plane
+
+ Of every group of such points only the one with the largest index is kept,
+ the others are returned in ascending order.
+ Runs in O(n log n) using a grid of precision sized cells.
+*/
+std::vector<int> check_duplicates(const std::vector<Vertex>& vlist,
+                                  double precision,
+                                  int num_threads = 1);
+
+// removes the vertices at the given indices, the remaining vertices keep their order
+void remove_duplicates(std::vector<Vertex>& vlist, const std::vector<int>& del);
+
 } // namespace tntn
@@ -1,7 +1,12 @@
 #pragma once
 
 #include "tntn/geometrix.h"
+#include "tntn/Handle.h"
 #include "tntn/ObjPool.h"
+#include "tntn/tntn_assert.h"
+
+#include <cstdint>
+#include <vector>
 
 #define EPS 1e-6
 
@@ -103,11 +108,12 @@ inline void Plane::init(const glm::dvec3& p, const glm::dvec3& q, const glm::dve
     c = p.z - _a * p.x - _b * p.y;
 }
 
-class DelaunayTriangle;
-typedef pool_ptr<DelaunayTriangle> dt_ptr;
+struct DelaunayTriangle;
+typedef Handle<DelaunayTriangle> dt_ptr;
 
-class QuadEdge;
-typedef pool_ptr<QuadEdge> qe_ptr;
+struct QuadEdge;
+// directed edge, the index of its QuadEdge record times 4 plus its rotation
+typedef Handle<QuadEdge> qe_ptr;
 
 //see http://www.cs.cmu.edu/afs/andrew/scs/cs/15-463/2001/pub/src/a2/quadedge.html
 /*
@@ -190,85 +196,226 @@ typedef pool_ptr<QuadEdge> qe_ptr;
 
  */
 
-class QuadEdge
+// an edge e0 together with its rotations e1 = e0->Rot, e2 = e0->Sym and e3 = e0->invRot
+struct QuadEdge
 {
-  private:
-    qe_ptr qnext; //aka Rot
-    qe_ptr qprev; //aka invRot
-    qe_ptr self_ptr;
-
-    QuadEdge(qe_ptr prev);
+    // Onext of each rotation
+    qe_ptr next[4];
+    // origin of e0 and e2, the dual edges e1 and e3 have none
+    Point2D org[2];
+    // face on the left of e0 and e2
+    dt_ptr lface[2];
+};
 
-  protected:
-    Point2D data;
-    qe_ptr next; //aka Onext
-    dt_ptr lface;
+/**
+ quad-edge algebra on top of a store of edges
 
+ Rot, invRot and Sym only change the rotation bits of an edge handle, the other
+ primitives are derived from Store::Onext and Store::set_Onext, without checks in
+ release builds. Only primal edges (rotation 0 or 2) have an origin and a left face.
+*/
+template<typename Store>
+class QuadEdgeAlgebra
+{
   public:
-    QuadEdge() = default;
-
-    void init(qe_ptr self_ptr);
-    void init(qe_ptr self_ptr, qe_ptr qprev);
-    void recycle_next();
-
     //"next" means next in a counterclockwise (ccw) sense around a neighboring face or vertex
     //"prev" means next in a clockwise (cw) sense around a neighboring face or vertex
 
     // Primitive methods
-    //next edge around origin, with same origin
-    qe_ptr Onext() const noexcept { return next; }
-
-    //edge pointing opposite to this
-    qe_ptr Sym() const { return qnext->qnext; }
+    //edge pointing opposite to e
+    static qe_ptr Sym(const qe_ptr e) noexcept { return qe_ptr(e.index() ^ 2u); }
 
-    //dual edge pointing to the left of this
-    qe_ptr Rot() const noexcept { return qnext; }
-    //dual edge pointing to the right of this
-    qe_ptr invRot() const noexcept { return qprev; }
+    //dual edge pointing to the left of e
+    static qe_ptr Rot(const qe_ptr e) noexcept { return rotate(e, 1); }
+    //dual edge pointing to the right of e
+    static qe_ptr invRot(const qe_ptr e) noexcept { return rotate(e, 3); }
 
     // Synthesized methods
-    qe_ptr Oprev() const { return Rot()->Onext()->Rot(); }
-    qe_ptr Dnext() const { return Sym()->Onext()->Sym(); }
-    qe_ptr Dprev() const { return invRot()->Onext()->invRot(); }
+    qe_ptr Oprev(const qe_ptr e) const { return Rot(store().Onext(Rot(e))); }
+    qe_ptr Dnext(const qe_ptr e) const { return Sym(store().Onext(Sym(e))); }
+    qe_ptr Dprev(const qe_ptr e) const { return invRot(store().Onext(invRot(e))); }
 
     //next edge around left face, with same left face
-    qe_ptr Lnext() const { return invRot()->Onext()->Rot(); }
+    qe_ptr Lnext(const qe_ptr e) const { return Rot(store().Onext(invRot(e))); }
     //prev edge around left face, with same left face
-    qe_ptr Lprev() const { return Onext()->Sym(); }
+    qe_ptr Lprev(const qe_ptr e) const { return Sym(store().Onext(e)); }
 
     //next edge around right face, with same right face
-    qe_ptr Rnext() const { return Rot()->Onext()->invRot(); }
+    qe_ptr Rnext(const qe_ptr e) const { return invRot(store().Onext(Rot(e))); }
     //prev edge around right face, with same right face
-    qe_ptr Rprev() const { return Sym()->Onext(); }
+    qe_ptr Rprev(const qe_ptr e) const { return store().Onext(Sym(e)); }
 
-    //origin point
-    Point2D Org() const noexcept { return data; }
     //destination point
-    Point2D Dest() const { return Sym()->data; }
+    Point2D Dest(const qe_ptr e) const { return store().Org(Sym(e)); }
 
-    //face on the left
-    dt_ptr Lface() const noexcept { return lface; }
-    void set_Lface(dt_ptr t) noexcept { lface = t; }
+    // The fundamental topological operator
+    void splice(const qe_ptr a, const qe_ptr b)
+    {
+        Store& s = static_cast<Store&>(*this);
+
+        const qe_ptr alpha = Rot(s.Onext(a));
+        const qe_ptr beta = Rot(s.Onext(b));
+
+        const qe_ptr t1 = s.Onext(b);
+        const qe_ptr t2 = s.Onext(a);
+        const qe_ptr t3 = s.Onext(beta);
+        const qe_ptr t4 = s.Onext(alpha);
+
+        s.set_Onext(a, t1);
+        s.set_Onext(b, t2);
+        s.set_Onext(alpha, t3);
+        s.set_Onext(beta, t4);
+    }
+
+  protected:
+    static uint32_t rotation(const qe_ptr e) noexcept { return e.index() & 3u; }
 
-    void set_end_points(const Point2D org, const Point2D dest)
+    static qe_ptr rotate(const qe_ptr e, const uint32_t r) noexcept
     {
-        data = org;
-        Sym()->data = dest;
+        return qe_ptr((e.index() & ~3u) | ((e.index() + r) & 3u));
     }
 
-    // The fundamental topological operator
-    friend void splice(qe_ptr a, qe_ptr b);
+    // 0 for e0, 1 for e2
+    static uint32_t primal_side(const qe_ptr e) noexcept
+    {
+        TNTN_ASSERT(rotation(e) % 2 == 0);
+        return rotation(e) >> 1;
+    }
+
+  private:
+    const Store& store() const { return static_cast<const Store&>(*this); }
 };
 
-inline bool rightOf(const Point2D& x, qe_ptr e)
+// edges stored as QuadEdge records in an ObjPool, points are stored per edge
+class QuadEdgePool : public QuadEdgeAlgebra<QuadEdgePool>
 {
-    return rightOf(x, e->Org(), e->Dest());
-}
+  public:
+    // vertices are referred to by their coordinates
+    typedef Point2D vertex_ref;
+
+    QuadEdgePool() : m_pool(ObjPool<QuadEdge>::create()) {}
+
+    void reserve(size_t edges) { m_pool->reserve(edges); }
+
+    // new edge that isn't connected to any other edge yet
+    qe_ptr make_edge();
+
+    // frees e and its rotations, e has to be spliced out of the subdivision before
+    void recycle_edge(qe_ptr e);
+
+    // false once e was recycled and until its record is handed out again
+    bool is_live(const qe_ptr e) const { return record(e).next[0].is_valid(); }
+
+    //next edge around origin, with same origin
+    qe_ptr Onext(const qe_ptr e) const { return record(e).next[rotation(e)]; }
+    void set_Onext(const qe_ptr e, const qe_ptr next) { record(e).next[rotation(e)] = next; }
+
+    static vertex_ref add_vertex(const Point2D p) noexcept { return p; }
+    vertex_ref org_vertex(const qe_ptr e) const { return Org(e); }
+    vertex_ref dest_vertex(const qe_ptr e) const { return Dest(e); }
+
+    //origin point
+    Point2D Org(const qe_ptr e) const { return record(e).org[primal_side(e)]; }
+
+    //face on the left
+    dt_ptr Lface(const qe_ptr e) const { return record(e).lface[primal_side(e)]; }
+    void set_Lface(const qe_ptr e, const dt_ptr t) { record(e).lface[primal_side(e)] = t; }
+
+    void set_end_points(const qe_ptr e, const vertex_ref org, const vertex_ref dest)
+    {
+        record(e).org[primal_side(e)] = org;
+        record(e).org[primal_side(Sym(e))] = dest;
+    }
+
+    ObjPool<QuadEdge>::Stats stats() const { return m_pool->stats(); }
+
+  private:
+    QuadEdge& record(const qe_ptr e) const { return (*m_pool)[e.index() >> 2]; }
+
+    std::shared_ptr<ObjPool<QuadEdge>> m_pool;
+};
+
+/**
+ edges stored as separate arrays indexed by edge handle, over a shared vertex array
 
-inline bool leftOf(const Point2D& x, qe_ptr e)
+ The walks in locate and optimize mostly follow Onext, which only touches the
+ array of next links, origins and faces are loaded when they are needed.
+ Vertices are never removed.
+*/
+class QuadEdgeArrays : public QuadEdgeAlgebra<QuadEdgeArrays>
 {
-    return leftOf(x, e->Org(), e->Dest());
-}
+  public:
+    // index into the vertex array
+    typedef uint32_t vertex_ref;
+
+    void reserve(size_t edges);
+
+    // new edge that isn't connected to any other edge yet
+    qe_ptr make_edge();
+
+    // frees e and its rotations, e has to be spliced out of the subdivision before
+    void recycle_edge(qe_ptr e);
+
+    // false once e was recycled and until its slots are handed out again
+    bool is_live(const qe_ptr e) const { return m_next[e.index() & ~3u].is_valid(); }
+
+    //next edge around origin, with same origin
+    qe_ptr Onext(const qe_ptr e) const { return m_next[e.index()]; }
+    void set_Onext(const qe_ptr e, const qe_ptr next) { m_next[e.index()] = next; }
+
+    vertex_ref add_vertex(const Point2D p)
+    {
+        TNTN_ASSERT(m_vertices.size() < 0xffffffff);
+        m_vertices.push_back(p);
+        return static_cast<vertex_ref>(m_vertices.size() - 1);
+    }
+    vertex_ref org_vertex(const qe_ptr e) const { return m_org[primal_slot(e)]; }
+    vertex_ref dest_vertex(const qe_ptr e) const { return org_vertex(Sym(e)); }
+
+    //origin point
+    Point2D Org(const qe_ptr e) const { return m_vertices[org_vertex(e)]; }
+
+    //face on the left
+    dt_ptr Lface(const qe_ptr e) const { return m_lface[primal_slot(e)]; }
+    void set_Lface(const qe_ptr e, const dt_ptr t) { m_lface[primal_slot(e)] = t; }
+
+    void set_end_points(const qe_ptr e, const vertex_ref org, const vertex_ref dest)
+    {
+        m_org[primal_slot(e)] = org;
+        m_org[primal_slot(Sym(e))] = dest;
+    }
+
+    ObjPool<QuadEdge>::Stats stats() const;
+
+  private:
+    // slot of a primal edge in m_org and m_lface
+    static size_t primal_slot(const qe_ptr e) noexcept
+    {
+        TNTN_ASSERT(rotation(e) % 2 == 0);
+        return e.index() >> 1;
+    }
+
+    // Onext per edge handle
+    std::vector<qe_ptr> m_next;
+    // origin and left face per primal edge
+    std::vector<vertex_ref> m_org;
+    std::vector<dt_ptr> m_lface;
+
+    std::vector<Point2D> m_vertices;
+
+    // first edge handles of recycled quad-edges
+    std::vector<uint32_t> m_free;
+    size_t m_peak_live = 0;
+};
+
+// set TNTN_QUADEDGE_SOA (cmake -DTNTN_QUADEDGE_SOA=ON) to mesh with QuadEdgeArrays instead of
+// QuadEdgePool, the meshes are the same, point location gets slightly faster while the
+// total run time usually stays the same
+#if defined(TNTN_QUADEDGE_SOA) && TNTN_QUADEDGE_SOA
+typedef QuadEdgeArrays QuadEdgeStore;
+#else
+typedef QuadEdgePool QuadEdgeStore;
+#endif
 
 } //namespace terra
 } //namespace tntn
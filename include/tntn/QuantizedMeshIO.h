@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <vector>
 
 #include "tntn/geometrix.h"
 #include "tntn/Mesh.h"
@@ -9,6 +10,9 @@
 
 namespace tntn {
 
+class QuantizedMeshView;
+struct QuantizedMeshHeader;
+
 namespace detail {
 //exposed for testing
 uint16_t zig_zag_encode(int16_t i);
@@ -17,6 +21,7 @@ int16_t zig_zag_decode(uint16_t i);
 } //namespace detail
 
 // unsigned int zig_zag_encode(int i);
+// the write_mesh_as_qm overloads encode the whole tile first and write it at once
 bool write_mesh_as_qm(const char* filename, const Mesh& m);
 bool write_mesh_as_qm(const char* filename,
                       const Mesh& m,
@@ -29,7 +34,26 @@ bool write_mesh_as_qm(const std::shared_ptr<FileLike>& f,
                       const BBox3D& bbox,
                       bool mesh_is_rescaled = false);
 
+/**
+ encodes a tile without writing it anywhere
+
+ @param buffer receives the encoded tile, it is cleared first and keeps its
+               capacity, so reusing it avoids allocations
+*/
+bool encode_mesh_as_qm(const Mesh& m,
+                       const BBox3D& bbox,
+                       bool mesh_is_rescaled,
+                       std::vector<unsigned char>& buffer);
+
+// header of a tile with the given bounds in Web Mercator metres,
+// false if the tile center has no ECEF coordinates (e.g. the bbox of an empty mesh)
+bool make_qm_header(const BBox3D& bbox, QuantizedMeshHeader& header);
+// headers for count tiles, converts all tile centers to ECEF in one batch
+bool make_qm_headers(const BBox3D* bboxes, size_t count, QuantizedMeshHeader* headers);
+
 std::unique_ptr<Mesh> load_mesh_from_qm(const char* filename);
 std::unique_ptr<Mesh> load_mesh_from_qm(const std::shared_ptr<FileLike>& f);
+// decodes a parsed tile, see QuantizedMeshView for access without decoding
+std::unique_ptr<Mesh> load_mesh_from_qm(const QuantizedMeshView& view);
 
 } // namespace tntn
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "tntn/File.h"
+#include "tntn/endianness.h"
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace tntn {
+
+typedef glm::dvec3 QMVertex;
+
+struct QuantizedMeshHeader
+{
+    // The center of the tile in Earth-centered Fixed coordinates.
+    // double CenterX;
+    // double CenterY;
+    // double CenterZ;
+
+    QMVertex center;
+
+    // The minimum and maximum heights in the area covered by this tile.
+    // The minimum may be lower and the maximum may be higher than
+    // the height of any vertex in this tile in the case that the min/max vertex
+    // was removed during mesh simplification, but these are the appropriate
+    // values to use for analysis or visualization.
+    float MinimumHeight;
+    float MaximumHeight;
+
+    // The tile’s bounding sphere.  The X,Y,Z coordinates are again expressed
+    // in Earth-centered Fixed coordinates, and the radius is in meters.
+    QMVertex bounding_sphere_center;
+    // double BoundingSphereCenterX;
+    // double BoundingSphereCenterY;
+    // double BoundingSphereCenterZ;
+    double BoundingSphereRadius;
+
+    // The horizon occlusion point, expressed in the ellipsoid-scaled Earth-centered Fixed frame.
+    // If this point is below the horizon, the entire tile is below the horizon.
+    // See http://cesiumjs.org/2013/04/25/Horizon-culling/ for more information.
+    QMVertex horizon_occlusion;
+    // double HorizonOcclusionPointX;
+    // double HorizonOcclusionPointY;
+    // double HorizonOcclusionPointZ;
+};
+
+/**
+ little endian array of 16 or 32 bit unsigned integers inside a quantized mesh buffer
+
+ elements are decoded on access, nothing is copied
+*/
+class QMArray
+{
+  public:
+    QMArray() = default;
+    QMArray(const unsigned char* data, size_t size, int element_bytes) :
+        m_data(data),
+        m_size(size),
+        m_element_bytes(element_bytes)
+    {
+    }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    int element_bytes() const { return m_element_bytes; }
+    // raw little endian bytes, not necessarily aligned
+    const unsigned char* data() const { return m_data; }
+
+    uint32_t operator[](const size_t i) const
+    {
+        const unsigned char* p = m_data + i * m_element_bytes;
+        return m_element_bytes == 2 ? load_little_endian<uint16_t>(p)
+                                    : load_little_endian<uint32_t>(p);
+    }
+
+  private:
+    const unsigned char* m_data = nullptr;
+    size_t m_size = 0;
+    int m_element_bytes = 2;
+};
+
+/**
+ zero-copy view of a quantized mesh tile
+
+ parse() only validates the layout and remembers where the arrays are,
+ the arrays still hold the encoded values (zig-zag deltas for vertices,
+ high-water mark codes for triangle indices).
+ Use load_mesh_from_qm(const QuantizedMeshView&) to decode a Mesh.
+*/
+class QuantizedMeshView
+{
+  public:
+    /**
+     parse a quantized mesh held in memory
+
+     @param data buffer that has to outlive the view
+     @param name used in error messages
+     @return false if the buffer does not contain a valid quantized mesh
+    */
+    bool parse(const unsigned char* data, size_t size, const std::string& name = std::string());
+
+    // maps the file and parses it, the view keeps the mapping alive
+    bool open(const std::string& filename);
+
+    const QuantizedMeshHeader& header() const { return m_header; }
+
+    uint32_t vertex_count() const { return static_cast<uint32_t>(m_u.size()); }
+    uint32_t triangle_count() const { return static_cast<uint32_t>(m_indices.size() / 3); }
+
+    // zig-zag encoded deltas of the quantized vertex coordinates
+    const QMArray& u() const { return m_u; }
+    const QMArray& v() const { return m_v; }
+    const QMArray& height() const { return m_height; }
+
+    // high-water mark encoded triangle indices, 3 per triangle
+    const QMArray& indices() const { return m_indices; }
+
+    // indices of the vertices on the tile edges
+    const QMArray& west_indices() const { return m_west; }
+    const QMArray& south_indices() const { return m_south; }
+    const QMArray& east_indices() const { return m_east; }
+    const QMArray& north_indices() const { return m_north; }
+
+    /**
+     calls f(u, v, height) with the quantized coordinates (0..32767) of every vertex
+
+     undoes the delta encoding on the fly without allocating memory
+    */
+    template<typename F>
+    void for_each_vertex(F&& f) const
+    {
+        int u = 0;
+        int v = 0;
+        int h = 0;
+        const size_t n = m_u.size();
+        for(size_t i = 0; i < n; i++)
+        {
+            u += zig_zag_decode(m_u[i]);
+            v += zig_zag_decode(m_v[i]);
+            h += zig_zag_decode(m_height[i]);
+            f(u, v, h);
+        }
+    }
+
+    // smallest and largest quantized height, false for tiles without vertices
+    bool quantized_height_range(int& min_height, int& max_height) const;
+
+    // height in the units of the header's MinimumHeight/MaximumHeight
+    double dequantize_height(int quantized_height) const;
+
+  private:
+    static int zig_zag_decode(const uint32_t i)
+    {
+        return static_cast<int16_t>(i >> 1) ^ -static_cast<int16_t>(i & 1);
+    }
+
+    std::shared_ptr<const MappedFile> m_file;
+    QuantizedMeshHeader m_header;
+    QMArray m_u;
+    QMArray m_v;
+    QMArray m_height;
+    QMArray m_indices;
+    QMArray m_west;
+    QMArray m_south;
+    QMArray m_east;
+    QMArray m_north;
+};
+
+} // namespace tntn
@@ -8,6 +8,9 @@
 #include <algorithm>
 #include <map>
 #include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
 
 #include "logging.h"
 
@@ -49,6 +52,49 @@ class NDVDefault<double>
     static void set(double& value) { value = std::numeric_limits<double>::max(); }
 };
 
+template<>
+class NDVDefault<float>
+{
+  public:
+    static void set(float& value) { value = std::numeric_limits<float>::max(); }
+};
+
+template<>
+class NDVDefault<int16_t>
+{
+  public:
+    static void set(int16_t& value) { value = std::numeric_limits<int16_t>::min(); }
+};
+
+// converts a double to a raster sample,
+// integer samples are rounded and clamped to the type's range
+template<typename T>
+inline T sample_cast(const double v) noexcept
+{
+    if(std::is_integral<T>::value)
+    {
+        if(std::isnan(v))
+        {
+            return 0;
+        }
+        const double lo = std::numeric_limits<T>::lowest();
+        const double hi = std::numeric_limits<T>::max();
+        return static_cast<T>(std::round(std::max(lo, std::min(hi, v))));
+    }
+    return static_cast<T>(v);
+}
+
+// true if sample_cast keeps the value unchanged
+template<typename T>
+inline bool sample_holds(const double v) noexcept
+{
+    if(std::isnan(v))
+    {
+        return !std::is_integral<T>::value;
+    }
+    return static_cast<double>(sample_cast<T>(v)) == v;
+}
+
 } // namespace detail
 
 // Terrain Raster
@@ -75,6 +121,8 @@ class Raster
     {
         std::swap(m_width, other.m_width);
         std::swap(m_height, other.m_height);
+        std::swap(m_stride, other.m_stride);
+        std::swap(m_is_view, other.m_is_view);
         std::swap(m_xpos, other.m_xpos);
         std::swap(m_ypos, other.m_ypos);
         std::swap(m_cellsize, other.m_cellsize);
@@ -91,7 +139,10 @@ class Raster
     {
         Raster ret;
         ret.allocate(m_width, m_height);
-        std::copy(get_ptr(), get_ptr() + m_width * m_height, ret.get_ptr());
+        for(unsigned int r = 0; r < m_height; r++)
+        {
+            std::copy(get_ptr(r), get_ptr(r) + m_width, ret.get_ptr(r));
+        }
         ret.copy_parameters(*this);
         return ret;
     }
@@ -126,6 +177,8 @@ class Raster
     {
         m_width = 0;
         m_height = 0;
+        m_stride = 0;
+        m_is_view = false;
         m_xpos = 0;
         m_ypos = 0;
         m_cellsize = 0;
@@ -143,6 +196,8 @@ class Raster
     {
         m_width = w;
         m_height = h;
+        m_stride = w;
+        m_is_view = false;
         alloc();
     }
 
@@ -151,7 +206,13 @@ class Raster
      
      @param value value to be set
     */
-    void set_all(T value) { std::fill(get_ptr(), get_ptr() + m_width * m_height, value); }
+    void set_all(T value)
+    {
+        for(unsigned int r = 0; r < m_height; r++)
+        {
+            std::fill(get_ptr(r), get_ptr(r) + m_width, value);
+        }
+    }
 
     /**
      count all ourrences of given value
@@ -163,11 +224,13 @@ class Raster
     {
         long count = 0;
 
-        T* pData = get_ptr(0);
-
-        for(int i = 0; i < m_width * m_height; i++)
+        for(unsigned int r = 0; r < m_height; r++)
         {
-            if(pData[i] == value) count++;
+            const T* pData = get_ptr(r);
+            for(unsigned int c = 0; c < m_width; c++)
+            {
+                if(pData[c] == value) count++;
+            }
         }
 
         return count;
@@ -293,6 +356,57 @@ class Raster
         return dst_raster;
     }
 
+    /**
+     sub raster sharing the pixels of this raster, nothing is copied
+
+     Same window and geo position as crop(cx, cy, cw, ch), parts of the window
+     outside of the raster are cut off. Rows of the view are get_stride() pixels
+     apart. Writes through the view change this raster and the other way round,
+     the pixels stay alive as long as the view does.
+
+     @param cx column of sub image top left corner
+     @param cy row of sub image top left corner (origin at TOP left)
+     @param cw width of sub image
+     @param ch height of sub image
+    */
+    Raster view(const int cx, const int cy, const int cw, const int ch) const
+    {
+        const int width = m_width;
+        const int height = m_height;
+
+        const int min_x = std::max(cx, 0);
+        const int min_y = std::max(cy, 0);
+        const int max_x = std::min(cx + cw, width);
+        const int max_y = std::min(cy + ch, height);
+
+        Raster dst_raster;
+        dst_raster.copy_parameters(*this);
+        dst_raster.set_pos_x(col2x(min_x) - 0.5 * get_cell_size());
+        dst_raster.set_pos_y(row2y(max_y - 1) - 0.5 * get_cell_size());
+
+        if(max_x <= min_x || max_y <= min_y)
+        {
+            return dst_raster;
+        }
+
+        dst_raster.m_width = max_x - min_x;
+        dst_raster.m_height = max_y - min_y;
+        dst_raster.m_stride = m_stride;
+        dst_raster.m_is_view = true;
+        // aliasing constructor, keeps all of this raster's pixels alive
+        dst_raster.m_data = std::shared_ptr<T>(m_data, get_ptr(min_y) + min_x);
+        return dst_raster;
+    }
+
+    // view of the whole raster
+    Raster view() const { return view(0, 0, m_width, m_height); }
+
+    /**
+     true if the pixels belong to another raster (see view)
+     and rows may not be contiguous
+    */
+    bool is_view() const { return m_is_view; }
+
     /**
      get bounding box of raster
 
@@ -371,16 +485,23 @@ class Raster
 
     /**
      get raw pointer to beginning of raster (top left is origin)
+     rows are get_stride() pixels apart
      @return raw pointer
     */
     T* get_ptr() const { return m_data.get(); }
 
+    /**
+     @return distance between the beginnings of two rows in pixels,
+     equals the width unless the raster is a view
+    */
+    size_t get_stride() const { return m_stride; }
+
     /**
      get raw pointer to beginning of raster row (top left is origin)
      @param r row
      @return raw pointer
     */
-    T* get_ptr(const unsigned int r) const { return m_data.get() + r * m_width; }
+    T* get_ptr(const unsigned int r) const { return m_data.get() + r * m_stride; }
 
     /**
      get raw pointer to beginning of raster row (lower left is origin)
@@ -389,7 +510,7 @@ class Raster
     */
     T* get_ptr_ll(const unsigned int r) const
     {
-        return m_data.get() + (m_height - 1 - r) * m_width;
+        return m_data.get() + (m_height - 1 - r) * m_stride;
     }
 
     /**
@@ -513,7 +634,7 @@ class Raster
                 receiver_fn(x_coordinate, y_coordinate, p[c]);
             }
 
-            p += width;
+            p += m_stride;
         }
     }
 
@@ -534,6 +655,10 @@ class Raster
     // raster width and height
     unsigned int m_width = 0;
     unsigned int m_height = 0;
+    // distance between rows in pixels
+    size_t m_stride = 0;
+    // pixels belong to another raster
+    bool m_is_view = false;
 
     // tile position in world coordinates
     double m_xpos = 0;
@@ -548,6 +673,8 @@ class Raster
 };
 
 typedef Raster<double> RasterDouble;
+typedef Raster<float> RasterFloat;
+typedef Raster<int16_t> RasterInt16;
 //typedef Raster<unsigned char>   RasterByte; //eg. for grey scale image
 
 } // namespace tntn
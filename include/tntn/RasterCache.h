@@ -0,0 +1,98 @@
+#pragma once
+
+#include "tntn/File.h"
+#include "tntn/RasterSource.h"
+
+#include <cstdint>
+#include <string>
+
+namespace tntn {
+
+constexpr int DEFAULT_RASTER_CACHE_BLOCK_SIZE = 256;
+
+// valid pixel range and no-data count of one block of a raster cache file,
+// min and max are the no-data value if the block has no valid pixel
+struct RasterBlockSummary
+{
+    double min;
+    double max;
+    uint32_t no_data_count;
+};
+
+/**
+ writes a source into a raster cache file (see RasterCacheSource)
+
+ Samples are stored with the source's native sample type, the source is read
+ one row of blocks at a time.
+
+ @param projection WKT of the raster's spatial reference, may be empty
+ @return false on read or write errors
+*/
+bool write_raster_cache(const RasterSource& source,
+                        const std::string& filename,
+                        const std::string& projection,
+                        int block_size = DEFAULT_RASTER_CACHE_BLOCK_SIZE);
+
+// true if the file starts like a complete raster cache file
+bool is_raster_cache_file(const std::string& filename);
+
+/**
+ memory mapped raster cache file
+
+ The raster is stored in the orientation RasterSource presents (row 0 is the top row),
+ so pixels are copied out of the mapping without flips or decoding and opening
+ the file costs no more than mapping it.
+
+ Layout, all numbers little endian:
+   header     "TNTNRAST", uint32 version, uint32 sample type, uint32 width, uint32 height,
+              uint32 block width, uint32 block height, double pos x, double pos y,
+              double cell size, double no-data value, uint32 projection size
+   projection WKT, projection size bytes
+   summaries  per block: double min, double max, uint32 no-data count
+   blocks     at the next multiple of 4096 bytes, per block block width * block height
+              samples row by row, blocks on the right and bottom edge padded with no-data
+
+ Blocks and summaries are ordered row by row starting at the top left block.
+*/
+class RasterCacheSource : public RasterSource
+{
+  public:
+    bool open(const std::string& filename);
+
+    RasterSampleType get_sample_type() const override { return m_sample_type; }
+    const std::string& get_projection() const { return m_projection; }
+
+    int get_block_width() const { return m_block_width; }
+    int get_block_height() const { return m_block_height; }
+    int get_blocks_x() const { return m_blocks_x; }
+    int get_blocks_y() const { return m_blocks_y; }
+
+    RasterBlockSummary get_block_summary(int block_x, int block_y) const;
+
+    bool read_window(
+        int cx, int cy, int cw, int ch, double* dst, size_t dst_stride) const override;
+    bool read_window(
+        int cx, int cy, int cw, int ch, float* dst, size_t dst_stride) const override;
+    bool read_window(
+        int cx, int cy, int cw, int ch, int16_t* dst, size_t dst_stride) const override;
+
+  private:
+    template<typename D>
+    bool read_window_as(int cx, int cy, int cw, int ch, D* dst, size_t dst_stride) const;
+
+    template<typename S, typename D>
+    void copy_block_row(const unsigned char* block_row, int n, D* dst) const;
+
+    MappedFile m_file;
+    RasterSampleType m_sample_type = RasterSampleType::Float64;
+    std::string m_projection;
+    int m_block_width = 0;
+    int m_block_height = 0;
+    int m_blocks_x = 0;
+    int m_blocks_y = 0;
+    size_t m_sample_size = 0;
+    const unsigned char* m_summaries = nullptr;
+    const unsigned char* m_blocks = nullptr;
+};
+
+} // namespace tntn
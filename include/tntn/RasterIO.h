@@ -1,19 +1,46 @@
 #pragma once
 
 #include "Raster.h"
+#include "tntn/RasterSource.h"
+#include "tntn/RasterCache.h"
 #include "tntn/File.h"
+#include <memory>
 #include <string>
 
 namespace tntn {
 //template<typename T> Raster<T> load_raster_from_asc(const std::string &filename);
 //template<typename T> void write_raster_to_asc(const std::string &filename,Raster<T>);
 
-RasterDouble load_raster_from_asc(const std::string& filename);
+// rows are parsed on num_threads threads, 0 uses all available cores
+RasterDouble load_raster_from_asc(const std::string& filename, int num_threads = 0);
 
 bool write_raster_to_asc(const std::string& filename, const RasterDouble& raster);
 bool write_raster_to_asc(FileLike& f, const RasterDouble& raster);
 
+// the raster's sample type determines the type pixels are read with,
+// fails if the file's no-data value doesn't fit that type
 bool load_raster_file(const std::string& filename,
                       RasterDouble& raster,
                       bool validate_projection = true);
+bool load_raster_file(const std::string& filename,
+                      RasterFloat& raster,
+                      bool validate_projection = true);
+bool load_raster_file(const std::string& filename,
+                      RasterInt16& raster,
+                      bool validate_projection = true);
+
+constexpr size_t DEFAULT_RASTER_CACHE_SIZE = 512 * 1024 * 1024;
+
+// opens a raster file for windowed reading without loading it into memory,
+// blocks are read on demand and up to cache_size bytes of them are kept in an LRU cache,
+// blocks are stored with the band's native sample type (see RasterSource::get_sample_type)
+std::unique_ptr<RasterSource> open_raster_source(const std::string& filename,
+                                                 bool validate_projection = true,
+                                                 size_t cache_size = DEFAULT_RASTER_CACHE_SIZE);
+
+// converts a raster file into a raster cache file (see RasterCacheSource),
+// load_raster_file and open_raster_source open the cache instead of the original file
+bool create_raster_cache(const std::string& input_file_name,
+                         const std::string& cache_file_name,
+                         int block_size = DEFAULT_RASTER_CACHE_BLOCK_SIZE);
 } // namespace tntn
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 #include "tntn/Raster.h"
+#include "tntn/RasterSource.h"
 
 namespace tntn {
 
@@ -12,13 +15,43 @@ struct RasterOverview
 {
     int zoom_level;
     double resolution;
+    // a view of the base raster at the top zoom level, clone it before modifying it
     UniqueRasterPointer raster;
 };
 
+struct RasterSourceOverview
+{
+    int zoom_level;
+    double resolution;
+    std::shared_ptr<const RasterSource> source;
+};
+
 class RasterOverviews
 {
   private:
+    // sums and counts of valid base pixels per overview pixel,
+    // the next level is reduced 2x2 from these instead of from the base raster
+    struct PyramidLevel
+    {
+        int window_size = 0;
+        int width = 0;
+        int height = 0;
+        std::vector<double> sum;
+        std::vector<uint32_t> count;
+    };
+
+    // exactly one of these is set, depending on the constructor used
     UniqueRasterPointer m_base_raster;
+    std::shared_ptr<const RasterSource> m_base_source;
+
+    // base pixels as a source for either constructor
+    std::shared_ptr<const RasterSource> m_base_view;
+    int m_num_threads;
+    bool m_cascade = false;
+
+    PyramidLevel m_level;
+    // overviews computed by precompute(), indexed by zoom level
+    std::vector<UniqueRasterPointer> m_precomputed;
 
     int m_min_zoom;
     int m_max_zoom;
@@ -30,12 +63,54 @@ class RasterOverviews
     int guess_max_zoom_level(double resolution);
     int guess_min_zoom_level(int max_zoom_level);
     void compute_zoom_levels();
+    int next_window_size() const;
+    bool advance_level(int window_size);
+    UniqueRasterPointer level_to_raster() const;
+    UniqueRasterPointer take_overview(int window_size);
 
   public:
-    RasterOverviews(UniqueRasterPointer base_raster, int min_zoom, int max_zoom);
+    // num_threads rows are reduced in parallel when computing an overview
+    RasterOverviews(UniqueRasterPointer base_raster,
+                    int min_zoom,
+                    int max_zoom,
+                    int num_threads = 1);
+    // overviews of a source are computed lazily, window by window,
+    // when pixels are read from them, unless set_cascade() or precompute() is used
+    RasterOverviews(std::shared_ptr<const RasterSource> base_source,
+                    int min_zoom,
+                    int max_zoom,
+                    int num_threads = 1);
     ~RasterOverviews() = default;
 
+    /**
+     computes all remaining overviews up front, reading the base raster only once
+
+     subsequent calls to next() return the stored overviews,
+     memory use is about 4/3 of the largest downsampled overview
+
+     @return false on read errors
+    */
+    bool precompute();
+
+    /**
+     cascades source overviews in memory like those of a raster instead
+
+     The base source is read once, on num_threads threads, for the first overview
+     and every further one is reduced from the last. The sums and counts of the
+     last overview are kept for the whole run, about 5 bytes per base pixel.
+     Overviews of an in-memory raster are always cascaded.
+    */
+    void set_cascade(bool cascade) { m_cascade = cascade; }
+
     bool next(RasterOverview& overview);
+    bool next(RasterSourceOverview& overview);
+
+    // zoom levels next() iterates over, from get_max_zoom() down to get_min_zoom()
+    int get_min_zoom() const { return m_min_zoom; }
+    int get_max_zoom() const { return m_max_zoom; }
+
+    // cell size of the overview at a zoom level
+    double get_resolution(int zoom) const;
 };
 
 } // namespace tntn
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "tntn/Raster.h"
+#include "tntn/geometrix.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+namespace tntn {
+
+// sample types a raster can be stored with natively
+enum class RasterSampleType
+{
+    Float64,
+    Float32,
+    Int16,
+};
+
+// true if samples of the type represent the value exactly
+inline bool sample_type_holds(const RasterSampleType type, const double value)
+{
+    switch(type)
+    {
+        case RasterSampleType::Int16: return detail::sample_holds<int16_t>(value);
+        case RasterSampleType::Float32: return detail::sample_holds<float>(value);
+        default: return true;
+    }
+}
+
+/**
+ Read-only access to a raster that is not necessarily held in memory.
+
+ Geometry follows the conventions of Raster (pixel centers, lower left
+ position, row 0 is the top row) and pixels are fetched window by window,
+ so a caller only needs memory for the part of the raster it works on.
+
+ Implementations must allow concurrent calls to read_window.
+*/
+class RasterSource
+{
+  public:
+    virtual ~RasterSource() = default;
+
+    unsigned int get_width() const { return m_width; }
+    unsigned int get_height() const { return m_height; }
+    double get_pos_x() const { return m_xpos; }
+    double get_pos_y() const { return m_ypos; }
+    double get_cell_size() const { return m_cellsize; }
+    double get_no_data_value() const { return m_noDataValue; }
+    bool empty() const { return m_width == 0 && m_height == 0; }
+
+    // smallest sample type that holds all pixel values without loss
+    virtual RasterSampleType get_sample_type() const { return RasterSampleType::Float64; }
+
+    BBox2D get_bounding_box() const;
+    int x2col(double x) const;
+    int y2row(double y) const;
+
+    /**
+     reads pixels of a window that lies completely inside the raster
+
+     @param cx column of the window's top left corner
+     @param cy row of the window's top left corner (origin at TOP left)
+     @param cw width of the window
+     @param ch height of the window
+     @param dst output, row r of the window is written to dst + r * dst_stride
+     @param dst_stride distance between output rows in pixels
+     @return false on read errors
+    */
+    virtual bool read_window(
+        int cx, int cy, int cw, int ch, double* dst, size_t dst_stride) const = 0;
+
+    // same as above, converting samples from double unless overridden
+    virtual bool read_window(
+        int cx, int cy, int cw, int ch, float* dst, size_t dst_stride) const;
+    virtual bool read_window(
+        int cx, int cy, int cw, int ch, int16_t* dst, size_t dst_stride) const;
+
+    /**
+     shares the pixels of a window instead of copying them, see Raster::view
+
+     Only sources that hold their pixels in memory can do this,
+     the default implementation returns false.
+
+     @param dst_raster output raster (will be overwritten)
+     @return false if the window has to be read instead
+    */
+    virtual bool view_window(int cx, int cy, int cw, int ch, RasterDouble& dst_raster) const
+    {
+        return false;
+    }
+
+    /**
+     crop to sub raster, same semantics as Raster::crop
+
+     row and column index coordinates with origin at TOP left,
+     parts of the window outside of the raster are cut off.
+     Uses view_window if the source supports it, dst_raster then shares
+     the source's pixels and has to be cloned before it is modified.
+
+     @param dst_raster output raster (will be overwritten)
+     @return false on read errors
+    */
+    template<typename T>
+    bool crop(const int cx, const int cy, const int cw, const int ch, Raster<T>& dst_raster) const
+    {
+        if(view_window_as(cx, cy, cw, ch, dst_raster))
+        {
+            return true;
+        }
+
+        const int width = m_width;
+        const int height = m_height;
+
+        const int min_x = std::max(cx, 0);
+        const int min_y = std::max(cy, 0);
+        const int max_x = std::min(cx + cw, width);
+        const int max_y = std::min(cy + ch, height);
+
+        const int crop_width = std::max(max_x - min_x, 0);
+        const int crop_height = std::max(max_y - min_y, 0);
+
+        dst_raster.allocate(crop_width, crop_height);
+        dst_raster.set_no_data_value(detail::sample_cast<T>(m_noDataValue));
+        dst_raster.set_cell_size(m_cellsize);
+
+        // lower left corner of the cropped raster, computed like Raster::crop does
+        const int max_r_ll = height - max_y;
+        dst_raster.set_pos_x(m_xpos + (min_x + 0.5) * m_cellsize - 0.5 * m_cellsize);
+        dst_raster.set_pos_y(m_ypos + (max_r_ll + 0.5) * m_cellsize - 0.5 * m_cellsize);
+
+        if(crop_width == 0 || crop_height == 0)
+        {
+            return true;
+        }
+
+        return read_window(
+            min_x, min_y, crop_width, crop_height, dst_raster.get_ptr(), dst_raster.get_stride());
+    }
+
+  protected:
+    template<typename T>
+    void copy_parameters(const Raster<T>& raster)
+    {
+        m_width = raster.get_width();
+        m_height = raster.get_height();
+        m_xpos = raster.get_pos_x();
+        m_ypos = raster.get_pos_y();
+        m_cellsize = raster.get_cell_size();
+        m_noDataValue = raster.get_no_data_value();
+    }
+
+    unsigned int m_width = 0;
+    unsigned int m_height = 0;
+    double m_xpos = 0;
+    double m_ypos = 0;
+    double m_cellsize = 1;
+    double m_noDataValue = std::numeric_limits<double>::max();
+
+  private:
+    bool view_window_as(int cx, int cy, int cw, int ch, RasterDouble& dst_raster) const
+    {
+        return view_window(cx, cy, cw, ch, dst_raster);
+    }
+
+    // only double rasters can be views of a source
+    template<typename T>
+    bool view_window_as(int, int, int, int, Raster<T>&) const
+    {
+        return false;
+    }
+};
+
+// RasterSource backed by a raster in memory
+class MemoryRasterSource : public RasterSource
+{
+  public:
+    explicit MemoryRasterSource(std::shared_ptr<const RasterDouble> raster);
+
+    using RasterSource::read_window;
+    bool read_window(
+        int cx, int cy, int cw, int ch, double* dst, size_t dst_stride) const override;
+
+    bool view_window(int cx, int cy, int cw, int ch, RasterDouble& dst_raster) const override;
+
+  private:
+    std::shared_ptr<const RasterDouble> m_raster;
+};
+
+/**
+ RasterSource that downsamples another source on the fly,
+ pixel values are identical to raster_tools::integer_downsample_mean
+ of the whole base raster with the same window size
+*/
+class DownsampledRasterSource : public RasterSource
+{
+  public:
+    DownsampledRasterSource(std::shared_ptr<const RasterSource> base, int window_size);
+
+    using RasterSource::read_window;
+    bool read_window(
+        int cx, int cy, int cw, int ch, double* dst, size_t dst_stride) const override;
+
+  private:
+    std::shared_ptr<const RasterSource> m_base;
+    int m_window_size;
+};
+
+} // namespace tntn
@@ -7,19 +7,41 @@
 #include "tntn/TerraUtils.h"
 
 #include <memory>
+#include <vector>
 
 namespace tntn {
 namespace terra {
 
-class TerraMesh : public TerraBaseMesh
+// instantiated for double, float and int16_t samples
+template<typename T>
+class TerraMesh : public TerraBaseMesh<T>
 {
   private:
+    using TerraBaseMesh<T>::m_raster;
+    using TerraBaseMesh<T>::m_first_face;
+    using TerraBaseMesh<T>::export_indexed;
+
     Raster<char> m_used;
     Raster<int> m_token;
 
     CandidateList m_candidates;
+    MinMaxPyramid m_bounds;
     double m_max_error;
     int m_counter;
+    size_t m_skipped_scans = 0;
+
+    // point inserted by greedy_insert and its error before the insertion
+    struct Insertion
+    {
+        int x;
+        int y;
+        double error;
+    };
+
+    bool m_record_insertions = false;
+    std::vector<Insertion> m_insertions;
+
+    std::unique_ptr<Mesh> to_mesh(DelaunayMesh& triangulation) const;
 
     void scan_triangle_line(const Plane& plane,
                             int y,
@@ -32,6 +54,19 @@ class TerraMesh : public TerraBaseMesh
     void greedy_insert(double max_error);
     void scan_triangle(dt_ptr t) override;
     std::unique_ptr<Mesh> convert_to_mesh();
+
+    // remember the points inserted by the next greedy_insert, needed by convert_to_meshes
+    void record_insertions(bool enable) { m_record_insertions = enable; }
+
+    /**
+     cuts a recorded greedy run into one mesh per error threshold
+
+     The mesh for max_errors[i] holds the points greedy_insert inserted before the
+     error of the worst remaining candidate dropped below max_errors[i], i.e. the
+     points a run with that threshold would have inserted. Thresholds smaller than
+     the one passed to greedy_insert result in the same mesh as convert_to_mesh().
+    */
+    std::vector<std::unique_ptr<Mesh>> convert_to_meshes(const std::vector<double>& max_errors);
 };
 
 } //namespace terra
@@ -6,7 +6,6 @@
 
 #include <array>
 #include <vector>
-#include <queue>
 #include <algorithm>
 #include <cmath>
 #include <memory>
@@ -39,29 +38,176 @@ struct Candidate
     bool operator<(const Candidate& c) const noexcept { return (importance < c.importance); }
 };
 
+// Max-heap of candidates with at most one entry per triangle.
+// Pushing a candidate for a triangle that already has one replaces that
+// entry in place, so the heap never grows beyond the number of triangles.
 class CandidateList
 {
   public:
-    void push_back(const Candidate& candidate) { m_candidates.push(candidate); }
+    struct Stats
+    {
+        size_t pushed = 0;
+        size_t replaced = 0;
+        size_t popped = 0;
+        size_t stale_popped = 0;
+        size_t peak_size = 0;
+    };
+
+    void push_back(const Candidate& candidate)
+    {
+        m_stats.pushed++;
+
+        const size_t key = candidate.triangle.index();
+        if(key >= m_position.size())
+        {
+            m_position.resize(std::max(key + 1, 2 * m_position.size()), static_cast<size_t>(npos));
+        }
+
+        size_t pos = m_position[key];
+        if(pos == npos)
+        {
+            pos = m_heap.size();
+            m_heap.push_back(candidate);
+            m_position[key] = pos;
+            sift_up(pos);
+            m_stats.peak_size = std::max(m_stats.peak_size, m_heap.size());
+            return;
+        }
+
+        m_stats.replaced++;
+        const bool increased = m_heap[pos].importance < candidate.importance;
+        m_heap[pos] = candidate;
+        if(increased)
+        {
+            sift_up(pos);
+        }
+        else
+        {
+            sift_down(pos);
+        }
+    }
+
+    // drops the entry of a triangle, if it has one
+    void remove(const dt_ptr& triangle)
+    {
+        const size_t key = triangle.index();
+        if(key >= m_position.size() || m_position[key] == npos)
+        {
+            return;
+        }
 
-    size_t size() const noexcept { return m_candidates.size(); }
-    bool empty() const noexcept { return m_candidates.empty(); }
+        const size_t pos = m_position[key];
+        const size_t last = m_heap.size() - 1;
+        m_position[key] = npos;
+        if(pos == last)
+        {
+            m_heap.pop_back();
+            return;
+        }
+
+        const bool increased = m_heap[pos] < m_heap[last];
+        move_entry(last, pos);
+        m_heap.pop_back();
+        if(increased)
+        {
+            sift_up(pos);
+        }
+        else
+        {
+            sift_down(pos);
+        }
+    }
+
+    size_t size() const noexcept { return m_heap.size(); }
+    bool empty() const noexcept { return m_heap.empty(); }
 
     //find greatest element, remove from candidate list and return
     Candidate grab_greatest()
     {
-        if(m_candidates.empty())
+        if(m_heap.empty())
         {
             return Candidate();
         }
 
-        Candidate candidate = m_candidates.top();
-        m_candidates.pop();
+        m_stats.popped++;
+
+        Candidate candidate = m_heap.front();
+        m_position[candidate.triangle.index()] = npos;
+
+        if(m_heap.size() > 1)
+        {
+            move_entry(m_heap.size() - 1, 0);
+            m_heap.pop_back();
+            sift_down(0);
+        }
+        else
+        {
+            m_heap.pop_back();
+        }
         return candidate;
     }
 
+    // to be called for popped candidates that turned out to be outdated
+    void count_stale_pop() noexcept { m_stats.stale_popped++; }
+
+    const Stats& stats() const noexcept { return m_stats; }
+
   private:
-    std::priority_queue<Candidate> m_candidates;
+    static constexpr size_t npos = ~static_cast<size_t>(0);
+
+    void move_entry(const size_t from, const size_t to)
+    {
+        m_heap[to] = m_heap[from];
+        m_position[m_heap[to].triangle.index()] = to;
+    }
+
+    void sift_up(size_t pos)
+    {
+        const Candidate c = m_heap[pos];
+        while(pos > 0)
+        {
+            const size_t parent = (pos - 1) / 2;
+            if(!(m_heap[parent] < c))
+            {
+                break;
+            }
+            move_entry(parent, pos);
+            pos = parent;
+        }
+        m_heap[pos] = c;
+        m_position[c.triangle.index()] = pos;
+    }
+
+    void sift_down(size_t pos)
+    {
+        const Candidate c = m_heap[pos];
+        const size_t n = m_heap.size();
+        while(true)
+        {
+            size_t child = 2 * pos + 1;
+            if(child >= n)
+            {
+                break;
+            }
+            if(child + 1 < n && m_heap[child] < m_heap[child + 1])
+            {
+                child++;
+            }
+            if(!(c < m_heap[child]))
+            {
+                break;
+            }
+            move_entry(child, pos);
+            pos = child;
+        }
+        m_heap[pos] = c;
+        m_position[c.triangle.index()] = pos;
+    }
+
+    std::vector<Candidate> m_heap;
+    // heap position by triangle index
+    std::vector<size_t> m_position;
+    Stats m_stats;
 };
 
 inline void order_triangle_points(std::array<Point2D, 3>& p) noexcept
@@ -86,11 +232,58 @@ inline bool is_no_data(const double value, const double no_data_value) noexcept
     return std::isnan(value) || value == no_data_value;
 }
 
-inline void compute_plane(Plane& plane, dt_ptr t, const RasterDouble& raster)
+// pixel of a scan line that deviates most from a plane, x < 0 if there is none
+struct LineMaximum
 {
-    const glm::dvec2& p1 = t->point1();
-    const glm::dvec2& p2 = t->point2();
-    const glm::dvec2& p3 = t->point3();
+    int x = -1;
+    double deviation = -DBL_MAX;
+};
+
+// implementations of scan_line_maximum, all of them return identical results
+enum class ScanLineKernel
+{
+    Scalar,
+    SSE41,
+    AVX2,
+};
+
+// fastest kernel supported by the running CPU
+ScanLineKernel detect_scan_line_kernel();
+
+// finds the first x in [startx, endx] with the largest |z[x] - plane.eval(x, y)|,
+// pixels with used[x] != 0 or no data in z[x] are skipped
+// instantiated for double, float and int16_t samples
+template<typename T>
+LineMaximum scan_line_maximum(const T* z,
+                              const char* used,
+                              int startx,
+                              int endx,
+                              int y,
+                              const Plane& plane,
+                              double no_data_value,
+                              ScanLineKernel kernel);
+
+template<typename T>
+inline LineMaximum scan_line_maximum(const T* z,
+                                     const char* used,
+                                     int startx,
+                                     int endx,
+                                     int y,
+                                     const Plane& plane,
+                                     double no_data_value)
+{
+    static const ScanLineKernel kernel = detect_scan_line_kernel();
+    return scan_line_maximum(z, used, startx, endx, y, plane, no_data_value, kernel);
+}
+
+template<typename T>
+inline void compute_plane(Plane& plane,
+                          const std::array<Point2D, 3>& corners,
+                          const Raster<T>& raster)
+{
+    const glm::dvec2& p1 = corners[0];
+    const glm::dvec2& p2 = corners[1];
+    const glm::dvec2& p3 = corners[2];
 
     const glm::dvec3 v1(p1, raster.value(p1.y, p1.x));
     const glm::dvec3 v2(p2, raster.value(p2.y, p2.x));
@@ -99,16 +292,69 @@ inline void compute_plane(Plane& plane, dt_ptr t, const RasterDouble& raster)
     plane.init(v1, v2, v3);
 }
 
+// Smallest and largest sample of square blocks of a raster, stored as a quadtree.
+// Level 0 has blocks of BLOCK_SIZE x BLOCK_SIZE pixels, every further level
+// combines 2x2 blocks of the level below. No data samples are left out.
+// Lets the meshers prove that a triangle is within the error threshold
+// without scanning its pixels.
+class MinMaxPyramid
+{
+  public:
+    enum : int
+    {
+        BLOCK_SIZE_LOG2 = 2,
+        BLOCK_SIZE = 1 << BLOCK_SIZE_LOG2,
+    };
+
+    // instantiated for double, float and int16_t samples
+    template<typename T>
+    void build(const Raster<T>& raster, double no_data_value);
+
+    bool empty() const noexcept { return m_levels.empty(); }
+
+    // true if every sample with data in the pixel rectangle [x0, x1] x [y0, y1]
+    // is provably closer than threshold to the plane, false if that is unknown
+    bool deviation_below(const Plane& plane, int x0, int y0, int x1, int y1, double threshold)
+        const noexcept;
+
+  private:
+    struct Level
+    {
+        int width = 0;
+        int height = 0;
+        // blocks without any data have min > max
+        std::vector<double> min;
+        std::vector<double> max;
+    };
+
+    std::vector<Level> m_levels;
+};
+
+// fills no data corners of the raster like TerraBaseMesh does before meshing,
+// returns false and stops at the first fill T can't hold exactly, meshing the raster
+// as Raster<T> would then give other heights than meshing it as RasterDouble
+// instantiated for double, float and int16_t
+template<typename T>
+bool repair_corners_exactly(Raster<T>& raster);
+
+// copies a raster into a new RasterDouble
+template<typename T>
+std::unique_ptr<RasterDouble> to_double_raster(const Raster<T>& raster);
+
 //abstract base class for Terra and Zemlya
+//T is the sample type of the input raster, samples are only converted
+//to double when compared against the triangle planes
+//instantiated for double, float and int16_t
+template<typename T>
 class TerraBaseMesh : protected DelaunayMesh
 {
   public:
-    TerraBaseMesh() : m_raster(std::make_unique<RasterDouble>()) {}
+    TerraBaseMesh() : m_raster(std::make_unique<Raster<T>>()) {}
 
-    void load_raster(std::unique_ptr<RasterDouble> raster);
+    void load_raster(std::unique_ptr<Raster<T>> raster);
 
   protected:
-    std::unique_ptr<RasterDouble> m_raster;
+    std::unique_ptr<Raster<T>> m_raster;
 
     void repair_point(int px, int py);
 };
@@ -2,8 +2,11 @@
 
 #include "tntn/Mesh.h"
 #include "tntn/MeshWriter.h"
+#include "tntn/TileStore.h"
 
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 namespace tntn {
 
@@ -11,6 +14,22 @@ class TileMaker
 {
     std::unique_ptr<Mesh> m_mesh;
 
+    // uniform grid over the triangle bounding boxes of m_mesh,
+    // cell c holds m_cell_triangles[m_cell_start[c]..m_cell_start[c+1])
+    BBox2D m_grid_bbox;
+    int m_grid_columns = 0;
+    int m_grid_rows = 0;
+    double m_grid_cell_width = 0;
+    double m_grid_cell_height = 0;
+    std::vector<uint32_t> m_cell_start;
+    std::vector<uint32_t> m_cell_triangles;
+
+    // encoded tile, reused for all tiles handed to a TileSink
+    std::vector<unsigned char> m_tile_buffer;
+
+    void build_grid_index();
+    bool make_tile_mesh(int tx, int ty, int zoom, Mesh& tile_mesh, BBox3D& tile_bbox) const;
+
   public:
     TileMaker() : m_mesh(std::make_unique<Mesh>()) {}
 
@@ -19,6 +38,12 @@ class TileMaker
     void loadMesh(std::unique_ptr<Mesh> mesh);
     // void dumpTile(int tx, int ty, int zoom, const char* filename);
     bool dumpTile(int tx, int ty, int zoom, const char* filename, MeshWriter& mw);
+    // encodes the tile in memory and hands it to sink
+    bool dumpTile(int tx, int ty, int zoom, TileSink& sink, MeshWriter& mw);
+
+    // collects the indices of all triangles whose bounding box intersects bounds,
+    // in ascending order (i.e. the order of the loaded mesh's triangles())
+    void find_triangles(const BBox2D& bounds, std::vector<uint32_t>& triangle_indices) const;
 };
 
 } //namespace tntn
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "tntn/File.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tntn {
+
+/**
+ destination for encoded tiles of a tile pyramid
+
+ write_tile is called from several threads at once when tiles are
+ created in parallel, implementations have to synchronize themselves.
+*/
+class TileSink
+{
+  public:
+    virtual ~TileSink() = default;
+
+    virtual bool write_tile(int zoom, int tx, int ty, const unsigned char* data, size_t size) = 0;
+
+    // makes all written tiles durable, no tiles may be written afterwards
+    virtual bool finish() = 0;
+};
+
+// one file per tile in <basedir>/<zoom>/<tx>/<ty>.<extension>
+class DirectoryTileSink : public TileSink
+{
+  public:
+    DirectoryTileSink(const std::string& basedir, const std::string& extension);
+
+    bool write_tile(int zoom, int tx, int ty, const unsigned char* data, size_t size) override;
+    bool finish() override { return true; }
+
+  private:
+    std::string m_basedir;
+    std::string m_extension;
+};
+
+/**
+ all tiles packed into a single file with an offset index
+
+ Layout, all integers little endian:
+   header   "TNTNTILE", uint32 version
+   tiles    tile data, appended in the order tiles are written
+   index    per tile: uint32 zoom, uint32 tx, uint32 ty, uint64 offset, uint32 size,
+            sorted by (zoom, tx, ty)
+   footer   uint64 index offset, uint64 tile count, "TNTNINDX"
+
+ Tiles are collected in memory and appended in batches of batch_size bytes,
+ the index and the magic of the header are written by finish(). An archive
+ whose sink was destroyed without finish() is rejected by TileArchive.
+*/
+class ArchiveTileSink : public TileSink
+{
+  public:
+    static constexpr size_t DEFAULT_BATCH_SIZE = 16 * 1024 * 1024;
+
+    explicit ArchiveTileSink(size_t batch_size = DEFAULT_BATCH_SIZE);
+    ~ArchiveTileSink() override;
+
+    // creates or overwrites the archive file
+    bool open(const std::string& filename);
+
+    bool write_tile(int zoom, int tx, int ty, const unsigned char* data, size_t size) override;
+    bool finish() override;
+
+    struct IndexEntry
+    {
+        uint32_t zoom;
+        uint32_t tx;
+        uint32_t ty;
+        uint64_t offset;
+        uint32_t size;
+    };
+
+  private:
+    bool flush_batch();
+
+    std::mutex m_mutex;
+    File m_file;
+    bool m_is_open = false;
+    size_t m_batch_size;
+    std::vector<unsigned char> m_batch;
+    uint64_t m_batch_offset = 0;
+    std::vector<IndexEntry> m_index;
+};
+
+/**
+ hands tiles to another sink on dedicated writer threads
+
+ write_tile copies the tile into a queue and returns, so the meshing threads
+ don't wait for the storage. When more than max_queued_bytes are waiting,
+ write_tile blocks until the writers caught up.
+ Once the target failed to write a tile, write_tile and finish return false.
+ Destroying the sink without finish() writes the queued tiles but doesn't
+ finish the target.
+*/
+class AsyncTileSink : public TileSink
+{
+  public:
+    static constexpr size_t DEFAULT_MAX_QUEUED_BYTES = 64 * 1024 * 1024;
+
+    AsyncTileSink(std::unique_ptr<TileSink> target,
+                  int num_writers = 1,
+                  size_t max_queued_bytes = DEFAULT_MAX_QUEUED_BYTES);
+    ~AsyncTileSink() override;
+
+    bool write_tile(int zoom, int tx, int ty, const unsigned char* data, size_t size) override;
+
+    // waits for the queue to drain, then finishes the target
+    bool finish() override;
+
+  private:
+    struct QueuedTile
+    {
+        int zoom;
+        int tx;
+        int ty;
+        std::vector<unsigned char> data;
+    };
+
+    void write_queued_tiles();
+    bool stop_writers();
+
+    std::unique_ptr<TileSink> m_target;
+    size_t m_max_queued_bytes;
+
+    std::mutex m_mutex;
+    std::condition_variable m_tile_queued;
+    std::condition_variable m_tile_taken;
+    std::deque<QueuedTile> m_queue;
+    size_t m_queued_bytes = 0;
+    bool m_stopping = false;
+    bool m_failed = false;
+
+    std::vector<std::thread> m_writers;
+};
+
+// read access to a file written by ArchiveTileSink, the file is memory mapped
+class TileArchive
+{
+  public:
+    bool open(const std::string& filename);
+
+    size_t tile_count() const { return m_tile_count; }
+
+    /**
+     finds a tile without copying it
+
+     @param data points into the mapped file, valid as long as the archive is open
+     @return false if the archive has no such tile
+    */
+    bool find_tile(int zoom, int tx, int ty, const unsigned char*& data, size_t& size) const;
+
+    // calls f(zoom, tx, ty, data, size) for all tiles in index order
+    template<typename F>
+    void for_each_tile(F&& f) const
+    {
+        for(size_t i = 0; i < m_tile_count; i++)
+        {
+            const ArchiveTileSink::IndexEntry e = entry(i);
+            f(static_cast<int>(e.zoom),
+              static_cast<int>(e.tx),
+              static_cast<int>(e.ty),
+              m_file.data() + e.offset,
+              static_cast<size_t>(e.size));
+        }
+    }
+
+  private:
+    ArchiveTileSink::IndexEntry entry(size_t i) const;
+
+    MappedFile m_file;
+    const unsigned char* m_index = nullptr;
+    size_t m_tile_count = 0;
+};
+
+} // namespace tntn
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "tntn/geometrix.h"
+#include "tntn/tntn_assert.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace tntn {
+
+/**
+ open addressing hash set of vertices, used to deduplicate triangle corners
+
+ The table only holds 32 bit indices into the caller's vertex array,
+ so unlike std::unordered_map there is no allocation per vertex.
+ The same vertex array has to be passed to every call.
+*/
+class VertexLookup
+{
+  public:
+    explicit VertexLookup(size_t expected_vertices = 0) { rehash(expected_vertices, nullptr); }
+
+    /**
+     index of v in vertices, v is appended if it isn't in vertices yet
+
+     vertices compare equal with operator==, like keys of std::unordered_map<Vertex, ...>
+    */
+    VertexIndex find_or_insert(const Vertex& v, std::vector<Vertex>& vertices)
+    {
+        if(2 * (m_size + 1) > m_slots.size())
+        {
+            rehash(m_slots.size(), &vertices);
+        }
+
+        size_t slot = home_slot(v);
+        while(true)
+        {
+            const uint32_t index = m_slots[slot];
+            if(index == EMPTY)
+            {
+                TNTN_ASSERT(vertices.size() < EMPTY);
+                m_slots[slot] = static_cast<uint32_t>(vertices.size());
+                m_size++;
+                vertices.push_back(v);
+                return vertices.size() - 1;
+            }
+            if(vertices[index] == v)
+            {
+                return index;
+            }
+            slot = (slot + 1) & m_mask;
+        }
+    }
+
+  private:
+    enum : uint32_t
+    {
+        EMPTY = 0xffffffff
+    };
+
+    size_t home_slot(const Vertex& v) const
+    {
+        // Fibonacci hashing spreads the combined hash over the high bits
+        const uint64_t h = static_cast<uint64_t>(std::hash<Vertex>()(v));
+        return static_cast<size_t>((h * 0x9E3779B97F4A7C15ull) >> m_shift);
+    }
+
+    // grows the table to hold at least n vertices at a load factor <= 1/2
+    void rehash(size_t n, const std::vector<Vertex>* vertices)
+    {
+        size_t capacity = 16;
+        m_shift = 60;
+        while(capacity < 2 * n + 2)
+        {
+            capacity *= 2;
+            m_shift--;
+        }
+
+        m_slots.assign(capacity, EMPTY);
+        m_mask = capacity - 1;
+        m_size = 0;
+
+        if(vertices != nullptr)
+        {
+            for(size_t i = 0; i < vertices->size(); i++)
+            {
+                size_t slot = home_slot((*vertices)[i]);
+                while(m_slots[slot] != EMPTY)
+                {
+                    slot = (slot + 1) & m_mask;
+                }
+                m_slots[slot] = static_cast<uint32_t>(i);
+                m_size++;
+            }
+        }
+    }
+
+    std::vector<uint32_t> m_slots;
+    size_t m_mask = 0;
+    int m_shift = 60;
+    size_t m_size = 0;
+};
+
+} // namespace tntn
@@ -18,9 +18,15 @@ using Point2D = terra::Point2D;
 using CandidateList = terra::CandidateList;
 using Candidate = terra::Candidate;
 
-class ZemlyaMesh : public terra::TerraBaseMesh
+// instantiated for double, float and int16_t samples
+template<typename T>
+class ZemlyaMesh : public terra::TerraBaseMesh<T>
 {
   private:
+    using terra::TerraBaseMesh<T>::m_raster;
+    using terra::TerraBaseMesh<T>::m_first_face;
+    using terra::TerraBaseMesh<T>::export_indexed;
+
     Raster<double> m_sample;
     Raster<double> m_insert;
     Raster<double> m_result;
@@ -28,8 +34,11 @@ class ZemlyaMesh : public terra::TerraBaseMesh
     Raster<int> m_token;
 
     CandidateList m_candidates;
+    // bounds of the samples scanned at the current level
+    terra::MinMaxPyramid m_bounds;
     double m_max_error = 0;
     int m_counter = 0;
+    size_t m_skipped_scans = 0;
     int m_current_level = 0;
     int m_max_level = 0;
 
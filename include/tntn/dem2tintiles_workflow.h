@@ -3,9 +3,13 @@
 #include "tntn/MercatorProjection.h"
 #include "tntn/SurfacePoints.h"
 #include "tntn/MeshWriter.h"
+#include "tntn/Mesh.h"
+#include "tntn/RasterSource.h"
+#include "tntn/TileStore.h"
 
 #include <vector>
 #include <memory>
+#include <string>
 
 namespace tntn {
 
@@ -16,14 +20,71 @@ struct Partition
     glm::ivec2 tmax;
 };
 
+// crops a window (see RasterSource::crop) and meshes it with terra or zemlya,
+// using the raster's native sample type
+std::unique_ptr<Mesh> generate_tin_from_window(const RasterSource& dem,
+                                               int cx,
+                                               int cy,
+                                               int cw,
+                                               int ch,
+                                               const std::string& meshing_method,
+                                               const double max_error);
+
 std::vector<Partition> create_partitions_for_zoom_level(const RasterDouble& dem, int zoom);
+std::vector<Partition> create_partitions_for_zoom_level(const RasterSource& dem, int zoom);
 
+// num_threads > 1 meshes and writes that many partitions concurrently,
+// mesh_writer must then be safe to use from several threads at once
 bool create_tiles_for_zoom_level(const RasterDouble& dem,
                                  const std::vector<Partition>& partitions,
                                  int zoom,
                                  const std::string& output_basedir,
                                  const double method_parameter,
                                  const std::string& meshing_method,
-                                 MeshWriter& mesh_writer);
+                                 MeshWriter& mesh_writer,
+                                 int num_threads = 1);
+
+// same as above, but every partition only reads its part of the raster from dem
+bool create_tiles_for_zoom_level(const RasterSource& dem,
+                                 const std::vector<Partition>& partitions,
+                                 int zoom,
+                                 const std::string& output_basedir,
+                                 const double method_parameter,
+                                 const std::string& meshing_method,
+                                 MeshWriter& mesh_writer,
+                                 int num_threads = 1);
+
+// same as above, but tiles encoded by mesh_writer are handed to tile_sink
+// instead of being written to <output_basedir>/<zoom>/<x>/<y>.<extension>
+bool create_tiles_for_zoom_level(const RasterSource& dem,
+                                 const std::vector<Partition>& partitions,
+                                 int zoom,
+                                 TileSink& tile_sink,
+                                 const double method_parameter,
+                                 const std::string& meshing_method,
+                                 MeshWriter& mesh_writer,
+                                 int num_threads = 1);
+
+/**
+ error thresholds for create_tiles_progressive: finest_error at max_zoom,
+ doubled for every coarser zoom level like the resolution of the overviews
+*/
+std::vector<double> progressive_max_errors(int min_zoom, int max_zoom, double finest_error);
+
+/**
+ meshes every partition of min_zoom once with terra and cuts that run
+ into one mesh per zoom level from min_zoom to max_zoom
+
+ max_errors[z - min_zoom] is the error threshold of zoom level z, see
+ terra::TerraMesh::convert_to_meshes. All levels are meshed from dem itself,
+ so the tiles differ slightly from tiles meshed from downsampled overviews.
+*/
+bool create_tiles_progressive(const RasterSource& dem,
+                              int min_zoom,
+                              int max_zoom,
+                              const std::vector<double>& max_errors,
+                              TileSink& tile_sink,
+                              MeshWriter& mesh_writer,
+                              int num_threads = 1);
 
 } //namespace tntn
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <cstring>
 
 #if defined(__BYTE_ORDER) && __BYTE_ORDER == __BIG_ENDIAN || defined(__BIG_ENDIAN__) || \
     defined(__ARMEB__) || defined(__THUMBEB__) || defined(__AARCH64EB__) || defined(_MIBSEB) || \
@@ -38,4 +39,29 @@ inline void flip_endianness_4byte(unsigned char* data)
     std::swap(data[1], data[2]);
 }
 
+// reads a little endian value from an unaligned position
+template<typename T>
+inline T load_little_endian(const unsigned char* p) noexcept
+{
+    T value;
+#ifdef TNTN_BIG_ENDIAN
+    unsigned char bytes[sizeof(T)];
+    std::reverse_copy(p, p + sizeof(T), bytes);
+    std::memcpy(&value, bytes, sizeof(T));
+#else
+    std::memcpy(&value, p, sizeof(T));
+#endif
+    return value;
+}
+
+// writes a value in little endian byte order to an unaligned position
+template<typename T>
+inline void store_little_endian(const T value, unsigned char* p) noexcept
+{
+    std::memcpy(p, &value, sizeof(T));
+#ifdef TNTN_BIG_ENDIAN
+    std::reverse(p, p + sizeof(T));
+#endif
+}
+
 } // namespace tntn
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "tntn/Raster.h"
+#include <cstdint>
 #include <vector>
 #include <string>
 #include "tntn/geometrix.h"
@@ -9,23 +10,53 @@ namespace tntn {
 
 struct raster_tools //just a namespace
 {
-    static RasterDouble integer_downsample_mean(const RasterDouble& src, int window_size);
+    static RasterDouble integer_downsample_mean(const RasterDouble& src,
+                                                int window_size,
+                                                int num_threads = 1);
+
+    // sums and counts the valid pixels of columns adjacent window_size by window_size
+    // windows, rows points to the top left pixel of the first window
+    static void sum_windows(const double* rows,
+                            size_t row_stride,
+                            int columns,
+                            int window_size,
+                            double no_data_value,
+                            double* sum,
+                            uint32_t* count);
+
+    // mean of a window summed by sum_windows
+    static double window_mean(double sum, uint32_t count, double no_data_value)
+    {
+        return count > 0 ? sum / count : no_data_value;
+    }
 
     static RasterDouble convolution_filter(const RasterDouble& src,
                                            std::vector<double> kernel,
-                                           int size);
+                                           int size,
+                                           int num_threads = 1);
+
+    // separable kernel, same result as the 2D kernel column_kernel * row_kernel^T
+    static RasterDouble convolution_filter(const RasterDouble& src,
+                                           const std::vector<double>& row_kernel,
+                                           const std::vector<double>& column_kernel,
+                                           int num_threads = 1);
 
-    static RasterDouble max_filter(const RasterDouble& src, int size, double pos, double factor);
+    static RasterDouble max_filter(
+        const RasterDouble& src, int size, double pos, double factor, int num_threads = 1);
 
-    static void flip_data_x(RasterDouble& r);
+    // instantiated for RasterDouble, RasterFloat and RasterInt16
+    template<typename T>
+    static void flip_data_x(Raster<T>& r);
 
-    static void flip_data_y(RasterDouble& r);
+    template<typename T>
+    static void flip_data_y(Raster<T>& r);
 
     static void find_minmax(const RasterDouble& raster, double& min, double& max);
 
     static BBox3D get_bounding_box3d(const RasterDouble& raster);
 
-    static double sample_nearest_valid_avg(const RasterDouble& src,
+    template<typename T>
+    static double sample_nearest_valid_avg(const Raster<T>& src,
                                            const unsigned int row,
                                            const unsigned int column,
                                            int min_averaging_samples = 1);
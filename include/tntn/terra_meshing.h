@@ -5,13 +5,25 @@
 #include "tntn/Raster.h"
 
 #include <memory>
+#include <vector>
 
 namespace tntn {
 
 std::unique_ptr<Mesh> generate_tin_terra(std::unique_ptr<RasterDouble> raster, double max_error);
+std::unique_ptr<Mesh> generate_tin_terra(std::unique_ptr<RasterFloat> raster, double max_error);
+std::unique_ptr<Mesh> generate_tin_terra(std::unique_ptr<RasterInt16> raster, double max_error);
 
 std::unique_ptr<Mesh> generate_tin_terra(std::unique_ptr<SurfacePoints> surface_points,
                                          double max_error);
 std::unique_ptr<Mesh> generate_tin_terra(const SurfacePoints& surface_points, double max_error);
 
+// one greedy run down to the smallest of max_errors, cut into one mesh per threshold,
+// see terra::TerraMesh::convert_to_meshes
+std::vector<std::unique_ptr<Mesh>> generate_tins_terra(std::unique_ptr<RasterDouble> raster,
+                                                       const std::vector<double>& max_errors);
+std::vector<std::unique_ptr<Mesh>> generate_tins_terra(std::unique_ptr<RasterFloat> raster,
+                                                       const std::vector<double>& max_errors);
+std::vector<std::unique_ptr<Mesh>> generate_tins_terra(std::unique_ptr<RasterInt16> raster,
+                                                       const std::vector<double>& max_errors);
+
 } //namespace tntn
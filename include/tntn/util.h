@@ -1,9 +1,12 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <vector>
 #include <string>
+#include <thread>
 
 namespace tntn {
 
@@ -58,4 +61,36 @@ void tokenize(const char* s,
               std::vector<std::string>& out_tokens,
               const char* delimiters = nullptr);
 
+// calls f(begin_row, end_row) for consecutive row ranges on up to num_threads threads
+// and returns false if any of the calls did
+template<typename F>
+bool for_each_row_range(const int rows, const int num_threads, const F& f)
+{
+    const int workers = std::max(1, std::min(num_threads, rows));
+    if(workers == 1)
+    {
+        return f(0, rows);
+    }
+
+    std::atomic<bool> ok(true);
+    std::vector<std::thread> threads;
+    threads.reserve(workers);
+    for(int i = 0; i < workers; i++)
+    {
+        const int begin = static_cast<int>(static_cast<int64_t>(rows) * i / workers);
+        const int end = static_cast<int>(static_cast<int64_t>(rows) * (i + 1) / workers);
+        threads.emplace_back([&f, &ok, begin, end]() {
+            if(!f(begin, end))
+            {
+                ok = false;
+            }
+        });
+    }
+    for(auto& t : threads)
+    {
+        t.join();
+    }
+    return ok;
+}
+
 } //namespace tntn
@@ -1,89 +1,114 @@
 #include "tntn/DelaunayMesh.h"
 #include "tntn/DelaunayTriangle.h"
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
 namespace tntn {
 namespace terra {
 
 dt_ptr DelaunayMesh::make_face(qe_ptr e)
 {
-    dt_ptr t = m_triangles->spawn();
-    t->init(t, e);
+    const dt_ptr t(static_cast<uint32_t>(m_triangles->spawn().index()));
+    reshape(t, e);
 
-    m_first_face = t->linkTo(m_first_face);
+    triangle(t).next_face = m_first_face;
+    m_first_face = t;
     return t;
 }
 
+void DelaunayMesh::dont_anchor(dt_ptr t, qe_ptr e)
+{
+    DelaunayTriangle& tri = triangle(t);
+    if(tri.anchor == e)
+    {
+        tri.anchor = m_edges.Lnext(e);
+    }
+}
+
+void DelaunayMesh::reshape(dt_ptr t, qe_ptr e)
+{
+    triangle(t).anchor = e;
+    m_edges.set_Lface(e, t);
+    m_edges.set_Lface(m_edges.Lnext(e), t);
+    m_edges.set_Lface(m_edges.Lprev(e), t);
+}
+
 void DelaunayMesh::init_mesh(const Point2D a, const Point2D b, const Point2D c, const Point2D d)
 {
-    qe_ptr ea = m_edges->spawn();
-    ea->init(ea);
-    ea->set_end_points(a, b);
-
-    qe_ptr eb = m_edges->spawn();
-    eb->init(eb);
-    splice(ea->Sym(), eb);
-    eb->set_end_points(b, c);
-
-    qe_ptr ec = m_edges->spawn();
-    ec->init(ec);
-    splice(eb->Sym(), ec);
-    ec->set_end_points(c, d);
-
-    qe_ptr ed = m_edges->spawn();
-    ed->init(ed);
-    splice(ec->Sym(), ed);
-    ed->set_end_points(d, a);
-    splice(ed->Sym(), ea);
-
-    qe_ptr diag = m_edges->spawn();
-    diag->init(diag);
-    splice(ed->Sym(), diag);
-    splice(eb->Sym(), diag->Sym());
-    diag->set_end_points(a, c);
+    const QuadEdgeStore::vertex_ref va = m_edges.add_vertex(a);
+    const QuadEdgeStore::vertex_ref vb = m_edges.add_vertex(b);
+    const QuadEdgeStore::vertex_ref vc = m_edges.add_vertex(c);
+    const QuadEdgeStore::vertex_ref vd = m_edges.add_vertex(d);
+
+    qe_ptr ea = m_edges.make_edge();
+    m_edges.set_end_points(ea, va, vb);
+
+    qe_ptr eb = m_edges.make_edge();
+    m_edges.splice(m_edges.Sym(ea), eb);
+    m_edges.set_end_points(eb, vb, vc);
+
+    qe_ptr ec = m_edges.make_edge();
+    m_edges.splice(m_edges.Sym(eb), ec);
+    m_edges.set_end_points(ec, vc, vd);
+
+    qe_ptr ed = m_edges.make_edge();
+    m_edges.splice(m_edges.Sym(ec), ed);
+    m_edges.set_end_points(ed, vd, va);
+    m_edges.splice(m_edges.Sym(ed), ea);
+
+    qe_ptr diag = m_edges.make_edge();
+    m_edges.splice(m_edges.Sym(ed), diag);
+    m_edges.splice(m_edges.Sym(eb), m_edges.Sym(diag));
+    m_edges.set_end_points(diag, va, vc);
 
     m_starting_edge = ea;
 
     m_first_face.clear();
 
-    make_face(ea->Sym());
-    make_face(ec->Sym());
+    m_domain = BBox2D(a, b);
+    m_domain.add(c);
+    m_domain.add(d);
+    m_hints.clear();
+
+    make_face(m_edges.Sym(ea));
+    make_face(m_edges.Sym(ec));
 }
 
 void DelaunayMesh::delete_edge(qe_ptr e)
 {
-    splice(e, e->Oprev());
-    splice(e->Sym(), e->Sym()->Oprev());
-    e->recycle_next();
-    e.recycle();
+    m_edges.splice(e, m_edges.Oprev(e));
+    m_edges.splice(m_edges.Sym(e), m_edges.Oprev(m_edges.Sym(e)));
+    m_edges.recycle_edge(e);
 }
 
 qe_ptr DelaunayMesh::connect(qe_ptr a, qe_ptr b)
 {
-    qe_ptr e = m_edges->spawn();
-    e->init(e);
+    qe_ptr e = m_edges.make_edge();
 
-    splice(e, a->Lnext());
-    splice(e->Sym(), b);
-    e->set_end_points(a->Dest(), b->Org());
+    m_edges.splice(e, m_edges.Lnext(a));
+    m_edges.splice(m_edges.Sym(e), b);
+    m_edges.set_end_points(e, m_edges.dest_vertex(a), m_edges.org_vertex(b));
     return e;
 }
 
 void DelaunayMesh::swap(qe_ptr e)
 {
-    dt_ptr f1 = e->Lface();
-    dt_ptr f2 = e->Sym()->Lface();
+    dt_ptr f1 = m_edges.Lface(e);
+    dt_ptr f2 = m_edges.Lface(m_edges.Sym(e));
 
-    qe_ptr a = e->Oprev();
-    qe_ptr b = e->Sym()->Oprev();
+    qe_ptr a = m_edges.Oprev(e);
+    qe_ptr b = m_edges.Oprev(m_edges.Sym(e));
 
-    splice(e, a);
-    splice(e->Sym(), b);
-    splice(e, a->Lnext());
-    splice(e->Sym(), b->Lnext());
-    e->set_end_points(a->Dest(), b->Dest());
+    m_edges.splice(e, a);
+    m_edges.splice(m_edges.Sym(e), b);
+    m_edges.splice(e, m_edges.Lnext(a));
+    m_edges.splice(m_edges.Sym(e), m_edges.Lnext(b));
+    m_edges.set_end_points(e, m_edges.dest_vertex(a), m_edges.dest_vertex(b));
 
-    f1->reshape(e);
-    f2->reshape(e->Sym());
+    reshape(f1, e);
+    reshape(f2, m_edges.Sym(e));
 }
 
 //
@@ -92,36 +117,40 @@ void DelaunayMesh::swap(qe_ptr e)
 
 bool DelaunayMesh::ccw_boundary(qe_ptr e)
 {
-    return !rightOf(e->Oprev()->Dest(), e);
+    return !rightOf(m_edges.Dest(m_edges.Oprev(e)), e);
 }
 
 bool DelaunayMesh::on_edge(const Point2D x, qe_ptr e)
 {
     double t1, t2, t3;
 
-    t1 = (x - e->Org()).length();
-    t2 = (x - e->Dest()).length();
+    const Point2D org = m_edges.Org(e);
+    const Point2D dest = m_edges.Dest(e);
+
+    t1 = (x - org).length();
+    t2 = (x - dest).length();
 
     if(t1 < EPS || t2 < EPS) return true;
 
-    t3 = (e->Org() - e->Dest()).length();
+    t3 = (org - dest).length();
 
     if(t1 > t3 || t2 > t3) return false;
 
-    Line line(e->Org(), e->Dest());
+    Line line(org, dest);
     return (fabs(line.eval(x)) < EPS);
 }
 
 // Tests whether e is an interior edge
 bool DelaunayMesh::is_interior(qe_ptr e)
 {
-    return (e->Lnext()->Lnext()->Lnext() == e && e->Rnext()->Rnext()->Rnext() == e);
+    return (m_edges.Lnext(m_edges.Lnext(m_edges.Lnext(e))) == e &&
+            m_edges.Rnext(m_edges.Rnext(m_edges.Rnext(e))) == e);
 }
 
 bool DelaunayMesh::should_swap(const Point2D x, qe_ptr e)
 {
-    qe_ptr t = e->Oprev();
-    return inCircle(e->Org(), t->Dest(), e->Dest(), x);
+    qe_ptr t = m_edges.Oprev(e);
+    return inCircle(m_edges.Org(e), m_edges.Dest(t), m_edges.Dest(e), x);
 }
 
 void DelaunayMesh::scan_triangle(dt_ptr t)
@@ -129,24 +158,63 @@ void DelaunayMesh::scan_triangle(dt_ptr t)
     // noop
 }
 
+void DelaunayMesh::enable_hint_grid(const double cell_size)
+{
+    TNTN_ASSERT(cell_size > 0);
+
+    const double w = m_domain.max.x - m_domain.min.x;
+    const double h = m_domain.max.y - m_domain.min.y;
+    m_hints_scale = 1.0 / cell_size;
+    m_hints_width = static_cast<int>(w * m_hints_scale) + 1;
+    m_hints_height = static_cast<int>(h * m_hints_scale) + 1;
+    m_hints.assign(static_cast<size_t>(m_hints_width) * m_hints_height, qe_ptr());
+}
+
+qe_ptr* DelaunayMesh::hint_cell(const Point2D& x)
+{
+    if(m_hints.empty())
+    {
+        return nullptr;
+    }
+
+    const int cx = static_cast<int>((x.x - m_domain.min.x) * m_hints_scale);
+    const int cy = static_cast<int>((x.y - m_domain.min.y) * m_hints_scale);
+    if(cx < 0 || cy < 0 || cx >= m_hints_width || cy >= m_hints_height)
+    {
+        return nullptr;
+    }
+    return &m_hints[static_cast<size_t>(cy) * m_hints_width + cx];
+}
+
+qe_ptr DelaunayMesh::locate(const Point2D x)
+{
+    // edges of a cell are only hints, they may have been deleted since
+    const qe_ptr* hint = hint_cell(x);
+    if(hint != nullptr && *hint && m_edges.is_live(*hint))
+    {
+        return locate(x, *hint);
+    }
+    return locate(x, m_starting_edge);
+}
+
 qe_ptr DelaunayMesh::locate(const Point2D x, qe_ptr start)
 {
     qe_ptr e = start;
-    double t = triArea(x, e->Dest(), e->Org());
+    double t = triArea(x, m_edges.Dest(e), m_edges.Org(e));
 
     if(t > 0)
     { // x is to the right of edge e
         t = -t;
-        e = e->Sym();
+        e = m_edges.Sym(e);
     }
 
     while(true)
     {
-        qe_ptr eo = e->Onext();
-        qe_ptr ed = e->Dprev();
+        qe_ptr eo = m_edges.Onext(e);
+        qe_ptr ed = m_edges.Dprev(e);
 
-        double to = triArea(x, eo->Dest(), eo->Org());
-        double td = triArea(x, ed->Dest(), ed->Org());
+        double to = triArea(x, m_edges.Dest(eo), m_edges.Org(eo));
+        double td = triArea(x, m_edges.Dest(ed), m_edges.Org(ed));
 
         if(td > 0)
         { // x is below ed
@@ -184,10 +252,10 @@ qe_ptr DelaunayMesh::locate(const Point2D x, qe_ptr start)
             else
             {
                 // x is on or below eo
-                if(t == 0 && !leftOf(eo->Dest(), e))
+                if(t == 0 && !leftOf(m_edges.Dest(eo), e))
                 {
                     // x on e but DelaunayMesh is to right
-                    e = e->Sym();
+                    e = m_edges.Sym(e);
                 }
                 else if((next_random_number() & 1) == 0)
                 {
@@ -212,8 +280,8 @@ qe_ptr DelaunayMesh::spoke(const Point2D x, qe_ptr e)
 
     qe_ptr boundary_edge;
 
-    dt_ptr lface = e->Lface();
-    lface->dontAnchor(e);
+    dt_ptr lface = m_edges.Lface(e);
+    dont_anchor(lface, e);
     new_faces[facedex++] = lface;
 
     if(on_edge(x, e))
@@ -226,12 +294,12 @@ qe_ptr DelaunayMesh::spoke(const Point2D x, qe_ptr e)
         }
         else
         {
-            dt_ptr sym_lface = e->Sym()->Lface();
+            dt_ptr sym_lface = m_edges.Lface(m_edges.Sym(e));
             new_faces[facedex++] = sym_lface;
-            sym_lface->dontAnchor(e->Sym());
+            dont_anchor(sym_lface, m_edges.Sym(e));
 
-            e = e->Oprev();
-            delete_edge(e->Onext());
+            e = m_edges.Oprev(e);
+            delete_edge(m_edges.Onext(e));
         }
     }
     else
@@ -239,40 +307,39 @@ qe_ptr DelaunayMesh::spoke(const Point2D x, qe_ptr e)
         // x lies within the Lface of e
     }
 
-    qe_ptr base = m_edges->spawn();
-    base->init(base);
+    qe_ptr base = m_edges.make_edge();
 
-    base->set_end_points(e->Org(), x);
+    m_edges.set_end_points(base, m_edges.org_vertex(e), m_edges.add_vertex(x));
 
-    splice(base, e);
+    m_edges.splice(base, e);
 
     m_starting_edge = base;
     do
     {
-        base = connect(e, base->Sym());
-        e = base->Oprev();
-    } while(e->Lnext() != m_starting_edge);
+        base = connect(e, m_edges.Sym(base));
+        e = m_edges.Oprev(base);
+    } while(m_edges.Lnext(e) != m_starting_edge);
 
     if(boundary_edge) delete_edge(boundary_edge);
 
     // Update all the faces in our new spoked polygon.
     // If point x on perimeter, then don't add an exterior face.
 
-    base = boundary_edge ? m_starting_edge->Rprev() : m_starting_edge->Sym();
+    base = boundary_edge ? m_edges.Rprev(m_starting_edge) : m_edges.Sym(m_starting_edge);
 
     do
     {
         if(facedex)
         {
-            new_faces[--facedex]->reshape(base);
+            reshape(new_faces[--facedex], base);
         }
         else
         {
             make_face(base);
         }
 
-        base = base->Onext();
-    } while(base != m_starting_edge->Sym());
+        base = m_edges.Onext(base);
+    } while(base != m_edges.Sym(m_starting_edge));
 
     return m_starting_edge;
 }
@@ -285,14 +352,14 @@ void DelaunayMesh::optimize(const Point2D x, qe_ptr s)
 
     do
     {
-        qe_ptr e = spoke->Lnext();
+        qe_ptr e = m_edges.Lnext(spoke);
         if(is_interior(e) && should_swap(x, e))
         {
             swap(e);
         }
         else
         {
-            spoke = spoke->Onext();
+            spoke = m_edges.Onext(spoke);
             if(spoke == start_spoke) break;
         }
     } while(true);
@@ -302,20 +369,20 @@ void DelaunayMesh::optimize(const Point2D x, qe_ptr s)
 
     do
     {
-        qe_ptr e = spoke->Lnext();
-        dt_ptr t = e->Lface();
+        qe_ptr e = m_edges.Lnext(spoke);
+        dt_ptr t = m_edges.Lface(e);
 
         if(t) this->scan_triangle(t);
 
-        spoke = spoke->Onext();
+        spoke = m_edges.Onext(spoke);
     } while(spoke != start_spoke);
 }
 
 void DelaunayMesh::insert(const Point2D x, dt_ptr tri)
 {
-    qe_ptr e = tri ? locate(x, tri->getAnchor()) : locate(x);
+    qe_ptr e = tri ? locate(x, triangle(tri).anchor) : locate(x);
 
-    if((x == e->Org()) || (x == e->Dest()))
+    if((x == m_edges.Org(e)) || (x == m_edges.Dest(e)))
     {
         // point is already in the mesh, so update the triangles x is in
         optimize(x, e);
@@ -325,8 +392,71 @@ void DelaunayMesh::insert(const Point2D x, dt_ptr tri)
         qe_ptr start_spoke = spoke(x, e);
         if(start_spoke)
         {
-            optimize(x, start_spoke->Sym());
+            optimize(x, m_edges.Sym(start_spoke));
+
+            qe_ptr* hint = hint_cell(x);
+            if(hint != nullptr)
+            {
+                *hint = m_edges.Sym(start_spoke);
+            }
+        }
+    }
+}
+
+// row-major sort key of an integer point
+static uint64_t point_key(const Point2D& p)
+{
+    return (static_cast<uint64_t>(static_cast<uint32_t>(p.y)) << 32) |
+           static_cast<uint32_t>(p.x);
+}
+
+void DelaunayMesh::export_indexed(std::vector<glm::ivec2>& points, std::vector<Face>& faces)
+{
+    points.clear();
+    faces.clear();
+
+    // corners of every face, already in output orientation
+    std::vector<uint64_t> corners;
+    for(dt_ptr t = m_first_face; t; t = next_face(t))
+    {
+        const std::array<Point2D, 3> p = triangle_points(t);
+        const Point2D& p1 = p[0];
+        const Point2D& p2 = p[1];
+        const Point2D& p3 = p[2];
+
+        if(!ccw(p1, p2, p3))
+        {
+            corners.push_back(point_key(p1));
+            corners.push_back(point_key(p2));
+            corners.push_back(point_key(p3));
+        }
+        else
+        {
+            corners.push_back(point_key(p3));
+            corners.push_back(point_key(p2));
+            corners.push_back(point_key(p1));
+        }
+    }
+
+    std::vector<uint64_t> keys(corners);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    points.reserve(keys.size());
+    for(const uint64_t k : keys)
+    {
+        points.emplace_back(static_cast<int>(k & 0xffffffff), static_cast<int>(k >> 32));
+    }
+
+    faces.reserve(corners.size() / 3);
+    for(size_t i = 0; i < corners.size(); i += 3)
+    {
+        Face f;
+        for(int n = 0; n < 3; n++)
+        {
+            f[n] = std::lower_bound(keys.begin(), keys.end(), corners[i + n]) - keys.begin();
         }
+        faces.push_back(f);
     }
 }
 
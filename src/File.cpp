@@ -3,7 +3,11 @@
 
 #include <cstdio>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace tntn {
 
@@ -244,6 +248,84 @@ void File::flush()
     return m_impl->flush();
 }
 
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char* filename)
+{
+    close();
+
+    const int fd = ::open(filename, O_RDONLY);
+    if(fd < 0)
+    {
+        const auto err = errno;
+        TNTN_LOG_ERROR("unable to open file {} for mapping, errno = {}", filename, err);
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        const auto err = errno;
+        TNTN_LOG_ERROR("unable to stat file {}, errno = {}", filename, err);
+        ::close(fd);
+        return false;
+    }
+
+    if(static_cast<uint64_t>(st.st_size) > std::numeric_limits<size_t>::max())
+    {
+        TNTN_LOG_ERROR("file {} is too large to be mapped", filename);
+        ::close(fd);
+        return false;
+    }
+
+    const size_t size = static_cast<size_t>(st.st_size);
+    void* data = nullptr;
+    if(size > 0)
+    {
+        data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data == MAP_FAILED)
+        {
+            const auto err = errno;
+            TNTN_LOG_ERROR("unable to map file {}, errno = {}", filename, err);
+            ::close(fd);
+            return false;
+        }
+    }
+
+    // the mapping stays valid after closing the descriptor
+    ::close(fd);
+
+    m_data = static_cast<const unsigned char*>(data);
+    m_size = size;
+    m_is_open = true;
+    m_filename = filename;
+    return true;
+}
+
+bool MappedFile::open(const std::string& filename)
+{
+    return open(filename.c_str());
+}
+
+void MappedFile::close()
+{
+    if(m_data != nullptr)
+    {
+        if(munmap(const_cast<unsigned char*>(m_data), m_size) != 0)
+        {
+            const auto err = errno;
+            TNTN_LOG_DEBUG("munmap on {} failed with errno {}", m_filename, err);
+        }
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_is_open = false;
+    m_filename.clear();
+}
+
 bool MemoryFile::is_good()
 {
     return m_is_good;
@@ -1,5 +1,7 @@
 #include "tntn/MercatorProjection.h"
 
+#include <cmath>
+
 namespace tntn {
 
 MercatorProjection::MercatorProjection(int _tileSize) : m_TileSize(_tileSize)
@@ -79,4 +81,33 @@ BoundingBox MercatorProjection::TileBounds(const int _tx, const int _ty, const i
             PixelsToMeters({(_tx + 1) * m_TileSize, (_ty + 1) * m_TileSize}, _zoom)};
 }
 
+// WGS84 ellipsoid
+static constexpr double WGS84_A = R_EARTH;
+static constexpr double WGS84_F = 1.0 / 298.257223563;
+static constexpr double WGS84_E2 = WGS84_F * (2.0 - WGS84_F);
+
+glm::dvec3 web_mercator_to_ecef(const glm::dvec3& meters)
+{
+    // EPSG:3857 is a spherical projection of WGS84 longitude and latitude
+    const double lon = meters.x / R_EARTH;
+    const double lat = 2.0 * atan(exp(meters.y / R_EARTH)) - PI * 0.5;
+    const double h = meters.z;
+
+    const double sin_lat = sin(lat);
+    const double cos_lat = cos(lat);
+    const double n = WGS84_A / sqrt(1.0 - WGS84_E2 * sin_lat * sin_lat);
+
+    return glm::dvec3((n + h) * cos_lat * cos(lon),
+                      (n + h) * cos_lat * sin(lon),
+                      (n * (1.0 - WGS84_E2) + h) * sin_lat);
+}
+
+void web_mercator_to_ecef(const glm::dvec3* in, const size_t count, glm::dvec3* out)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        out[i] = web_mercator_to_ecef(in[i]);
+    }
+}
+
 } //namespace tntn
@@ -3,12 +3,12 @@
 #include <utility>
 #include <memory>
 #include <limits>
-#include <unordered_map>
 #include <unordered_set>
 
 #include "tntn/tntn_assert.h"
 #include "tntn/logging.h"
 #include "tntn/geometrix.h"
+#include "tntn/VertexLookup.h"
 
 namespace tntn {
 
@@ -113,28 +113,14 @@ void Mesh::generate_decomposed()
     m_faces.reserve(m_triangles.size());
     m_vertices.reserve(m_triangles.size() * 0.66);
 
-    std::unordered_map<Vertex, VertexIndex> vertex_lookup;
-    vertex_lookup.reserve(m_vertices.capacity());
+    VertexLookup vertex_lookup(m_vertices.capacity());
 
     for(const auto& t : m_triangles)
     {
         Face f;
         for(int i = 0; i < 3; i++)
         {
-            const Vertex& v = t[i];
-            const auto v_it = vertex_lookup.find(v);
-            if(v_it != vertex_lookup.end())
-            {
-                //vertex already in m_vertices;
-                f[i] = v_it->second;
-            }
-            else
-            {
-                //new vertex
-                f[i] = m_vertices.size();
-                vertex_lookup.emplace_hint(v_it, v, m_vertices.size());
-                m_vertices.push_back(v);
-            }
+            f[i] = vertex_lookup.find_or_insert(t[i], m_vertices);
         }
         m_faces.push_back(f);
     }
@@ -9,6 +9,25 @@ bool ObjMeshWriter::write_mesh_to_file(const char* filename, Mesh& mesh, const B
     return write_mesh_as_obj(filename, mesh);
 }
 
+bool ObjMeshWriter::write_mesh(const std::shared_ptr<FileLike>& f, Mesh& mesh, const BBox3D& bbox)
+{
+    return write_mesh_as_obj(*f, mesh);
+}
+
+bool ObjMeshWriter::encode_mesh(Mesh& mesh,
+                                const BBox3D& bbox,
+                                std::vector<unsigned char>& buffer)
+{
+    auto f = std::make_shared<MemoryFile>();
+    if(!write_mesh_as_obj(*f, mesh))
+    {
+        buffer.clear();
+        return false;
+    }
+    buffer = f->data();
+    return true;
+}
+
 std::string ObjMeshWriter::file_extension()
 {
     return "obj";
@@ -19,6 +38,20 @@ bool QuantizedMeshWriter::write_mesh_to_file(const char* filename, Mesh& mesh, c
     return write_mesh_as_qm(filename, mesh, bbox, true);
 }
 
+bool QuantizedMeshWriter::write_mesh(const std::shared_ptr<FileLike>& f,
+                                     Mesh& mesh,
+                                     const BBox3D& bbox)
+{
+    return write_mesh_as_qm(f, mesh, bbox, true);
+}
+
+bool QuantizedMeshWriter::encode_mesh(Mesh& mesh,
+                                      const BBox3D& bbox,
+                                      std::vector<unsigned char>& buffer)
+{
+    return encode_mesh_as_qm(mesh, bbox, true, buffer);
+}
+
 std::string QuantizedMeshWriter::file_extension()
 {
     return "terrain";
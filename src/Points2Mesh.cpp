@@ -1,9 +1,17 @@
 
 #include "tntn/Points2Mesh.h"
 #include "tntn/logging.h"
+#include "tntn/tntn_assert.h"
 
 #include "delaunator_cpp/Delaunator.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <tuple>
+
 using namespace std;
 namespace tntn {
 
@@ -37,42 +45,147 @@ bool generate_delaunay_faces(const std::vector<Vertex>& vlist, std::vector<Face>
     return false;
 }
 
-std::vector<int> check_duplicates(const std::vector<Vertex>& vlist, double precision)
+namespace {
+
+// a point with the coordinates of its grid cell, cells are precision wide
+struct CellPoint
+{
+    int64_t cx;
+    int64_t cy;
+    int index;
+
+    bool operator<(const CellPoint& other) const
+    {
+        return std::tie(cx, cy, index) < std::tie(other.cx, other.cy, other.index);
+    }
+};
+
+// grid cell of a coordinate, clamped to +-2^62 so that the cast is defined for huge,
+// infinite and NaN values and the neighbouring cells can't overflow;
+// clamped points only share a cell, the distance check stays exact
+int64_t grid_cell(const double coordinate, const double precision)
 {
-    int dcount = 0;
+    const double limit = 4611686018427387904.0;
+    const double cell = std::floor(coordinate / precision);
+    if(cell < limit && cell > -limit)
+    {
+        return static_cast<int64_t>(cell);
+    }
+    return static_cast<int64_t>(cell >= limit ? limit : -limit);
+}
 
+} // namespace
+
+std::vector<int> check_duplicates(const std::vector<Vertex>& vlist,
+                                  const double precision,
+                                  const int num_threads)
+{
     std::vector<int> duplicates;
+    if(!(precision > 0) || vlist.size() < 2)
+    {
+        return duplicates;
+    }
 
-    double p2 = precision * precision;
-    for(int i = 0; i < vlist.size(); i++)
+    TNTN_ASSERT(vlist.size() <= static_cast<size_t>(std::numeric_limits<int>::max()));
+    const int n = static_cast<int>(vlist.size());
+
+    // sort the points by grid cell, points closer than precision
+    // are in the same or in one of the 8 neighbouring cells
+    std::vector<CellPoint> cells(n);
+    for(int i = 0; i < n; i++)
     {
-        for(int j = i; j < vlist.size(); j++)
+        cells[i].cx = grid_cell(vlist[i].x, precision);
+        cells[i].cy = grid_cell(vlist[i].y, precision);
+        cells[i].index = i;
+    }
+    std::sort(cells.begin(), cells.end());
+
+    const double p2 = precision * precision;
+    std::vector<char> is_duplicate(n, 0);
+
+    // a point is a duplicate if a point with a larger index is closer than precision,
+    // so of every group of duplicates the one with the largest index survives
+    auto check_range = [&](const int begin, const int end) {
+        for(int k = begin; k < end; k++)
         {
-            if(i != j)
+            const CellPoint& c = cells[k];
+            const Vertex& v = vlist[c.index];
+            bool found = false;
+            for(int64_t dx = -1; dx <= 1 && !found; dx++)
             {
-                double dx = vlist[i].x - vlist[j].x;
-                double dy = vlist[i].y - vlist[j].y;
-                double dd = dx * dx + dy * dy;
-
-                if(dd < p2)
+                const CellPoint first = {c.cx + dx, c.cy - 1, c.index + 1};
+                const CellPoint last = {c.cx + dx, c.cy + 1, n};
+                auto it = std::lower_bound(cells.begin(), cells.end(), first);
+                const auto it_end = std::upper_bound(it, cells.end(), last);
+                for(; it != it_end; ++it)
                 {
-                    duplicates.push_back(i);
-                    dcount++;
+                    if(it->index <= c.index)
+                    {
+                        continue;
+                    }
+                    const double ddx = v.x - vlist[it->index].x;
+                    const double ddy = v.y - vlist[it->index].y;
+                    if(ddx * ddx + ddy * ddy < p2)
+                    {
+                        found = true;
+                        break;
+                    }
                 }
             }
+            is_duplicate[c.index] = found ? 1 : 0;
+        }
+    };
+
+    const int workers = std::max(1, std::min(num_threads, n / 4096 + 1));
+    if(workers == 1)
+    {
+        check_range(0, n);
+    }
+    else
+    {
+        std::vector<std::thread> threads;
+        threads.reserve(workers);
+        for(int i = 0; i < workers; i++)
+        {
+            const int begin = static_cast<int>(static_cast<int64_t>(n) * i / workers);
+            const int end = static_cast<int>(static_cast<int64_t>(n) * (i + 1) / workers);
+            threads.emplace_back(check_range, begin, end);
+        }
+        for(auto& t : threads)
+        {
+            t.join();
         }
     }
 
+    for(int i = 0; i < n; i++)
+    {
+        if(is_duplicate[i])
+        {
+            duplicates.push_back(i);
+        }
+    }
     return duplicates;
 }
 
-void remove_duplicates(std::vector<Vertex>& vlist, const std::vector<int> del)
+void remove_duplicates(std::vector<Vertex>& vlist, const std::vector<int>& del)
 {
-    for(int i : del)
+    std::vector<char> is_deleted(vlist.size(), 0);
+    for(const int i : del)
     {
-        vlist[i] = vlist.back();
-        vlist.pop_back();
+        TNTN_ASSERT(i >= 0 && static_cast<size_t>(i) < vlist.size());
+        is_deleted[i] = 1;
+    }
+
+    // keeps the order of the remaining vertices
+    size_t out = 0;
+    for(size_t i = 0; i < vlist.size(); i++)
+    {
+        if(!is_deleted[i])
+        {
+            vlist[out++] = vlist[i];
+        }
     }
+    vlist.resize(out);
 }
 
 std::unique_ptr<Mesh> generate_delaunay_mesh(std::vector<Vertex>&& vlist)
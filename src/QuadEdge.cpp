@@ -1,147 +1,101 @@
 #include "tntn/QuadEdge.h"
-#include "tntn/DelaunayTriangle.h"
-#include "tntn/tntn_assert.h"
+
+#include <algorithm>
 
 namespace tntn {
 namespace terra {
 
-#if 0
-QuadEdge::QuadEdge(qe_ptr prev)
-{
-    qprev = prev;
-    prev->qnext = this;
-}
-
-QuadEdge::QuadEdge()
-{
-    QuadEdge *e0 = this;
-    QuadEdge *e1 = new QuadEdge(e0);
-    QuadEdge *e2 = new QuadEdge(e1);
-    QuadEdge *e3 = new QuadEdge(e2);
-    
-    qprev = e3;
-    e3->qnext = e0;
-    
-    e0->next = e0;
-    e1->next = e3;
-    e2->next = e2;
-    e3->next = e1;
-}
-#endif
-
-//init with dual edge qprev aka invRot
-void QuadEdge::init(qe_ptr self_ptr, qe_ptr qprev)
-{
-    TNTN_ASSERT(self_ptr.get() == this);
-    this->self_ptr = self_ptr;
-
-    this->qprev = qprev;
-    qprev->qnext = self_ptr;
-}
-
 /*
-
- creates 3 more QuadEdges
-
- this=e0
- e1,e2,e3
-
-
- they are linked together like this:
+ an edge e0 and its rotations e1, e2, e3 share one QuadEdge record,
+ initially linked like this:
 
           |        ^ e0
           |  _---->|
- e1       | /qprev |
+ e1       | /invRot|
  <--------+--------+----------
      ^    |        |
       \___|        |
-    qprev |        |___
-          |        |   \ qprev
+   invRot |        |___
+          |        |   \ invRot
           |        |    V
  ---------+--------+--------->
-          | qprev/ |         e3
+          |invRot/ |         e3
           |<-___/  |
        e2 V        |
  */
-void QuadEdge::init(qe_ptr self_ptr)
+qe_ptr QuadEdgePool::make_edge()
 {
-    TNTN_ASSERT(self_ptr.get() == this);
-    this->self_ptr = self_ptr;
-
-    qe_ptr e0 = self_ptr;
+    const size_t record = m_pool->spawn().index();
+    TNTN_ASSERT(record < (size_t(1) << 30));
+    const uint32_t e0 = static_cast<uint32_t>(record) << 2;
 
-    qe_ptr e1 = self_ptr.pool()->spawn();
-    qe_ptr e2 = self_ptr.pool()->spawn();
-    qe_ptr e3 = self_ptr.pool()->spawn();
+    QuadEdge& q = (*m_pool)[record];
+    q.next[0] = qe_ptr(e0);
+    q.next[1] = qe_ptr(e0 + 3);
+    q.next[2] = qe_ptr(e0 + 2);
+    q.next[3] = qe_ptr(e0 + 1);
 
-    e1->init(e1, e0);
-    e2->init(e2, e1);
-    e3->init(e3, e2);
-
-    e0->qprev = e3;
-    e3->qnext = e0;
+    return qe_ptr(e0);
+}
 
-    e0->next = e0;
-    e1->next = e3;
-    e2->next = e2;
-    e3->next = e1;
+void QuadEdgePool::recycle_edge(const qe_ptr e)
+{
+    record(e).next[0].clear();
+    m_pool->recycle(pool_ptr<QuadEdge>(m_pool.get(), e.index() >> 2));
 }
 
-#if 0
-QuadEdge::~QuadEdge()
+void QuadEdgeArrays::reserve(const size_t edges)
 {
-    if (qnext) {
-        QuadEdge *e1 = qnext;
-        QuadEdge *e2 = qnext->qnext;
-        QuadEdge *e3 = qprev;
-        
-        e1->qnext = NULL;
-        e2->qnext = NULL;
-        e3->qnext = NULL;
-        
-        delete e1;
-        delete e2;
-        delete e3;
-    }
+    m_next.reserve(4 * edges);
+    m_org.reserve(2 * edges);
+    m_lface.reserve(2 * edges);
+    m_vertices.reserve(edges / 3);
 }
-#endif
 
-void QuadEdge::recycle_next()
+qe_ptr QuadEdgeArrays::make_edge()
 {
-    if(qnext)
+    uint32_t e0;
+    if(!m_free.empty())
     {
-        qe_ptr e1 = qnext;
-        qe_ptr e2 = qnext->qnext;
-        qe_ptr e3 = qprev;
+        e0 = m_free.back();
+        m_free.pop_back();
+    }
+    else
+    {
+        TNTN_ASSERT(m_next.size() < 0xfffffffc);
+        e0 = static_cast<uint32_t>(m_next.size());
+        m_next.resize(m_next.size() + 4);
+        m_org.resize(m_org.size() + 2);
+        m_lface.resize(m_lface.size() + 2);
+    }
 
-        e1->qnext.clear();
-        e2->qnext.clear();
-        e3->qnext.clear();
+    // linked like the rotations of a QuadEdgePool record
+    m_next[e0] = qe_ptr(e0);
+    m_next[e0 + 1] = qe_ptr(e0 + 3);
+    m_next[e0 + 2] = qe_ptr(e0 + 2);
+    m_next[e0 + 3] = qe_ptr(e0 + 1);
+    m_lface[e0 >> 1].clear();
+    m_lface[(e0 >> 1) + 1].clear();
 
-        //TODO this a recursive graph traversal on the stack... make this iterative
-        e1->recycle_next();
-        e1.recycle();
-        e2->recycle_next();
-        e2.recycle();
-        e3->recycle_next();
-        e3.recycle();
-    }
+    m_peak_live = std::max(m_peak_live, m_next.size() / 4 - m_free.size());
+    return qe_ptr(e0);
 }
 
-void splice(qe_ptr a, qe_ptr b)
+void QuadEdgeArrays::recycle_edge(const qe_ptr e)
 {
-    qe_ptr alpha = a->Onext()->Rot();
-    qe_ptr beta = b->Onext()->Rot();
-
-    qe_ptr t1 = b->Onext();
-    qe_ptr t2 = a->Onext();
-    qe_ptr t3 = beta->Onext();
-    qe_ptr t4 = alpha->Onext();
+    const uint32_t e0 = e.index() & ~3u;
+    m_next[e0].clear();
+    m_free.push_back(e0);
+}
 
-    a->next = t1;
-    b->next = t2;
-    alpha->next = t3;
-    beta->next = t4;
+ObjPool<QuadEdge>::Stats QuadEdgeArrays::stats() const
+{
+    ObjPool<QuadEdge>::Stats s;
+    s.live = m_next.size() / 4 - m_free.size();
+    s.free = m_free.size();
+    s.peak_live = m_peak_live;
+    s.capacity = m_next.capacity() / 4;
+    return s;
 }
 
 } //namespace terra
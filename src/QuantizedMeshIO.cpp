@@ -1,27 +1,24 @@
 #include "tntn/QuantizedMeshIO.h"
+#include "tntn/QuantizedMeshView.h"
 
 #include "tntn/OFFReader.h"
+#include "tntn/MercatorProjection.h"
 #include "tntn/logging.h"
 #include "tntn/tntn_assert.h"
-#include "tntn/BinaryIO.h"
+#include "tntn/endianness.h"
+#include "tntn/VertexLookup.h"
 
 #include <iostream>
 #include <fstream>
 #include <set>
+#include <cmath>
 
-#include <unordered_map>
 #include "glm/glm.hpp"
 
-#include <ogr_spatialref.h>
-#include <gdal_priv.h>
-
 //FIXME: remove collappsed vertices/triangles after quantization of mesh
 
 namespace tntn {
 
-typedef glm::dvec3 QMVertex;
-typedef std::unordered_map<Vertex, unsigned int> VertexOrdering;
-
 struct QuantizedMeshLog
 {
     File::position_type QuantizedMeshHeader_start = 0;
@@ -57,40 +54,6 @@ struct QuantizedMeshLog
     }
 };
 
-struct QuantizedMeshHeader
-{
-    // The center of the tile in Earth-centered Fixed coordinates.
-    // double CenterX;
-    // double CenterY;
-    // double CenterZ;
-
-    QMVertex center;
-
-    // The minimum and maximum heights in the area covered by this tile.
-    // The minimum may be lower and the maximum may be higher than
-    // the height of any vertex in this tile in the case that the min/max vertex
-    // was removed during mesh simplification, but these are the appropriate
-    // values to use for analysis or visualization.
-    float MinimumHeight;
-    float MaximumHeight;
-
-    // The tile’s bounding sphere.  The X,Y,Z coordinates are again expressed
-    // in Earth-centered Fixed coordinates, and the radius is in meters.
-    QMVertex bounding_sphere_center;
-    // double BoundingSphereCenterX;
-    // double BoundingSphereCenterY;
-    // double BoundingSphereCenterZ;
-    double BoundingSphereRadius;
-
-    // The horizon occlusion point, expressed in the ellipsoid-scaled Earth-centered Fixed frame.
-    // If this point is below the horizon, the entire tile is below the horizon.
-    // See http://cesiumjs.org/2013/04/25/Horizon-culling/ for more information.
-    QMVertex horizon_occlusion;
-    // double HorizonOcclusionPointX;
-    // double HorizonOcclusionPointY;
-    // double HorizonOcclusionPointZ;
-};
-
 namespace detail {
 
 uint16_t zig_zag_encode(int16_t i)
@@ -143,110 +106,91 @@ static double dequantize_coordinate(const int v, const double min, const double
     return deq_coord;
 }
 
-static void add_alignment(BinaryIO& bio,
-                          BinaryIOErrorTracker& e,
-                          const int alignment,
-                          const uint8_t value = 0xCA)
+namespace {
+
+// appends little endian values to a byte buffer
+class QMBuffer
 {
-    const auto sp = bio.write_pos();
-    const int pad_size = sp % alignment == 0 ? 0 : alignment - (sp % alignment);
+  public:
+    explicit QMBuffer(std::vector<unsigned char>& out) : m_out(out) {}
 
-    for(int i = 0; i < pad_size; i++)
+    size_t pos() const { return m_out.size(); }
+
+    template<typename T>
+    void append(const T value)
     {
-        bio.write_byte(value, e);
+        const size_t p = m_out.size();
+        m_out.resize(p + sizeof(T));
+        store_little_endian(value, m_out.data() + p);
     }
-}
-
-template<typename T>
-struct get_alignment_helper
-{
-};
 
-template<>
-struct get_alignment_helper<uint32_t>
-{
-    enum
+    template<typename T, typename V>
+    void append_array(const std::vector<V>& values)
     {
-        value = 4
-    };
-};
-template<>
-struct get_alignment_helper<uint16_t>
-{
-    enum
+        const size_t p = m_out.size();
+        m_out.resize(p + values.size() * sizeof(T));
+        unsigned char* dest = m_out.data() + p;
+        for(const V v : values)
+        {
+            store_little_endian(static_cast<T>(v), dest);
+            dest += sizeof(T);
+        }
+    }
+
+    void add_alignment(const int alignment, const uint8_t value = 0xCA)
     {
-        value = 2
-    };
+        const size_t sp = pos();
+        const int pad_size = sp % alignment == 0 ? 0 : alignment - (sp % alignment);
+        m_out.insert(m_out.end(), pad_size, value);
+    }
+
+  private:
+    std::vector<unsigned char>& m_out;
 };
 
+} // namespace
+
 template<typename IndexType>
-static void write_faces(BinaryIO& bio,
-                        BinaryIOErrorTracker& e,
+static void write_faces(QMBuffer& out,
                         QuantizedMeshLog& log,
-                        const SimpleRange<const Triangle*>& tris,
-                        const VertexOrdering& order)
+                        const std::vector<uint32_t>& corner_order)
 {
     typedef IndexType index_t;
 
     log.IndexData_bits = sizeof(index_t) * 8;
 
-    const uint32_t ntriangles = tris.distance();
+    const uint32_t ntriangles = corner_order.size() / 3;
 
-    std::vector<index_t> indices;
+    out.add_alignment(sizeof(index_t));
 
-    indices.reserve(static_cast<size_t>(ntriangles) * 3);
+    log.IndexData_triangleCount_start = out.pos();
+    log.IndexData_triangleCount = ntriangles;
+    out.append<uint32_t>(ntriangles);
+    log.IndexData_indices_start = out.pos();
 
     // High-water mark encode triangle indices
     index_t watermark = 0;
-    for(auto it = tris.begin; it != tris.end; ++it)
+    for(const uint32_t order : corner_order)
     {
-        for(int n = 0; n < 3; ++n)
-        {
-            const Vertex& v = (*it)[n];
-            const auto order_v_it = order.find(v);
-            TNTN_ASSERT(order_v_it != order.end());
-            TNTN_ASSERT(order_v_it->second <= std::numeric_limits<index_t>::max());
+        TNTN_ASSERT(order <= std::numeric_limits<index_t>::max());
 
-            const index_t index = order_v_it->second;
-            TNTN_ASSERT((int64_t)watermark - (int64_t)index >= 0);
-            const index_t delta = watermark - index;
+        const index_t index = order;
+        TNTN_ASSERT((int64_t)watermark - (int64_t)index >= 0);
+        const index_t delta = watermark - index;
 
-            indices.push_back(delta);
-            if(index == watermark)
-            {
-                watermark++;
-            }
+        out.append<index_t>(delta);
+        if(index == watermark)
+        {
+            watermark++;
         }
     }
-
-    const int alignment = get_alignment_helper<index_t>::value;
-    add_alignment(bio, e, alignment);
-
-    log.IndexData_triangleCount_start = bio.write_pos();
-    log.IndexData_triangleCount = ntriangles;
-    bio.write_uint32(ntriangles, e);
-    if(ntriangles > 0)
-    {
-        log.IndexData_indices_start = bio.write_pos();
-        bio.write_array(indices, e);
-    }
 }
 
 template<typename IndexType>
-static void write_indices(BinaryIO& bio,
-                          BinaryIOErrorTracker& e,
-                          const std::vector<uint32_t>& indices)
+static void write_indices(QMBuffer& out, const std::vector<uint32_t>& indices)
 {
-    const uint32_t nindices = indices.size();
-
-    bio.write_uint32(nindices, e);
-
-    //TODO specialize write for 16/32bit so 32bit write is fast
-    for(uint32_t i = 0; i < nindices; i++)
-    {
-        const IndexType index = indices[i];
-        bio.write(index, e);
-    }
+    out.append<uint32_t>(indices.size());
+    out.append_array<IndexType>(indices);
 }
 
 bool write_mesh_as_qm(const char* filename, const Mesh& m)
@@ -277,109 +221,113 @@ bool write_mesh_as_qm(const std::shared_ptr<FileLike>& f, const Mesh& m)
     return write_mesh_as_qm(f, m, bbox, false);
 }
 
-static void write_qmheader(BinaryIO& bio,
-                           BinaryIOErrorTracker& e,
-                           const QuantizedMeshHeader& qmheader)
+static void write_qmheader(QMBuffer& out, const QuantizedMeshHeader& qmheader)
 {
-    bio.write_double(qmheader.center.x, e);
-    bio.write_double(qmheader.center.y, e);
-    bio.write_double(qmheader.center.z, e);
+    out.append<double>(qmheader.center.x);
+    out.append<double>(qmheader.center.y);
+    out.append<double>(qmheader.center.z);
 
-    bio.write_float(qmheader.MinimumHeight, e);
-    bio.write_float(qmheader.MaximumHeight, e);
+    out.append<float>(qmheader.MinimumHeight);
+    out.append<float>(qmheader.MaximumHeight);
 
-    bio.write_double(qmheader.bounding_sphere_center.x, e);
-    bio.write_double(qmheader.bounding_sphere_center.y, e);
-    bio.write_double(qmheader.bounding_sphere_center.z, e);
-    bio.write_double(qmheader.BoundingSphereRadius, e);
+    out.append<double>(qmheader.bounding_sphere_center.x);
+    out.append<double>(qmheader.bounding_sphere_center.y);
+    out.append<double>(qmheader.bounding_sphere_center.z);
+    out.append<double>(qmheader.BoundingSphereRadius);
 
-    bio.write_double(qmheader.horizon_occlusion.x, e);
-    bio.write_double(qmheader.horizon_occlusion.y, e);
-    bio.write_double(qmheader.horizon_occlusion.z, e);
+    out.append<double>(qmheader.horizon_occlusion.x);
+    out.append<double>(qmheader.horizon_occlusion.y);
+    out.append<double>(qmheader.horizon_occlusion.z);
 }
 
-bool point_to_ecef(Vertex& p)
+// header fields derived from the tile bounds, center is already in ECEF coordinates
+static void fill_qmheader(const BBox3D& bbox, const Vertex& center, QuantizedMeshHeader& header)
 {
-    OGRSpatialReference mercator;
-    OGRSpatialReference ecef;
+    header.center = center;
+    header.bounding_sphere_center = center;
+    header.BoundingSphereRadius = glm::distance(bbox.min.xy(), bbox.max.xy());
 
-    mercator.importFromEPSG(3857);
-    ecef.importFromEPSG(4978);
+    header.MinimumHeight = bbox.min.z;
+    header.MaximumHeight = bbox.max.z;
 
-    std::unique_ptr<OGRCoordinateTransformation> tr(
-        OGRCreateCoordinateTransformation(&mercator, &ecef));
+    // FIXME: is there a better choice for a horizon occlusion point?
+    // Currently it's the center of tile elevated to bbox's max Z
+    header.horizon_occlusion = center;
+    header.horizon_occlusion.z = bbox.max.z;
+}
 
-    if(tr == nullptr)
+static bool is_finite(const Vertex& v)
+{
+    return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+}
+
+bool make_qm_header(const BBox3D& bbox, QuantizedMeshHeader& header)
+{
+    const Vertex center = web_mercator_to_ecef((bbox.max + bbox.min) / 2.0);
+    if(!is_finite(center))
     {
         return false;
     }
+    fill_qmheader(bbox, center, header);
+    return true;
+}
+
+bool make_qm_headers(const BBox3D* bboxes, const size_t count, QuantizedMeshHeader* headers)
+{
+    std::vector<Vertex> centers(count);
+    for(size_t i = 0; i < count; i++)
+    {
+        centers[i] = (bboxes[i].max + bboxes[i].min) / 2.0;
+    }
 
-    return (bool)tr->Transform(1, &p.x, &p.y, &p.z);
+    web_mercator_to_ecef(centers.data(), count, centers.data());
+
+    bool ok = true;
+    for(size_t i = 0; i < count; i++)
+    {
+        ok = is_finite(centers[i]) && ok;
+        fill_qmheader(bboxes[i], centers[i], headers[i]);
+    }
+    return ok;
 }
 
-bool write_mesh_as_qm(const std::shared_ptr<FileLike>& f,
-                      const Mesh& m,
-                      const BBox3D& bbox,
-                      bool mesh_is_rescaled)
+bool encode_mesh_as_qm(const Mesh& m,
+                       const BBox3D& bbox,
+                       bool mesh_is_rescaled,
+                       std::vector<unsigned char>& buffer)
 {
+    buffer.clear();
+
     if(!m.empty() && !m.has_triangles())
     {
         TNTN_LOG_ERROR("Mesh has to be triangulated in order to be written as QM");
         return false;
     }
 
-    BinaryIO bio(f, Endianness::LITTLE);
-    BinaryIOErrorTracker e;
     QuantizedMeshLog log;
 
     // Write QM Header
-    Vertex c = (bbox.max + bbox.min) / 2.0;
-
-    if(!point_to_ecef(c))
-    {
-        TNTN_LOG_ERROR("Conversion of tile center to ECEF coordinate system failed");
-        return false;
-    }
-
     QuantizedMeshHeader header;
-    header.center = c;
-    header.bounding_sphere_center = c;
-    header.BoundingSphereRadius = glm::distance(bbox.min.xy(), bbox.max.xy());
-
-    header.MinimumHeight = bbox.min.z;
-    header.MaximumHeight = bbox.max.z;
-
-    // FIXME: is there a better choice for a horizon occlusion point?
-    // Currently it's the center of tile elevated to bbox's max Z
-    header.horizon_occlusion = c;
-    header.horizon_occlusion.z = bbox.max.z;
-
-    log.QuantizedMeshHeader_start = bio.write_pos();
-    write_qmheader(bio, e, header);
-    if(e.has_error())
+    if(!make_qm_header(bbox, header))
     {
-        TNTN_LOG_ERROR("{} in file {}", e.to_string(), f->name());
+        TNTN_LOG_ERROR("Conversion of tile center to ECEF coordinate system failed");
         return false;
     }
-    TNTN_ASSERT(
-        bio.write_pos() ==
-        sizeof(QuantizedMeshHeader)); //might not be true for some platforms, mostly for debugging
 
     // Write QM vertex data
     std::vector<uint32_t> northlings;
     std::vector<uint32_t> eastlings;
     std::vector<uint32_t> southlings;
     std::vector<uint32_t> westlings;
-    VertexOrdering vertices_order;
     std::vector<uint16_t> us;
     std::vector<uint16_t> vs;
     std::vector<uint16_t> hs;
 
-    const uint32_t nvertices = m.vertices().distance();
+    const size_t expected_vertices = m.vertices().distance();
 
-    us.reserve(nvertices);
-    vs.reserve(nvertices);
-    hs.reserve(nvertices);
+    us.reserve(expected_vertices);
+    vs.reserve(expected_vertices);
+    hs.reserve(expected_vertices);
 
     int u = 0;
     int v = 0;
@@ -391,17 +339,23 @@ bool write_mesh_as_qm(const std::shared_ptr<FileLike>& f,
 
     auto triangles = m.triangles();
 
-    vertices_order.reserve(triangles.distance() / 2);
+    // vertices in order of first appearance and the order of every triangle corner,
+    // the corners are reused for the high-water mark encoding of the faces
+    std::vector<Vertex> ordered_vertices;
+    ordered_vertices.reserve(expected_vertices);
+    std::vector<uint32_t> corner_order;
+    corner_order.reserve(static_cast<size_t>(triangles.distance()) * 3);
+    VertexLookup vertices_order(expected_vertices);
+
     for(auto it = triangles.begin; it != triangles.end; ++it)
     {
         for(int n = 0; n < 3; ++n)
         {
             const Vertex node = (*it)[n];
 
-            const auto vertices_order_it = vertices_order.find(node);
-            if(vertices_order_it != vertices_order.end()) continue;
-
-            vertices_order.emplace_hint(vertices_order_it, std::make_pair(node, vertex_index));
+            const size_t order = vertices_order.find_or_insert(node, ordered_vertices);
+            corner_order.push_back(static_cast<uint32_t>(order));
+            if(order != static_cast<size_t>(vertex_index)) continue;
 
             // Rescale coordinates
             if(mesh_is_rescaled)
@@ -454,55 +408,79 @@ bool write_mesh_as_qm(const std::shared_ptr<FileLike>& f,
         }
     }
 
-    log.VertexData_vertexCount_start = bio.write_pos();
-    log.VertexData_vertexCount = nvertices;
-    bio.write_uint32(nvertices, e);
-    if(e.has_error())
-    {
-        TNTN_LOG_ERROR("{} in file {}", e.to_string(), f->name());
-        return false;
-    }
+    const uint32_t nvertices = us.size();
+    const size_t ntriangles = corner_order.size() / 3;
+    const size_t index_bytes = nvertices <= 65536 ? 2 : 4;
+    const size_t nedge_indices =
+        westlings.size() + southlings.size() + eastlings.size() + northlings.size();
 
-    log.VertexData_u_start = bio.write_pos();
-    bio.write_array_uint16(us, e);
+    // everything is appended to the buffer, reserve the final size up front
+    buffer.reserve(sizeof(QuantizedMeshHeader) + 4 + 3 * 2 * static_cast<size_t>(nvertices) +
+                   index_bytes + 4 + 3 * index_bytes * ntriangles + 4 * 4 +
+                   index_bytes * nedge_indices);
+    QMBuffer out(buffer);
 
-    log.VertexData_v_start = bio.write_pos();
-    bio.write_array_uint16(vs, e);
+    log.QuantizedMeshHeader_start = out.pos();
+    write_qmheader(out, header);
+    TNTN_ASSERT(
+        out.pos() ==
+        sizeof(QuantizedMeshHeader)); //might not be true for some platforms, mostly for debugging
 
-    log.VertexData_height_start = bio.write_pos();
-    bio.write_array_uint16(hs, e);
+    log.VertexData_vertexCount_start = out.pos();
+    log.VertexData_vertexCount = nvertices;
+    out.append<uint32_t>(nvertices);
 
-    if(e.has_error())
-    {
-        TNTN_LOG_ERROR("{} in file {}", e.to_string(), f->name());
-        return false;
-    }
+    log.VertexData_u_start = out.pos();
+    out.append_array<uint16_t>(us);
+
+    log.VertexData_v_start = out.pos();
+    out.append_array<uint16_t>(vs);
+
+    log.VertexData_height_start = out.pos();
+    out.append_array<uint16_t>(hs);
 
     // Write triangle indices data
     if(nvertices <= 65536)
     {
-        write_faces<uint16_t>(bio, e, log, m.triangles(), vertices_order);
-        write_indices<uint16_t>(bio, e, westlings);
-        write_indices<uint16_t>(bio, e, southlings);
-        write_indices<uint16_t>(bio, e, eastlings);
-        write_indices<uint16_t>(bio, e, northlings);
+        write_faces<uint16_t>(out, log, corner_order);
+        write_indices<uint16_t>(out, westlings);
+        write_indices<uint16_t>(out, southlings);
+        write_indices<uint16_t>(out, eastlings);
+        write_indices<uint16_t>(out, northlings);
     }
     else
     {
-        write_faces<uint32_t>(bio, e, log, m.triangles(), vertices_order);
-        write_indices<uint32_t>(bio, e, westlings);
-        write_indices<uint32_t>(bio, e, southlings);
-        write_indices<uint32_t>(bio, e, eastlings);
-        write_indices<uint32_t>(bio, e, northlings);
+        write_faces<uint32_t>(out, log, corner_order);
+        write_indices<uint32_t>(out, westlings);
+        write_indices<uint32_t>(out, southlings);
+        write_indices<uint32_t>(out, eastlings);
+        write_indices<uint32_t>(out, northlings);
     }
 
-    if(e.has_error())
+    TNTN_LOG_INFO("writer log: {}", log.to_string());
+    return true;
+}
+
+bool write_mesh_as_qm(const std::shared_ptr<FileLike>& f,
+                      const Mesh& m,
+                      const BBox3D& bbox,
+                      bool mesh_is_rescaled)
+{
+    // reused by all tiles written on this thread
+    thread_local std::vector<unsigned char> buffer;
+
+    if(!encode_mesh_as_qm(m, bbox, mesh_is_rescaled, buffer))
     {
-        TNTN_LOG_ERROR("{} in file {}", e.to_string(), f->name());
         return false;
     }
 
-    TNTN_LOG_INFO("writer log: {}", log.to_string());
+    if(!f->write(0, buffer.data(), buffer.size()))
+    {
+        TNTN_LOG_ERROR("unable to write {} bytes of quantized mesh to file {}",
+                       buffer.size(),
+                       f->name());
+        return false;
+    }
     return true;
 }
 
@@ -518,45 +496,29 @@ static BBox3D bbox_from_header(const QuantizedMeshHeader& qmheader)
     return out;
 }
 
-static std::vector<Vertex> decode_qm_vertices(const BBox3D& bbox,
-                                              const std::vector<uint16_t>& u_buffer,
-                                              const std::vector<uint16_t>& v_buffer,
-                                              const std::vector<uint16_t>& height_buffer)
+static std::vector<Vertex> decode_qm_vertices(const BBox3D& bbox, const QuantizedMeshView& view)
 {
-    if(!(u_buffer.size() == v_buffer.size() && v_buffer.size() == height_buffer.size()))
-    {
-        TNTN_ASSERT(false); //should never happen
-        TNTN_LOG_ERROR("u,v,height must have the same size");
-        return std::vector<Vertex>();
-    }
     std::vector<Vertex> vx_buffer;
-    vx_buffer.reserve(u_buffer.size());
-
-    int u = 0;
-    int v = 0;
-    int height = 0;
-    for(size_t i = 0; i < u_buffer.size(); i++)
-    {
-        u += zig_zag_decode(u_buffer[i]);
-        v += zig_zag_decode(v_buffer[i]);
-        height += zig_zag_decode(height_buffer[i]);
+    vx_buffer.reserve(view.vertex_count());
 
+    view.for_each_vertex([&](const int u, const int v, const int height) {
         const double x = dequantize_coordinate(u, bbox.min.x, bbox.max.x);
         const double y = dequantize_coordinate(v, bbox.min.y, bbox.max.y);
         const double z = dequantize_coordinate(height, bbox.min.z, bbox.max.z);
 
         vx_buffer.emplace_back(x, y, z);
-    }
+    });
 
     return vx_buffer;
 }
 
-template<typename ElemT>
-static void decode_qm_faces_impl(const std::vector<ElemT>& indices,
-                                 std::vector<Face>& face_buffer)
+static std::vector<Face> decode_qm_faces(const QMArray& indices)
 {
+    std::vector<Face> face_buffer;
+    face_buffer.reserve(indices.size() / 3);
+
     int highest = 0;
-    for(size_t i = 0; i < indices.size(); i += 3)
+    for(size_t i = 0; i + 2 < indices.size(); i += 3)
     {
         Face f;
         for(size_t k = 0; k < 3; k++)
@@ -570,206 +532,53 @@ static void decode_qm_faces_impl(const std::vector<ElemT>& indices,
         }
         face_buffer.push_back(f);
     }
-}
-
-static std::vector<Face> decode_qm_faces(const std::vector<uint16_t>& indices16,
-                                         const std::vector<uint32_t>& indices32)
-{
-    std::vector<Face> face_buffer;
-    face_buffer.reserve(indices16.size() / 3 + indices32.size() / 3);
-    decode_qm_faces_impl(indices16, face_buffer);
-    decode_qm_faces_impl(indices32, face_buffer);
     return face_buffer;
 }
 
-static void read_qmheader(BinaryIO& bio, BinaryIOErrorTracker& e, QuantizedMeshHeader& qmheader)
+std::unique_ptr<Mesh> load_mesh_from_qm(const char* filename)
 {
-    bio.read_double(qmheader.center.x, e);
-    bio.read_double(qmheader.center.y, e);
-    bio.read_double(qmheader.center.z, e);
-
-    bio.read_float(qmheader.MinimumHeight, e);
-    bio.read_float(qmheader.MaximumHeight, e);
-
-    bio.read_double(qmheader.bounding_sphere_center.x, e);
-    bio.read_double(qmheader.bounding_sphere_center.y, e);
-    bio.read_double(qmheader.bounding_sphere_center.z, e);
-    bio.read_double(qmheader.BoundingSphereRadius, e);
-
-    bio.read_double(qmheader.horizon_occlusion.x, e);
-    bio.read_double(qmheader.horizon_occlusion.y, e);
-    bio.read_double(qmheader.horizon_occlusion.z, e);
+    QuantizedMeshView view;
+    if(!view.open(filename))
+    {
+        TNTN_LOG_ERROR("unable to open quantized mesh in file {}", filename);
+        return std::unique_ptr<Mesh>();
+    }
+    return load_mesh_from_qm(view);
 }
 
-static bool read_qm_data(const std::shared_ptr<FileLike>& f,
-                         QuantizedMeshHeader& qmheader,
-                         std::vector<uint16_t>& vertex_data_u,
-                         std::vector<uint16_t>& vertex_data_v,
-                         std::vector<uint16_t>& vertex_data_height,
-                         std::vector<uint16_t>& indices16,
-                         std::vector<uint32_t>& indices32)
+std::unique_ptr<Mesh> load_mesh_from_qm(const std::shared_ptr<FileLike>& f)
 {
     if(!f->is_good())
     {
         TNTN_LOG_ERROR("input file {} is not open/good", f->name());
-        return false;
-    }
-
-    BinaryIO bio(f, Endianness::LITTLE);
-    BinaryIOErrorTracker e;
-    QuantizedMeshLog log;
-
-    log.QuantizedMeshHeader_start = bio.read_pos();
-    read_qmheader(bio, e, qmheader);
-    if(e.has_error())
-    {
-        TNTN_LOG_ERROR("{} on file {} during QuantizedMeshHeader", e.to_string(), f->name());
-        return false;
-    }
-
-    //VertexData
-    uint32_t vertex_count = 0;
-    log.VertexData_vertexCount_start = bio.read_pos();
-    bio.read_uint32(vertex_count, e);
-    if(e.has_error())
-    {
-        TNTN_LOG_ERROR("{} on file {} during VertexData::vertexCount", e.to_string(), f->name());
-        return false;
-    }
-    TNTN_LOG_DEBUG("vertex_count: {}", vertex_count);
-    log.VertexData_vertexCount = vertex_count;
-
-    if(vertex_count > 0)
-    {
-        log.VertexData_u_start = bio.read_pos();
-        bio.read_array_uint16(vertex_data_u, vertex_count, e);
-        if(e.has_error())
-        {
-            TNTN_LOG_ERROR("{} on file {} during VertexData::u", e.to_string(), f->name());
-            return false;
-        }
-
-        log.VertexData_v_start = bio.read_pos();
-        bio.read_array_uint16(vertex_data_v, vertex_count, e);
-        if(e.has_error())
-        {
-            TNTN_LOG_ERROR("{} on file {} during VertexData::v", e.to_string(), f->name());
-            return false;
-        }
-
-        log.VertexData_height_start = bio.read_pos();
-        bio.read_array_uint16(vertex_data_height, vertex_count, e);
-        if(e.has_error())
-        {
-            TNTN_LOG_ERROR("{} on file {} during VertexData::height", e.to_string(), f->name());
-            return false;
-        }
-    }
-
-    // padding
-    const size_t alignment = vertex_count <= 65536 ? 2 : 4;
-    const auto read_pos = bio.read_pos();
-    if(read_pos % alignment != 0)
-    {
-        int pad_size = alignment - (read_pos % alignment);
-        bio.read_skip(pad_size, e);
-    }
-
-    //Index Data
-    uint32_t triangle_count = 0;
-    log.IndexData_triangleCount_start = bio.read_pos();
-    bio.read_uint32(triangle_count, e);
-    if(e.has_error())
-    {
-        TNTN_LOG_ERROR(
-            "{} on file {} during IndexData(16/32)::triangleCount", e.to_string(), f->name());
-        return false;
-    }
-    log.IndexData_triangleCount = triangle_count;
-
-    if(triangle_count > 0)
-    {
-        if(vertex_count <= 65536)
-        {
-            log.IndexData_bits = 16;
-            log.IndexData_indices_start = bio.read_pos();
-            bio.read_array_uint16(indices16, static_cast<size_t>(triangle_count) * 3, e);
-            if(e.has_error())
-            {
-                TNTN_LOG_ERROR(
-                    "{} on file {} during IndexData16::indices", e.to_string(), f->name());
-                return false;
-            }
-        }
-        else
-        {
-            log.IndexData_bits = 32;
-            log.IndexData_indices_start = bio.read_pos();
-            bio.read_array_uint32(indices32, static_cast<size_t>(triangle_count) * 3, e);
-            if(e.has_error())
-            {
-                TNTN_LOG_ERROR(
-                    "{} on file {} during IndexData32::indices", e.to_string(), f->name());
-                return false;
-            }
-        }
+        return std::unique_ptr<Mesh>();
     }
-    //TODO edge indices
 
-    //TODO extensions
+    // one read for the whole tile, the view then points into the buffer
+    std::vector<unsigned char> buffer;
+    f->read(0, buffer, static_cast<size_t>(f->size()));
 
-    if(e.has_error())
+    QuantizedMeshView view;
+    if(!view.parse(buffer.data(), buffer.size(), f->name()))
     {
-        TNTN_LOG_ERROR("{} on file {}", e.to_string(), f->name());
-        return false;
-    }
-
-    TNTN_LOG_INFO("reader log: {}", log.to_string());
-    return true;
-}
-
-std::unique_ptr<Mesh> load_mesh_from_qm(const char* filename)
-{
-    auto f = std::make_shared<File>();
-    if(!f->open(filename, File::OM_R))
-    {
-        TNTN_LOG_ERROR("unable to open quantized mesh in file {}", filename);
+        TNTN_LOG_ERROR("error reading quantized mesh data from file {}", f->name());
         return std::unique_ptr<Mesh>();
     }
-    return load_mesh_from_qm(f);
+    return load_mesh_from_qm(view);
 }
 
-std::unique_ptr<Mesh> load_mesh_from_qm(const std::shared_ptr<FileLike>& f)
+std::unique_ptr<Mesh> load_mesh_from_qm(const QuantizedMeshView& view)
 {
-    QuantizedMeshHeader qmheader;
-    std::vector<uint16_t> vertex_data_u;
-    std::vector<uint16_t> vertex_data_v;
-    std::vector<uint16_t> vertex_data_height;
-    std::vector<uint16_t> indices16;
-    std::vector<uint32_t> indices32;
-
-    TNTN_LOG_DEBUG("reading QuantizedMesh data...");
-    if(!read_qm_data(
-           f, qmheader, vertex_data_u, vertex_data_v, vertex_data_height, indices16, indices32))
-    {
-        TNTN_LOG_ERROR("error reading quantized mesh data from file {}", f->name());
-        return std::unique_ptr<Mesh>();
-    }
-    TNTN_LOG_DEBUG(
-        "before decoding: VertexData::u.size={} VertexData::v.size={} VertexData::height.size={} IndicesData16::indices.size={} IndicesData32::indices.size={}",
-        vertex_data_u.size(),
-        vertex_data_v.size(),
-        vertex_data_height.size(),
-        indices16.size(),
-        indices32.size());
-
-    const BBox3D header_bbox = bbox_from_header(qmheader);
+    TNTN_LOG_DEBUG("decoding quantized mesh with {} vertices and {} triangles",
+                   view.vertex_count(),
+                   view.triangle_count());
+
+    const BBox3D header_bbox = bbox_from_header(view.header());
     TNTN_LOG_DEBUG("bbox derived from header: {}", header_bbox.to_string());
 
-    std::vector<Vertex> vertices =
-        decode_qm_vertices(header_bbox, vertex_data_u, vertex_data_v, vertex_data_height);
+    std::vector<Vertex> vertices = decode_qm_vertices(header_bbox, view);
 
-    std::vector<Face> faces = decode_qm_faces(indices16, indices32);
+    std::vector<Face> faces = decode_qm_faces(view.indices());
 
     TNTN_LOG_DEBUG("{} vertices, {} faces after decoding", vertices.size(), faces.size());
 
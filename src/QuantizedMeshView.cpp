@@ -0,0 +1,178 @@
+#include "tntn/QuantizedMeshView.h"
+#include "tntn/logging.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace tntn {
+
+namespace {
+
+// bounds checked cursor over the tile buffer
+class QMCursor
+{
+  public:
+    QMCursor(const unsigned char* data, size_t size) : m_data(data), m_size(size) {}
+
+    size_t pos() const { return m_pos; }
+    bool at_end() const { return m_pos == m_size; }
+
+    bool skip(size_t bytes)
+    {
+        if(bytes > m_size - m_pos)
+        {
+            return false;
+        }
+        m_pos += bytes;
+        return true;
+    }
+
+    template<typename T>
+    bool read(T& value)
+    {
+        if(sizeof(T) > m_size - m_pos)
+        {
+            return false;
+        }
+        value = load_little_endian<T>(m_data + m_pos);
+        m_pos += sizeof(T);
+        return true;
+    }
+
+    bool read(QMVertex& value) { return read(value.x) && read(value.y) && read(value.z); }
+
+    bool read_array(size_t count, int element_bytes, QMArray& array)
+    {
+        if(count > (m_size - m_pos) / element_bytes)
+        {
+            return false;
+        }
+        array = QMArray(m_data + m_pos, count, element_bytes);
+        m_pos += count * element_bytes;
+        return true;
+    }
+
+    bool read_counted_array(int element_bytes, QMArray& array)
+    {
+        uint32_t count = 0;
+        return read(count) && read_array(count, element_bytes, array);
+    }
+
+  private:
+    const unsigned char* m_data;
+    size_t m_size;
+    size_t m_pos = 0;
+};
+
+} // namespace
+
+bool QuantizedMeshView::parse(const unsigned char* data, size_t size, const std::string& name)
+{
+    *this = QuantizedMeshView();
+
+    QMCursor cursor(data, size);
+
+    QuantizedMeshHeader& h = m_header;
+    if(!(cursor.read(h.center) && cursor.read(h.MinimumHeight) && cursor.read(h.MaximumHeight) &&
+         cursor.read(h.bounding_sphere_center) && cursor.read(h.BoundingSphereRadius) &&
+         cursor.read(h.horizon_occlusion)))
+    {
+        TNTN_LOG_ERROR("unexpected end of file {} during QuantizedMeshHeader", name);
+        return false;
+    }
+
+    uint32_t vertex_count = 0;
+    if(!cursor.read(vertex_count))
+    {
+        TNTN_LOG_ERROR("unexpected end of file {} during VertexData::vertexCount", name);
+        return false;
+    }
+
+    if(!(cursor.read_array(vertex_count, 2, m_u) && cursor.read_array(vertex_count, 2, m_v) &&
+         cursor.read_array(vertex_count, 2, m_height)))
+    {
+        TNTN_LOG_ERROR("unexpected end of file {} during VertexData", name);
+        return false;
+    }
+
+    // padding
+    const int index_bytes = vertex_count <= 65536 ? 2 : 4;
+    if(cursor.pos() % index_bytes != 0 && !cursor.skip(index_bytes - cursor.pos() % index_bytes))
+    {
+        TNTN_LOG_ERROR("unexpected end of file {} during IndexData padding", name);
+        return false;
+    }
+
+    uint32_t triangle_count = 0;
+    if(!cursor.read(triangle_count) ||
+       !cursor.read_array(static_cast<size_t>(triangle_count) * 3, index_bytes, m_indices))
+    {
+        TNTN_LOG_ERROR("unexpected end of file {} during IndexData", name);
+        return false;
+    }
+
+    // older writers stopped after the triangles, treat that as tiles without edge lists
+    if(cursor.at_end())
+    {
+        return true;
+    }
+
+    if(!(cursor.read_counted_array(index_bytes, m_west) &&
+         cursor.read_counted_array(index_bytes, m_south) &&
+         cursor.read_counted_array(index_bytes, m_east) &&
+         cursor.read_counted_array(index_bytes, m_north)))
+    {
+        TNTN_LOG_ERROR("unexpected end of file {} during EdgeIndices", name);
+        return false;
+    }
+
+    //TODO extensions
+    return true;
+}
+
+bool QuantizedMeshView::open(const std::string& filename)
+{
+    auto file = std::make_shared<MappedFile>();
+    if(!file->open(filename))
+    {
+        return false;
+    }
+    if(!parse(file->data(), file->size(), filename))
+    {
+        return false;
+    }
+    m_file = std::move(file);
+    return true;
+}
+
+bool QuantizedMeshView::quantized_height_range(int& min_height, int& max_height) const
+{
+    if(m_height.empty())
+    {
+        return false;
+    }
+
+    int lo = std::numeric_limits<int>::max();
+    int hi = std::numeric_limits<int>::min();
+    int h = 0;
+    const size_t n = m_height.size();
+    for(size_t i = 0; i < n; i++)
+    {
+        h += zig_zag_decode(m_height[i]);
+        lo = std::min(lo, h);
+        hi = std::max(hi, h);
+    }
+
+    min_height = lo;
+    max_height = hi;
+    return true;
+}
+
+double QuantizedMeshView::dequantize_height(const int quantized_height) const
+{
+    const double min = m_header.MinimumHeight;
+    const double max = m_header.MaximumHeight;
+    return min + static_cast<double>(quantized_height) / 32767 * (max - min);
+}
+
+} // namespace tntn
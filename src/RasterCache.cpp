@@ -0,0 +1,424 @@
+#include "tntn/RasterCache.h"
+#include "tntn/endianness.h"
+#include "tntn/logging.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace tntn {
+
+static const char RASTER_CACHE_MAGIC[8] = {'T', 'N', 'T', 'N', 'R', 'A', 'S', 'T'};
+static constexpr uint32_t RASTER_CACHE_VERSION = 1;
+static constexpr size_t RASTER_CACHE_HEADER_SIZE = 8 + 6 * 4 + 4 * 8 + 4;
+static constexpr size_t RASTER_CACHE_SUMMARY_SIZE = 8 + 8 + 4;
+static constexpr uint64_t RASTER_CACHE_DATA_ALIGNMENT = 4096;
+
+static size_t sample_size(const RasterSampleType type)
+{
+    switch(type)
+    {
+        case RasterSampleType::Int16: return sizeof(int16_t);
+        case RasterSampleType::Float32: return sizeof(float);
+        default: return sizeof(double);
+    }
+}
+
+static uint64_t data_offset(const size_t projection_size, const size_t block_count)
+{
+    const uint64_t end = RASTER_CACHE_HEADER_SIZE + projection_size +
+        static_cast<uint64_t>(block_count) * RASTER_CACHE_SUMMARY_SIZE;
+    return (end + RASTER_CACHE_DATA_ALIGNMENT - 1) / RASTER_CACHE_DATA_ALIGNMENT *
+        RASTER_CACHE_DATA_ALIGNMENT;
+}
+
+template<typename S>
+static bool is_no_data_sample(const S v, const S no_data_value)
+{
+    return v != v || v == no_data_value;
+}
+
+// reads rows of blocks from the source and writes them with samples of type S
+template<typename S>
+static bool write_blocks(const RasterSource& source,
+                         File& file,
+                         const uint64_t offset,
+                         const int block_size,
+                         std::vector<RasterBlockSummary>& summaries)
+{
+    const int width = source.get_width();
+    const int height = source.get_height();
+    const int blocks_x = (width + block_size - 1) / block_size;
+    const int blocks_y = (height + block_size - 1) / block_size;
+    const size_t block_bytes = sizeof(S) * block_size * block_size;
+
+    const double no_data_value = source.get_no_data_value();
+    const S no_data_sample = detail::sample_cast<S>(no_data_value);
+
+    std::vector<S> rows(static_cast<size_t>(width) * block_size);
+    std::vector<unsigned char> block_row(block_bytes * blocks_x);
+
+    for(int by = 0; by < blocks_y; by++)
+    {
+        const int row_count = std::min(block_size, height - by * block_size);
+        if(!source.read_window(0, by * block_size, width, row_count, rows.data(), width))
+        {
+            TNTN_LOG_ERROR("unable to read rows {} to {} of the input raster",
+                           by * block_size,
+                           by * block_size + row_count);
+            return false;
+        }
+
+        for(int bx = 0; bx < blocks_x; bx++)
+        {
+            const int x0 = bx * block_size;
+            const int column_count = std::min(block_size, width - x0);
+            unsigned char* out = block_row.data() + bx * block_bytes;
+
+            RasterBlockSummary summary = {std::numeric_limits<double>::max(),
+                                          std::numeric_limits<double>::lowest(),
+                                          0};
+            for(int r = 0; r < block_size; r++)
+            {
+                const S* in = rows.data() + static_cast<size_t>(r) * width + x0;
+                for(int c = 0; c < block_size; c++, out += sizeof(S))
+                {
+                    if(r >= row_count || c >= column_count)
+                    {
+                        store_little_endian(no_data_sample, out);
+                        continue;
+                    }
+
+                    const S v = in[c];
+                    store_little_endian(v, out);
+                    if(is_no_data_sample(v, no_data_sample))
+                    {
+                        summary.no_data_count++;
+                    }
+                    else
+                    {
+                        summary.min = std::min(summary.min, static_cast<double>(v));
+                        summary.max = std::max(summary.max, static_cast<double>(v));
+                    }
+                }
+            }
+
+            if(summary.min > summary.max)
+            {
+                summary.min = summary.max = no_data_value;
+            }
+            summaries.push_back(summary);
+        }
+
+        const uint64_t row_offset = offset + static_cast<uint64_t>(by) * blocks_x * block_bytes;
+        if(!file.write(row_offset, block_row))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool write_raster_cache(const RasterSource& source,
+                        const std::string& filename,
+                        const std::string& projection,
+                        const int block_size)
+{
+    if(block_size < 1)
+    {
+        TNTN_LOG_ERROR("raster cache block size must be positive");
+        return false;
+    }
+
+    File file;
+    if(!file.open(filename, File::OM_RWCF))
+    {
+        TNTN_LOG_ERROR("unable to create raster cache {}", filename);
+        return false;
+    }
+
+    const int width = source.get_width();
+    const int height = source.get_height();
+    const int blocks_x = (width + block_size - 1) / block_size;
+    const int blocks_y = (height + block_size - 1) / block_size;
+    const size_t block_count = static_cast<size_t>(blocks_x) * blocks_y;
+    RasterSampleType sample_type = source.get_sample_type();
+    if(!sample_type_holds(sample_type, source.get_no_data_value()))
+    {
+        sample_type = RasterSampleType::Float64;
+    }
+    const uint64_t offset = data_offset(projection.size(), block_count);
+
+    // the header is written last, an interrupted run leaves no valid cache behind
+    std::vector<unsigned char> header(RASTER_CACHE_HEADER_SIZE, 0);
+    if(!file.write(0, header))
+    {
+        TNTN_LOG_ERROR("unable to write raster cache {}", filename);
+        return false;
+    }
+
+    std::vector<RasterBlockSummary> summaries;
+    summaries.reserve(block_count);
+
+    bool ok = false;
+    switch(sample_type)
+    {
+        case RasterSampleType::Int16:
+            ok = write_blocks<int16_t>(source, file, offset, block_size, summaries);
+            break;
+        case RasterSampleType::Float32:
+            ok = write_blocks<float>(source, file, offset, block_size, summaries);
+            break;
+        default: ok = write_blocks<double>(source, file, offset, block_size, summaries); break;
+    }
+
+    if(!ok)
+    {
+        TNTN_LOG_ERROR("unable to write raster cache {}", filename);
+        return false;
+    }
+
+    std::vector<unsigned char> summary_data(summaries.size() * RASTER_CACHE_SUMMARY_SIZE);
+    unsigned char* p = summary_data.data();
+    for(const auto& s : summaries)
+    {
+        store_little_endian(s.min, p);
+        store_little_endian(s.max, p + 8);
+        store_little_endian(s.no_data_count, p + 16);
+        p += RASTER_CACHE_SUMMARY_SIZE;
+    }
+
+    p = header.data();
+    std::memcpy(p, RASTER_CACHE_MAGIC, 8);
+    store_little_endian(RASTER_CACHE_VERSION, p + 8);
+    store_little_endian(static_cast<uint32_t>(sample_type), p + 12);
+    store_little_endian(static_cast<uint32_t>(width), p + 16);
+    store_little_endian(static_cast<uint32_t>(height), p + 20);
+    store_little_endian(static_cast<uint32_t>(block_size), p + 24);
+    store_little_endian(static_cast<uint32_t>(block_size), p + 28);
+    store_little_endian(source.get_pos_x(), p + 32);
+    store_little_endian(source.get_pos_y(), p + 40);
+    store_little_endian(source.get_cell_size(), p + 48);
+    store_little_endian(source.get_no_data_value(), p + 56);
+    store_little_endian(static_cast<uint32_t>(projection.size()), p + 64);
+
+    if(!file.write(RASTER_CACHE_HEADER_SIZE + projection.size(), summary_data) ||
+       !file.write(RASTER_CACHE_HEADER_SIZE, projection) || !file.write(0, header))
+    {
+        TNTN_LOG_ERROR("unable to write raster cache {}", filename);
+        return false;
+    }
+
+    file.flush();
+    return file.close();
+}
+
+bool is_raster_cache_file(const std::string& filename)
+{
+    File file;
+    if(!file.open(filename, File::OM_R))
+    {
+        return false;
+    }
+
+    char magic[8];
+    return file.read(0, magic, sizeof(magic)) == sizeof(magic) &&
+        std::memcmp(magic, RASTER_CACHE_MAGIC, sizeof(magic)) == 0;
+}
+
+bool RasterCacheSource::open(const std::string& filename)
+{
+    m_summaries = nullptr;
+    m_blocks = nullptr;
+
+    if(!m_file.open(filename))
+    {
+        return false;
+    }
+
+    const unsigned char* data = m_file.data();
+    const size_t size = m_file.size();
+
+    if(size < RASTER_CACHE_HEADER_SIZE || std::memcmp(data, RASTER_CACHE_MAGIC, 8) != 0)
+    {
+        TNTN_LOG_ERROR("{} is not a complete raster cache", filename);
+        m_file.close();
+        return false;
+    }
+
+    const uint32_t version = load_little_endian<uint32_t>(data + 8);
+    const uint32_t sample_type = load_little_endian<uint32_t>(data + 12);
+    if(version != RASTER_CACHE_VERSION ||
+       sample_type > static_cast<uint32_t>(RasterSampleType::Int16))
+    {
+        TNTN_LOG_ERROR("unsupported raster cache version {} in {}", version, filename);
+        m_file.close();
+        return false;
+    }
+
+    m_sample_type = static_cast<RasterSampleType>(sample_type);
+    m_sample_size = sample_size(m_sample_type);
+    const uint32_t width = load_little_endian<uint32_t>(data + 16);
+    const uint32_t height = load_little_endian<uint32_t>(data + 20);
+    const uint32_t block_width = load_little_endian<uint32_t>(data + 24);
+    const uint32_t block_height = load_little_endian<uint32_t>(data + 28);
+    m_xpos = load_little_endian<double>(data + 32);
+    m_ypos = load_little_endian<double>(data + 40);
+    m_cellsize = load_little_endian<double>(data + 48);
+    m_noDataValue = load_little_endian<double>(data + 56);
+    const uint32_t projection_size = load_little_endian<uint32_t>(data + 64);
+
+    // sizes are compared by dividing the space left in the file,
+    // so corrupt values can't overflow and pass the checks
+    const uint32_t max_size = std::numeric_limits<int>::max();
+    if(width < 1 || width > max_size || height < 1 || height > max_size || block_width < 1 ||
+       block_width > max_size || block_height < 1 || block_height > max_size ||
+       projection_size > size - RASTER_CACHE_HEADER_SIZE ||
+       static_cast<uint64_t>(block_width) * block_height > size / m_sample_size)
+    {
+        TNTN_LOG_ERROR("corrupt header in raster cache {}", filename);
+        m_file.close();
+        return false;
+    }
+
+    const uint64_t blocks_x = (static_cast<uint64_t>(width) + block_width - 1) / block_width;
+    const uint64_t blocks_y = (static_cast<uint64_t>(height) + block_height - 1) / block_height;
+    const uint64_t block_count = blocks_x * blocks_y;
+    const uint64_t block_bytes = static_cast<uint64_t>(m_sample_size) * block_width * block_height;
+
+    if(block_count >
+       (size - RASTER_CACHE_HEADER_SIZE - projection_size) / RASTER_CACHE_SUMMARY_SIZE)
+    {
+        TNTN_LOG_ERROR("raster cache {} is truncated", filename);
+        m_file.close();
+        return false;
+    }
+
+    const uint64_t offset = data_offset(projection_size, block_count);
+    if(offset > size || block_count > (size - offset) / block_bytes)
+    {
+        TNTN_LOG_ERROR("raster cache {} is truncated", filename);
+        m_file.close();
+        return false;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_block_width = block_width;
+    m_block_height = block_height;
+
+    m_blocks_x = static_cast<int>(blocks_x);
+    m_blocks_y = static_cast<int>(blocks_y);
+
+    m_projection.assign(reinterpret_cast<const char*>(data + RASTER_CACHE_HEADER_SIZE),
+                        projection_size);
+    m_summaries = data + RASTER_CACHE_HEADER_SIZE + projection_size;
+    m_blocks = data + offset;
+
+    TNTN_LOG_DEBUG("raster cache {}x{}, blocks of {}x{}",
+                   m_width,
+                   m_height,
+                   m_block_width,
+                   m_block_height);
+    return true;
+}
+
+RasterBlockSummary RasterCacheSource::get_block_summary(const int block_x,
+                                                        const int block_y) const
+{
+    const size_t i = static_cast<size_t>(block_y) * m_blocks_x + block_x;
+    const unsigned char* p = m_summaries + i * RASTER_CACHE_SUMMARY_SIZE;
+
+    RasterBlockSummary s;
+    s.min = load_little_endian<double>(p);
+    s.max = load_little_endian<double>(p + 8);
+    s.no_data_count = load_little_endian<uint32_t>(p + 16);
+    return s;
+}
+
+template<typename S, typename D>
+void RasterCacheSource::copy_block_row(const unsigned char* block_row, const int n, D* dst) const
+{
+#ifdef TNTN_BIG_ENDIAN
+    for(int i = 0; i < n; i++)
+    {
+        const S v = load_little_endian<S>(block_row + i * sizeof(S));
+        dst[i] = detail::sample_cast<D>(static_cast<double>(v));
+    }
+#else
+    // blocks are aligned to their sample size in the mapping
+    const S* p = reinterpret_cast<const S*>(block_row);
+    if(std::is_same<S, D>::value)
+    {
+        std::memcpy(dst, p, n * sizeof(S));
+    }
+    else
+    {
+        for(int i = 0; i < n; i++)
+        {
+            dst[i] = detail::sample_cast<D>(static_cast<double>(p[i]));
+        }
+    }
+#endif
+}
+
+template<typename D>
+bool RasterCacheSource::read_window_as(
+    int cx, int cy, int cw, int ch, D* dst, size_t dst_stride) const
+{
+    const size_t block_bytes = m_sample_size * m_block_width * m_block_height;
+    const size_t block_row_bytes = m_sample_size * m_block_width;
+
+    for(int r = 0; r < ch; r++)
+    {
+        const int block_y = (cy + r) / m_block_height;
+        const int block_row = (cy + r) - block_y * m_block_height;
+        D* out = dst + r * dst_stride;
+
+        int c = 0;
+        while(c < cw)
+        {
+            const int block_x = (cx + c) / m_block_width;
+            const int block_col = (cx + c) - block_x * m_block_width;
+            const int n = std::min(cw - c, m_block_width - block_col);
+
+            const unsigned char* p = m_blocks +
+                (static_cast<size_t>(block_y) * m_blocks_x + block_x) * block_bytes +
+                block_row * block_row_bytes + block_col * m_sample_size;
+
+            switch(m_sample_type)
+            {
+                case RasterSampleType::Int16: copy_block_row<int16_t>(p, n, out + c); break;
+                case RasterSampleType::Float32: copy_block_row<float>(p, n, out + c); break;
+                default: copy_block_row<double>(p, n, out + c); break;
+            }
+            c += n;
+        }
+    }
+
+    return true;
+}
+
+bool RasterCacheSource::read_window(
+    int cx, int cy, int cw, int ch, double* dst, size_t dst_stride) const
+{
+    return read_window_as(cx, cy, cw, ch, dst, dst_stride);
+}
+
+bool RasterCacheSource::read_window(
+    int cx, int cy, int cw, int ch, float* dst, size_t dst_stride) const
+{
+    return read_window_as(cx, cy, cw, ch, dst, dst_stride);
+}
+
+bool RasterCacheSource::read_window(
+    int cx, int cy, int cw, int ch, int16_t* dst, size_t dst_stride) const
+{
+    return read_window_as(cx, cy, cw, ch, dst, dst_stride);
+}
+
+} // namespace tntn
@@ -1,15 +1,23 @@
 
 #include "tntn/RasterIO.h"
+#include "tntn/RasterCache.h"
+#include "tntn/File.h"
 #include "fmt/format.h"
 #include "tntn/logging.h"
 #include "tntn/println.h"
 #include "tntn/util.h"
 #include "tntn/raster_tools.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <stdio.h>
 #include <iomanip>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 #include <ogr_spatialref.h>
 #include <gdal_priv.h>
@@ -28,28 +36,221 @@ std::string getFirstNonZero(std::vector<std::string> tokens, int start)
     return "";
 }
 
+// same delimiters as tokenize
+static inline bool is_asc_delimiter(const char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\0';
+}
+
+/**
+ parses a number token, the result is identical to std::stod
+
+ Decimal tokens with up to 19 significant digits and small exponents are
+ converted exactly with a single multiplication or division (both operands
+ are exact doubles), everything else goes through strtod.
+
+ @return false if the token doesn't start with a number
+*/
+static bool parse_asc_number(const char* begin, const char* end, double& value)
+{
+    static const double powers_of_ten[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                           1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                           1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    const char* p = begin;
+    const bool negative = p != end && *p == '-';
+    if(p != end && (*p == '-' || *p == '+'))
+    {
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int significant_digits = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool fraction = false;
+    bool exact = true;
+
+    for(; p != end; p++)
+    {
+        if(*p == '.' && !fraction)
+        {
+            fraction = true;
+            continue;
+        }
+        const unsigned d = static_cast<unsigned>(*p - '0');
+        if(d > 9)
+        {
+            break;
+        }
+        digits++;
+        if(fraction)
+        {
+            exponent--;
+        }
+        if(mantissa == 0 && d == 0)
+        {
+            continue;
+        }
+        if(++significant_digits > 19)
+        {
+            exact = false;
+        }
+        mantissa = mantissa * 10 + d;
+    }
+
+    if(digits > 0 && p != end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        const bool negative_exponent = p != end && *p == '-';
+        if(p != end && (*p == '-' || *p == '+'))
+        {
+            p++;
+        }
+        int e = 0;
+        int exponent_digits = 0;
+        for(; p != end && *p >= '0' && *p <= '9'; p++)
+        {
+            if(++exponent_digits > 4)
+            {
+                exact = false;
+                break;
+            }
+            e = e * 10 + (*p - '0');
+        }
+        exponent += negative_exponent ? -e : e;
+        exact = exact && exponent_digits > 0;
+    }
+
+    if(digits > 0 && exact && p == end && mantissa <= (uint64_t(1) << 53) && exponent >= -22 &&
+       exponent <= 22)
+    {
+        const double m = static_cast<double>(mantissa);
+        value = exponent < 0 ? m / powers_of_ten[-exponent] : m * powers_of_ten[exponent];
+        value = negative ? -value : value;
+        return true;
+    }
+
+    // strtod needs a terminated string
+    const std::string token(begin, end);
+    char* parsed_end = nullptr;
+    value = std::strtod(token.c_str(), &parsed_end);
+    return parsed_end != token.c_str();
+}
+
+// number of lines with more than one token, the lines load_raster_from_asc reads as rows
+static int count_asc_rows(const char* begin, const char* end)
+{
+    int rows = 0;
+    int tokens = 0;
+    bool in_token = false;
+    for(const char* p = begin; p != end; p++)
+    {
+        if(*p == '\n')
+        {
+            rows += tokens > 1;
+            tokens = 0;
+            in_token = false;
+        }
+        else if(is_asc_delimiter(*p))
+        {
+            in_token = false;
+        }
+        else if(!in_token)
+        {
+            in_token = true;
+            tokens++;
+        }
+    }
+    return rows + (tokens > 1);
+}
+
+// parses the rows of a chunk into raster rows first_row and following,
+// returns false if a row doesn't have as many values as the raster is wide
+static bool parse_asc_rows(const char* begin,
+                           const char* end,
+                           int first_row,
+                           RasterDouble& raster)
+{
+    const int width = raster.get_width();
+    const int height = raster.get_height();
+    const double no_data_value = raster.get_no_data_value();
+
+    int r = first_row;
+    const char* p = begin;
+    while(p != end)
+    {
+        double* row = r < height ? raster.get_ptr(r) : nullptr;
+        int c = 0;
+        while(p != end && *p != '\n')
+        {
+            if(is_asc_delimiter(*p))
+            {
+                p++;
+                continue;
+            }
+
+            const char* token_end = p;
+            while(token_end != end && !is_asc_delimiter(*token_end))
+            {
+                token_end++;
+            }
+
+            if(row != nullptr && c < width)
+            {
+                double v;
+                row[c] = parse_asc_number(p, token_end, v) ? v : no_data_value;
+            }
+            c++;
+            p = token_end;
+        }
+        if(p != end)
+        {
+            p++;
+        }
+
+        // lines with a single token are skipped like empty lines
+        if(c > 1)
+        {
+            if(c != width || r >= height)
+            {
+                TNTN_LOG_ERROR("can't read data in row {}", r);
+                return false;
+            }
+            r++;
+        }
+    }
+    return true;
+}
+
 // reads from file in ESRI ASCII Raster format
 // http://resources.esri.com/help/9.3/arcgisdesktop/com/gp_toolref/spatial_analyst_tools/esri_ascii_raster_format.htm
-RasterDouble load_raster_from_asc(const std::string& filename)
+RasterDouble load_raster_from_asc(const std::string& filename, int num_threads)
 {
     TNTN_LOG_INFO("load raster...");
 
     RasterDouble raster;
-    std::ifstream input(filename);
 
-    int count = 0;
-    int r = 0;
-    int c = 0;
+    MappedFile file;
+    if(!file.open(filename))
+    {
+        return raster;
+    }
+
+    const char* const data = reinterpret_cast<const char*>(file.data());
+    const char* const data_end = data + file.size();
 
     int width = 0;
     int height = 0;
 
-    int numPoints = 0;
-
+    // the first 6 lines are the header, values are taken by position
+    const char* body = data;
     std::vector<std::string> tokens;
-    for(std::string line; getline(input, line);)
+    for(int count = 0; count < 6 && body != data_end; count++)
     {
-        tokenize(line, tokens);
+        const char* line_end = std::find(body, data_end, '\n');
+        tokenize(body, line_end - body, tokens);
+        body = line_end != data_end ? line_end + 1 : line_end;
 
         if(tokens.size() > 1)
         {
@@ -78,56 +279,64 @@ RasterDouble load_raster_from_asc(const std::string& filename)
             {
                 raster.set_no_data_value(std::stod(getFirstNonZero(tokens, 1)));
             }
-            else
-            {
-#if true
+        }
+    }
 
-                // read data
-                if(tokens.size() != raster.get_width())
-                {
-                    TNTN_LOG_ERROR("can't read data");
-                    return raster;
-                }
-                else
-                {
-                    c = 0;
-                    for(auto p : tokens)
-                    {
-                        try
-                        {
-                            raster.value(r, c) = std::stod(p);
-                        }
-                        catch(const char* msg)
-                        {
-                            std::cout << msg << std::endl;
-                            raster.value(r, c) = raster.get_no_data_value();
-                        }
-
-                        numPoints++;
-                        c++;
-                    }
+    if(num_threads < 1)
+    {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
 
-                    if((r % (raster.get_height() / 10)) == 0)
-                    {
-                        float p = r / (float)raster.get_height();
-                        TNTN_LOG_INFO("{} %", p * 100.0);
-                    }
+    // chunks of about equal size ending at line breaks, small files aren't split
+    const size_t min_chunk_size = 1024 * 1024;
+    const size_t body_size = data_end - body;
+    const int chunk_count = static_cast<int>(
+        std::max<size_t>(1, std::min<size_t>(num_threads, body_size / min_chunk_size)));
 
-                    r++;
-                }
-#else
-                std::stringstream stream(input);
-                while(true)
-                {
-                    double v;
-                    stream >> v;
-                    if(!stream) break;
-                }
-#endif
+    std::vector<const char*> chunk_begin(chunk_count + 1, data_end);
+    chunk_begin[0] = body;
+    for(int i = 1; i < chunk_count; i++)
+    {
+        const char* p = body + body_size * i / chunk_count;
+        p = std::max(p, chunk_begin[i - 1]);
+        p = std::find(p, data_end, '\n');
+        chunk_begin[i] = p != data_end ? p + 1 : p;
+    }
+
+    // the row a chunk starts at is the number of rows in the chunks before it
+    std::vector<int> first_row(chunk_count + 1, 0);
+    for_each_row_range(chunk_count, num_threads, [&](int begin, int end) {
+        for(int i = begin; i < end; i++)
+        {
+            first_row[i + 1] = count_asc_rows(chunk_begin[i], chunk_begin[i + 1]);
+        }
+        return true;
+    });
+    for(int i = 0; i < chunk_count; i++)
+    {
+        first_row[i + 1] += first_row[i];
+    }
+
+    const bool ok = for_each_row_range(chunk_count, num_threads, [&](int begin, int end) {
+        for(int i = begin; i < end; i++)
+        {
+            if(!parse_asc_rows(chunk_begin[i], chunk_begin[i + 1], first_row[i], raster))
+            {
+                return false;
             }
         }
+        return true;
+    });
+
+    if(!ok)
+    {
+        return raster;
+    }
 
-        count++;
+    if(first_row[chunk_count] != height)
+    {
+        TNTN_LOG_ERROR("expected {} rows but found {}", height, first_row[chunk_count]);
+        return raster;
     }
 
     TNTN_LOG_INFO("done");
@@ -271,11 +480,8 @@ static bool get_transformation_matrix(GDALDataset* dataset, TransformationMatrix
     return true;
 }
 
-static bool is_valid_projection(GDALDataset* dataset)
+static bool is_valid_projection(const char* projection_wkt)
 {
-    // returned pointer should not be altered, freed or expected to last for long.
-    const char* projection_wkt = dataset->GetProjectionRef();
-
     if(projection_wkt == NULL)
     {
         TNTN_LOG_ERROR("Input raster file does not provide spatial reference information");
@@ -344,9 +550,45 @@ static bool is_valid_projection(GDALDataset* dataset)
     return matched;
 }
 
-bool load_raster_file(const std::string& file_name,
-                      RasterDouble& target_raster,
-                      bool validate_projection)
+// is_valid_projection with instructions for fixing the input
+static bool check_projection(const char* projection_wkt)
+{
+    if(!is_valid_projection(projection_wkt))
+    {
+        println("input raster file must be in EPSG:3857 (Web Mercator) format");
+        println("you can reproject raster terrain using GDAL");
+        println("as follows: 'gdalwarp -t_srs EPSG:3857 input.tif output.tif'");
+        return false;
+    }
+    return true;
+}
+
+// opens a raster cache file written by create_raster_cache,
+// returns nullptr on failure
+static std::unique_ptr<RasterCacheSource> open_raster_cache(const std::string& file_name,
+                                                            bool validate_projection)
+{
+    TNTN_LOG_INFO("Opening raster cache {}...", file_name);
+
+    auto source = std::make_unique<RasterCacheSource>();
+    if(!source->open(file_name))
+    {
+        return nullptr;
+    }
+
+    if(validate_projection && !check_projection(source->get_projection().c_str()))
+    {
+        return nullptr;
+    }
+
+    return source;
+}
+
+// opens a raster file and checks that it can be processed,
+// returns nullptr on failure
+static GDALDataset_ptr open_raster_dataset(const std::string& file_name,
+                                           TransformationMatrix& gt,
+                                           bool validate_projection)
 {
     initialize_gdal_once();
 
@@ -358,23 +600,20 @@ bool load_raster_file(const std::string& file_name,
     if(dataset == nullptr)
     {
         TNTN_LOG_ERROR("Can't open input raster {}: ", file_name);
-        return false;
+        return dataset;
     }
 
-    TransformationMatrix gt;
-
     if(!get_transformation_matrix(dataset.get(), gt))
     {
-        return false;
+        dataset.reset();
+        return dataset;
     }
 
-    if(validate_projection && !is_valid_projection(dataset.get()))
+    // returned pointer should not be altered, freed or expected to last for long.
+    if(validate_projection && !check_projection(dataset->GetProjectionRef()))
     {
-        println("input raster file must be in EPSG:3857 (Web Mercator) format");
-        println("you can reproject raster terrain using GDAL");
-        println("as follows: 'gdalwarp -t_srs EPSG:3857 input.tif output.tif'");
-
-        return false;
+        dataset.reset();
+        return dataset;
     }
 
     int bands_count = dataset->GetRasterCount();
@@ -382,7 +621,8 @@ bool load_raster_file(const std::string& file_name,
     if(bands_count == 0)
     {
         TNTN_LOG_ERROR("Can't process a raster file witout raster bands");
-        return false;
+        dataset.reset();
+        return dataset;
     }
     else if(bands_count > 1)
     {
@@ -391,15 +631,92 @@ bool load_raster_file(const std::string& file_name,
                       bands_count);
     }
 
+    return dataset;
+}
+
+// GDAL data type matching the sample type of a raster
+template<typename T>
+struct GDALSampleType;
+
+template<>
+struct GDALSampleType<double>
+{
+    static constexpr GDALDataType type = GDT_Float64;
+};
+
+template<>
+struct GDALSampleType<float>
+{
+    static constexpr GDALDataType type = GDT_Float32;
+};
+
+template<>
+struct GDALSampleType<int16_t>
+{
+    static constexpr GDALDataType type = GDT_Int16;
+};
+
+// smallest supported sample type that represents all values of a band exactly
+static RasterSampleType native_sample_type(const GDALDataType type)
+{
+    switch(type)
+    {
+        case GDT_Byte:
+        case GDT_Int16:
+            return RasterSampleType::Int16;
+        case GDT_UInt16:
+        case GDT_Float32:
+            return RasterSampleType::Float32;
+        default:
+            return RasterSampleType::Float64;
+    }
+}
+
+template<typename T>
+static bool load_raster_file_as(const std::string& file_name,
+                                Raster<T>& target_raster,
+                                bool validate_projection)
+{
+    if(is_raster_cache_file(file_name))
+    {
+        auto source = open_raster_cache(file_name, validate_projection);
+        if(source != nullptr && !detail::sample_holds<T>(source->get_no_data_value()))
+        {
+            TNTN_LOG_ERROR("no-data value {} of {} doesn't fit the raster's sample type",
+                           source->get_no_data_value(),
+                           file_name);
+            return false;
+        }
+        return source != nullptr &&
+            source->crop(0, 0, source->get_width(), source->get_height(), target_raster);
+    }
+
+    TransformationMatrix gt{};
+    GDALDataset_ptr dataset = open_raster_dataset(file_name, gt, validate_projection);
+
+    if(dataset == nullptr)
+    {
+        return false;
+    }
+
     // TODO: Perhaps make raster band number a parameter
     GDALRasterBand* raster_band = dataset->GetRasterBand(1);
 
     int raster_width = raster_band->GetXSize();
     int raster_height = raster_band->GetYSize();
 
+    const double no_data_value = raster_band->GetNoDataValue();
+    if(!detail::sample_holds<T>(no_data_value))
+    {
+        TNTN_LOG_ERROR("no-data value {} of {} doesn't fit the raster's sample type",
+                       no_data_value,
+                       file_name);
+        return false;
+    }
+
     target_raster.set_cell_size(fabs(gt.scale_x));
     target_raster.allocate(raster_width, raster_height);
-    target_raster.set_no_data_value(raster_band->GetNoDataValue());
+    target_raster.set_no_data_value(detail::sample_cast<T>(no_data_value));
 
     TNTN_LOG_INFO("reading raster data...");
     if(raster_band->RasterIO(GF_Read,
@@ -410,7 +727,7 @@ bool load_raster_file(const std::string& file_name,
                              target_raster.get_ptr(),
                              raster_width,
                              raster_height,
-                             GDT_Float64,
+                             GDALSampleType<T>::type,
                              0,
                              0) != CE_None)
     {
@@ -440,4 +757,311 @@ bool load_raster_file(const std::string& file_name,
     return true;
 }
 
+bool load_raster_file(const std::string& file_name,
+                      RasterDouble& target_raster,
+                      bool validate_projection)
+{
+    return load_raster_file_as(file_name, target_raster, validate_projection);
+}
+
+bool load_raster_file(const std::string& file_name,
+                      RasterFloat& target_raster,
+                      bool validate_projection)
+{
+    return load_raster_file_as(file_name, target_raster, validate_projection);
+}
+
+bool load_raster_file(const std::string& file_name,
+                      RasterInt16& target_raster,
+                      bool validate_projection)
+{
+    return load_raster_file_as(file_name, target_raster, validate_projection);
+}
+
+// --------------------------------------------------------------------------------
+// Windowed raster access with GDAL
+
+namespace {
+
+// Reads the first band of a GDAL dataset block by block, blocks are cached
+// with the sample type S.
+// Presents the same orientation as load_raster_file, i.e. flips are applied
+// while copying pixels out of the cached blocks.
+template<typename S>
+class GDALRasterSource : public RasterSource
+{
+  public:
+    GDALRasterSource(GDALDataset_ptr dataset,
+                     const TransformationMatrix& gt,
+                     RasterSampleType sample_type,
+                     size_t cache_size) :
+        m_dataset(std::move(dataset)),
+        m_sample_type(sample_type)
+    {
+        m_band = m_dataset->GetRasterBand(1);
+        m_band->GetBlockSize(&m_block_width, &m_block_height);
+        m_block_width = std::max(m_block_width, 1);
+        m_block_height = std::max(m_block_height, 1);
+
+        m_width = m_band->GetXSize();
+        m_height = m_band->GetYSize();
+        m_cellsize = fabs(gt.scale_x);
+        m_noDataValue = m_band->GetNoDataValue();
+
+        const double x1 = gt.origin_x;
+        const double y1 = gt.origin_y;
+        const double x2 = gt.origin_x + m_width * gt.scale_x;
+        const double y2 = gt.origin_y + m_height * gt.scale_y;
+
+        // Ensure raster's origin is exactly at the lower left corner
+        m_xpos = std::min(x1, x2);
+        m_ypos = std::min(y1, y2);
+
+        m_flip_x = gt.scale_x < 0;
+        m_flip_y = gt.scale_y > 0;
+
+        m_blocks_x = (m_width + m_block_width - 1) / m_block_width;
+
+        const size_t block_bytes = sizeof(S) * m_block_width * m_block_height;
+        m_max_cached_blocks = std::max<size_t>(1, cache_size / block_bytes);
+
+        TNTN_LOG_DEBUG("raster source {}x{}, blocks of {}x{}, caching up to {} blocks",
+                       m_width,
+                       m_height,
+                       m_block_width,
+                       m_block_height,
+                       m_max_cached_blocks);
+    }
+
+    RasterSampleType get_sample_type() const override { return m_sample_type; }
+
+    bool read_window(
+        int cx, int cy, int cw, int ch, double* dst, size_t dst_stride) const override
+    {
+        return read_window_as(cx, cy, cw, ch, dst, dst_stride);
+    }
+
+    bool read_window(
+        int cx, int cy, int cw, int ch, float* dst, size_t dst_stride) const override
+    {
+        return read_window_as(cx, cy, cw, ch, dst, dst_stride);
+    }
+
+    bool read_window(
+        int cx, int cy, int cw, int ch, int16_t* dst, size_t dst_stride) const override
+    {
+        return read_window_as(cx, cy, cw, ch, dst, dst_stride);
+    }
+
+  private:
+    struct Block
+    {
+        size_t key;
+        int width;
+        std::vector<S> data;
+    };
+
+    typedef std::list<Block> BlockList;
+
+    template<typename D>
+    bool read_window_as(int cx, int cy, int cw, int ch, D* dst, size_t dst_stride) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        const int width = m_width;
+        const int height = m_height;
+
+        for(int r = 0; r < ch; r++)
+        {
+            const int src_row = m_flip_y ? height - 1 - (cy + r) : cy + r;
+            const int block_y = src_row / m_block_height;
+            const int block_row = src_row - block_y * m_block_height;
+            D* out = dst + r * dst_stride;
+
+            int c = 0;
+            while(c < cw)
+            {
+                const int src_col = m_flip_x ? width - 1 - (cx + c) : cx + c;
+                const int block_x = src_col / m_block_width;
+                const int block_col = src_col - block_x * m_block_width;
+
+                const Block* block = get_block(block_x, block_y);
+                if(block == nullptr)
+                {
+                    return false;
+                }
+
+                const S* p = block->data.data() + block_row * block->width;
+                if(!m_flip_x)
+                {
+                    const int n = std::min(cw - c, block->width - block_col);
+                    std::copy(p + block_col, p + block_col + n, out + c);
+                    c += n;
+                }
+                else
+                {
+                    const int n = std::min(cw - c, block_col + 1);
+                    for(int i = 0; i < n; i++)
+                    {
+                        out[c + i] = p[block_col - i];
+                    }
+                    c += n;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // returns the cached block, reads it if necessary,
+    // the pointer stays valid until the next call
+    const Block* get_block(const int block_x, const int block_y) const
+    {
+        const size_t key = static_cast<size_t>(block_y) * m_blocks_x + block_x;
+
+        auto it = m_block_index.find(key);
+        if(it != m_block_index.end())
+        {
+            // move to front of LRU list
+            m_blocks.splice(m_blocks.begin(), m_blocks, it->second);
+            return &m_blocks.front();
+        }
+
+        if(m_blocks.size() >= m_max_cached_blocks)
+        {
+            m_block_index.erase(m_blocks.back().key);
+            m_blocks.pop_back();
+        }
+
+        const int x0 = block_x * m_block_width;
+        const int y0 = block_y * m_block_height;
+        const int w = std::min<int>(m_block_width, m_width - x0);
+        const int h = std::min<int>(m_block_height, m_height - y0);
+
+        Block block;
+        block.key = key;
+        block.width = w;
+        block.data.resize(static_cast<size_t>(w) * h);
+
+        if(m_band->RasterIO(GF_Read,
+                            x0,
+                            y0,
+                            w,
+                            h,
+                            block.data.data(),
+                            w,
+                            h,
+                            GDALSampleType<S>::type,
+                            0,
+                            0) != CE_None)
+        {
+            TNTN_LOG_ERROR("Can not read raster block {},{}", block_x, block_y);
+            return nullptr;
+        }
+
+        m_blocks.push_front(std::move(block));
+        m_block_index[key] = m_blocks.begin();
+        return &m_blocks.front();
+    }
+
+    GDALDataset_ptr m_dataset;
+    GDALRasterBand* m_band = nullptr;
+    RasterSampleType m_sample_type;
+
+    int m_block_width = 1;
+    int m_block_height = 1;
+    size_t m_blocks_x = 0;
+    bool m_flip_x = false;
+    bool m_flip_y = false;
+
+    // GDAL datasets must not be used concurrently, the mutex
+    // serializes all reads and guards the block cache
+    mutable std::mutex m_mutex;
+    size_t m_max_cached_blocks = 1;
+    mutable BlockList m_blocks;
+    mutable std::unordered_map<size_t, typename BlockList::iterator> m_block_index;
+};
+
+static std::unique_ptr<RasterSource> make_gdal_raster_source(GDALDataset_ptr dataset,
+                                                            const TransformationMatrix& gt,
+                                                            size_t cache_size)
+{
+    const GDALDataType band_type = dataset->GetRasterBand(1)->GetRasterDataType();
+    RasterSampleType sample_type = native_sample_type(band_type);
+
+    // GDAL reports a no-data value even if the band declares none, if the native
+    // type can't hold it clamping would turn valid samples into no-data
+    const double no_data_value = dataset->GetRasterBand(1)->GetNoDataValue();
+    if(!sample_type_holds(sample_type, no_data_value))
+    {
+        TNTN_LOG_DEBUG("no-data value {} needs double samples", no_data_value);
+        sample_type = RasterSampleType::Float64;
+    }
+
+    switch(sample_type)
+    {
+        case RasterSampleType::Int16:
+            return std::make_unique<GDALRasterSource<int16_t>>(
+                std::move(dataset), gt, sample_type, cache_size);
+        case RasterSampleType::Float32:
+            return std::make_unique<GDALRasterSource<float>>(
+                std::move(dataset), gt, sample_type, cache_size);
+        default:
+            return std::make_unique<GDALRasterSource<double>>(
+                std::move(dataset), gt, sample_type, cache_size);
+    }
+}
+
+} // namespace
+
+std::unique_ptr<RasterSource> open_raster_source(const std::string& file_name,
+                                                 bool validate_projection,
+                                                 size_t cache_size)
+{
+    if(is_raster_cache_file(file_name))
+    {
+        return open_raster_cache(file_name, validate_projection);
+    }
+
+    TransformationMatrix gt{};
+    GDALDataset_ptr dataset = open_raster_dataset(file_name, gt, validate_projection);
+
+    if(dataset == nullptr)
+    {
+        return nullptr;
+    }
+
+    return make_gdal_raster_source(std::move(dataset), gt, cache_size);
+}
+
+bool create_raster_cache(const std::string& input_file_name,
+                         const std::string& cache_file_name,
+                         int block_size)
+{
+    if(is_raster_cache_file(input_file_name))
+    {
+        auto source = open_raster_cache(input_file_name, false);
+        return source != nullptr &&
+            write_raster_cache(*source, cache_file_name, source->get_projection(), block_size);
+    }
+
+    TransformationMatrix gt{};
+    GDALDataset_ptr dataset = open_raster_dataset(input_file_name, gt, false);
+
+    if(dataset == nullptr)
+    {
+        return false;
+    }
+
+    const char* projection_wkt = dataset->GetProjectionRef();
+    const std::string projection = projection_wkt != NULL ? projection_wkt : "";
+
+    // the input is read from top to bottom, the cache only has to hold one row of blocks
+    const auto source =
+        make_gdal_raster_source(std::move(dataset), gt, DEFAULT_RASTER_CACHE_SIZE);
+
+    TNTN_LOG_INFO("writing raster cache {}...", cache_file_name);
+    return write_raster_cache(*source, cache_file_name, projection, block_size);
+}
+
 } // namespace tntn
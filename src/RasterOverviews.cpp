@@ -2,14 +2,42 @@
 #include "tntn/raster_tools.h"
 #include "tntn/SurfacePoints.h"
 #include "tntn/gdal_init.h"
+#include "tntn/util.h"
 
+#include <algorithm>
 #include <cmath>
 #include <gdal_priv.h>
 
 namespace tntn {
 
-RasterOverviews::RasterOverviews(UniqueRasterPointer input_raster, int min_zoom, int max_zoom) :
+// upper bound of base pixels read at once per thread
+static constexpr size_t OVERVIEW_CHUNK_PIXELS = 4 * 1024 * 1024;
+
+RasterOverviews::RasterOverviews(UniqueRasterPointer input_raster,
+                                 int min_zoom,
+                                 int max_zoom,
+                                 int num_threads) :
     m_base_raster(std::move(input_raster)),
+    m_num_threads(num_threads),
+    m_min_zoom(min_zoom),
+    m_max_zoom(max_zoom),
+    m_estimated_min_zoom(0),
+    m_estimated_max_zoom(0)
+{
+    // the raster is owned by this object and outlives the view
+    m_base_view = std::make_shared<MemoryRasterSource>(
+        std::shared_ptr<const RasterDouble>(m_base_raster.get(), [](const RasterDouble*) {}));
+    compute_zoom_levels();
+    m_current_zoom = m_max_zoom;
+}
+
+RasterOverviews::RasterOverviews(std::shared_ptr<const RasterSource> base_source,
+                                 int min_zoom,
+                                 int max_zoom,
+                                 int num_threads) :
+    m_base_source(std::move(base_source)),
+    m_base_view(m_base_source),
+    m_num_threads(num_threads),
     m_min_zoom(min_zoom),
     m_max_zoom(max_zoom),
     m_estimated_min_zoom(0),
@@ -40,8 +68,8 @@ int RasterOverviews::guess_min_zoom_level(int max_zoom_level)
 	const int MINIMAL_RASTER_SIZE = 128;
     const double quotient = MINIMAL_RASTER_SIZE * (1 << max_zoom_level);
 
-    int raster_width = m_base_raster->get_width();
-    int raster_height = m_base_raster->get_height();
+    int raster_width = m_base_raster ? m_base_raster->get_width() : m_base_source->get_width();
+    int raster_height = m_base_raster ? m_base_raster->get_height() : m_base_source->get_height();
 
     TNTN_LOG_DEBUG("guess_min_zoom_level: raster_width: {}, raster_height: {}",
                        raster_width,
@@ -56,7 +84,9 @@ int RasterOverviews::guess_min_zoom_level(int max_zoom_level)
 
 void RasterOverviews::compute_zoom_levels()
 {
-    m_estimated_max_zoom = guess_max_zoom_level(fabs(m_base_raster->get_cell_size()));
+    const double cell_size =
+        m_base_raster ? m_base_raster->get_cell_size() : m_base_source->get_cell_size();
+    m_estimated_max_zoom = guess_max_zoom_level(fabs(cell_size));
     m_estimated_min_zoom = guess_min_zoom_level(m_estimated_max_zoom);
 
     m_min_zoom = std::max(m_min_zoom, m_estimated_min_zoom);
@@ -68,20 +98,207 @@ void RasterOverviews::compute_zoom_levels()
     }
 }
 
+int RasterOverviews::next_window_size() const
+{
+    return 1 << (m_estimated_max_zoom - m_current_zoom);
+}
+
+double RasterOverviews::get_resolution(const int zoom) const
+{
+    const double cell_size =
+        m_base_raster ? m_base_raster->get_cell_size() : m_base_source->get_cell_size();
+    return cell_size * (1 << (m_estimated_max_zoom - zoom));
+}
+
+// Makes m_level the level for window_size. The first level is summed from the base
+// raster with the same kernel as integer_downsample_mean, all following levels are
+// 2x2 reductions of the previous one. Rows are split across threads.
+bool RasterOverviews::advance_level(const int window_size)
+{
+    if(m_level.window_size == window_size)
+    {
+        return true;
+    }
+
+    PyramidLevel next;
+    next.window_size = window_size;
+
+    if(m_level.window_size > 0 && m_level.window_size * 2 == window_size)
+    {
+        const PyramidLevel& prev = m_level;
+        next.width = prev.width / 2;
+        next.height = prev.height / 2;
+        next.sum.resize(static_cast<size_t>(next.width) * next.height);
+        next.count.resize(next.sum.size());
+
+        for_each_row_range(next.height, m_num_threads, [&](int begin, int end) {
+            for(int r = begin; r < end; r++)
+            {
+                const size_t top = static_cast<size_t>(2 * r) * prev.width;
+                const size_t bottom = top + prev.width;
+                const size_t out = static_cast<size_t>(r) * next.width;
+                for(int c = 0; c < next.width; c++)
+                {
+                    const size_t i = 2 * c;
+                    next.sum[out + c] = prev.sum[top + i] + prev.sum[top + i + 1] +
+                                        prev.sum[bottom + i] + prev.sum[bottom + i + 1];
+                    next.count[out + c] = prev.count[top + i] + prev.count[top + i + 1] +
+                                          prev.count[bottom + i] + prev.count[bottom + i + 1];
+                }
+            }
+            return true;
+        });
+    }
+    else
+    {
+        const RasterSource& base = *m_base_view;
+        const int win = window_size;
+        const double ndv = base.get_no_data_value();
+
+        next.width = base.get_width() / win;
+        next.height = base.get_height() / win;
+        next.sum.resize(static_cast<size_t>(next.width) * next.height);
+        next.count.resize(next.sum.size());
+
+        // one chunk spans win base rows and as many output columns as fit
+        const int chunk_columns = static_cast<int>(
+            std::max<size_t>(1, OVERVIEW_CHUNK_PIXELS / (static_cast<size_t>(win) * win)));
+
+        const bool ok = for_each_row_range(next.height, m_num_threads, [&](int begin, int end) {
+            std::vector<double> chunk;
+            for(int r = begin; r < end; r++)
+            {
+                for(int c0 = 0; c0 < next.width; c0 += chunk_columns)
+                {
+                    const int columns = std::min(chunk_columns, next.width - c0);
+                    const size_t base_width = static_cast<size_t>(columns) * win;
+                    chunk.resize(base_width * win);
+
+                    if(!base.read_window(
+                           c0 * win, r * win, columns * win, win, chunk.data(), base_width))
+                    {
+                        return false;
+                    }
+
+                    const size_t out = static_cast<size_t>(r) * next.width + c0;
+                    raster_tools::sum_windows(chunk.data(),
+                                              base_width,
+                                              columns,
+                                              win,
+                                              ndv,
+                                              next.sum.data() + out,
+                                              next.count.data() + out);
+                }
+            }
+            return true;
+        });
+
+        if(!ok)
+        {
+            TNTN_LOG_ERROR("failed to read base raster for overview with window size {}",
+                           window_size);
+            return false;
+        }
+    }
+
+    m_level = std::move(next);
+    return true;
+}
+
+UniqueRasterPointer RasterOverviews::level_to_raster() const
+{
+    const RasterSource& base = *m_base_view;
+    const double ndv = base.get_no_data_value();
+
+    auto raster = std::make_unique<RasterDouble>(m_level.width, m_level.height);
+    raster->set_pos_x(base.get_pos_x());
+    raster->set_pos_y(base.get_pos_y());
+    raster->set_cell_size(base.get_cell_size() * m_level.window_size);
+    raster->set_no_data_value(ndv);
+
+    double* dst = raster->get_ptr();
+    for_each_row_range(m_level.height, m_num_threads, [&](int begin, int end) {
+        const size_t first = static_cast<size_t>(begin) * m_level.width;
+        const size_t last = static_cast<size_t>(end) * m_level.width;
+        for(size_t i = first; i < last; i++)
+        {
+            dst[i] = raster_tools::window_mean(m_level.sum[i], m_level.count[i], ndv);
+        }
+        return true;
+    });
+
+    return raster;
+}
+
+// overview for the current zoom level with a window size > 1,
+// either precomputed or reduced from the previous level
+UniqueRasterPointer RasterOverviews::take_overview(const int window_size)
+{
+    if(m_current_zoom < static_cast<int>(m_precomputed.size()) && m_precomputed[m_current_zoom])
+    {
+        return std::move(m_precomputed[m_current_zoom]);
+    }
+
+    if(!advance_level(window_size))
+    {
+        return nullptr;
+    }
+    return level_to_raster();
+}
+
+bool RasterOverviews::precompute()
+{
+    m_precomputed.clear();
+    m_precomputed.resize(std::max(0, m_current_zoom + 1));
+
+    for(int zoom = m_current_zoom; zoom >= m_min_zoom; zoom--)
+    {
+        const int window_size = 1 << (m_estimated_max_zoom - zoom);
+
+        // the base raster is its own overview
+        if(window_size == 1)
+        {
+            continue;
+        }
+
+        if(!advance_level(window_size))
+        {
+            m_precomputed.clear();
+            return false;
+        }
+        m_precomputed[zoom] = level_to_raster();
+    }
+
+    // all overviews are done, the sums are not needed anymore
+    m_level = PyramidLevel();
+    return true;
+}
+
 bool RasterOverviews::next(RasterOverview& overview)
 {
     if(m_current_zoom < m_min_zoom) return false;
 
-    int window_size = (1 << (m_estimated_max_zoom - m_current_zoom));
-    auto output_raster = std::make_unique<RasterDouble>();
+    if(!m_base_raster)
+    {
+        TNTN_LOG_ERROR("raster overviews of a raster source have to be read as sources");
+        return false;
+    }
+
+    int window_size = next_window_size();
+    UniqueRasterPointer output_raster;
 
     if(window_size == 1)
     {
-        *output_raster = m_base_raster->clone();
+        // shares the base raster's pixels instead of copying the whole input
+        output_raster = std::make_unique<RasterDouble>(m_base_raster->view());
     }
     else
     {
-        *output_raster = raster_tools::integer_downsample_mean(*m_base_raster, window_size);
+        output_raster = take_overview(window_size);
+        if(!output_raster)
+        {
+            return false;
+        }
     }
 
     overview.zoom_level = m_current_zoom--;
@@ -97,4 +314,50 @@ bool RasterOverviews::next(RasterOverview& overview)
     return true;
 }
 
+bool RasterOverviews::next(RasterSourceOverview& overview)
+{
+    if(m_current_zoom < m_min_zoom) return false;
+
+    if(!m_base_source)
+    {
+        TNTN_LOG_ERROR("raster overviews of an in-memory raster have to be read as rasters");
+        return false;
+    }
+
+    const int window_size = next_window_size();
+
+    const bool precomputed = m_current_zoom < static_cast<int>(m_precomputed.size()) &&
+        m_precomputed[m_current_zoom] != nullptr;
+
+    if(window_size == 1)
+    {
+        overview.source = m_base_source;
+    }
+    else if(!m_cascade && !precomputed)
+    {
+        overview.source = std::make_shared<DownsampledRasterSource>(m_base_source, window_size);
+    }
+    else
+    {
+        UniqueRasterPointer raster = take_overview(window_size);
+        if(!raster)
+        {
+            return false;
+        }
+        overview.source = std::make_shared<MemoryRasterSource>(
+            std::shared_ptr<const RasterDouble>(std::move(raster)));
+    }
+
+    overview.zoom_level = m_current_zoom--;
+    overview.resolution = overview.source->get_cell_size();
+
+    TNTN_LOG_DEBUG("Prepared next overview source at zoom {}, window size {}, min zoom level {}, max zoom level {}",
+                   m_current_zoom + 1,
+                   window_size,
+                   m_min_zoom,
+                   m_max_zoom);
+
+    return true;
+}
+
 } // namespace tntn
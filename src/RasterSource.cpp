@@ -0,0 +1,173 @@
+#include "tntn/RasterSource.h"
+#include "tntn/logging.h"
+#include "tntn/raster_tools.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace tntn {
+
+// same formulas as in Raster
+
+BBox2D RasterSource::get_bounding_box() const
+{
+    BBox2D bb;
+
+    bb.min.x = m_xpos + 0.5 * m_cellsize;
+    bb.min.y = m_ypos + 0.5 * m_cellsize;
+
+    bb.max.x = m_xpos + (get_width() - 1 + 0.5) * m_cellsize;
+    bb.max.y = m_ypos + (get_height() - 1 + 0.5) * m_cellsize;
+
+    return bb;
+}
+
+int RasterSource::x2col(double x) const
+{
+    if(m_cellsize > 0)
+    {
+        return (int)(0.5 + ((x - m_xpos - 0.5 * m_cellsize) / m_cellsize));
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+int RasterSource::y2row(double y) const
+{
+    if(m_cellsize > 0)
+    {
+        int r_ll = (int)(0.5 + (y - m_ypos - 0.5 * m_cellsize) / m_cellsize);
+        int r_tl = m_height - r_ll - 1;
+
+        return r_tl;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+template<typename T>
+static bool read_window_converted(const RasterSource& source,
+                                  int cx,
+                                  int cy,
+                                  int cw,
+                                  int ch,
+                                  T* dst,
+                                  size_t dst_stride)
+{
+    std::vector<double> row(cw);
+    for(int r = 0; r < ch; r++)
+    {
+        if(!source.read_window(cx, cy + r, cw, 1, row.data(), cw))
+        {
+            return false;
+        }
+        std::transform(
+            row.begin(), row.end(), dst + r * dst_stride, [](double v) { return detail::sample_cast<T>(v); });
+    }
+    return true;
+}
+
+bool RasterSource::read_window(
+    int cx, int cy, int cw, int ch, float* dst, size_t dst_stride) const
+{
+    return read_window_converted(*this, cx, cy, cw, ch, dst, dst_stride);
+}
+
+bool RasterSource::read_window(
+    int cx, int cy, int cw, int ch, int16_t* dst, size_t dst_stride) const
+{
+    return read_window_converted(*this, cx, cy, cw, ch, dst, dst_stride);
+}
+
+// --------------------------------------------------------------------------------
+
+MemoryRasterSource::MemoryRasterSource(std::shared_ptr<const RasterDouble> raster) :
+    m_raster(std::move(raster))
+{
+    copy_parameters(*m_raster);
+}
+
+bool MemoryRasterSource::read_window(
+    int cx, int cy, int cw, int ch, double* dst, size_t dst_stride) const
+{
+    for(int r = 0; r < ch; r++)
+    {
+        const double* p = m_raster->get_ptr(cy + r) + cx;
+        std::copy(p, p + cw, dst + r * dst_stride);
+    }
+    return true;
+}
+
+bool MemoryRasterSource::view_window(
+    int cx, int cy, int cw, int ch, RasterDouble& dst_raster) const
+{
+    dst_raster = m_raster->view(cx, cy, cw, ch);
+    return true;
+}
+
+// --------------------------------------------------------------------------------
+
+// upper bound for the number of base pixels held in memory by one read
+static constexpr size_t DOWNSAMPLE_CHUNK_PIXELS = 4 * 1024 * 1024;
+
+DownsampledRasterSource::DownsampledRasterSource(std::shared_ptr<const RasterSource> base,
+                                                 int window_size) :
+    m_base(std::move(base)),
+    m_window_size(std::max(window_size, 1))
+{
+    // mirrors the output raster of raster_tools::integer_downsample_mean
+    m_width = m_base->get_width() / m_window_size;
+    m_height = m_base->get_height() / m_window_size;
+    m_xpos = m_base->get_pos_x();
+    m_ypos = m_base->get_pos_y();
+    m_cellsize = m_base->get_cell_size() * m_window_size;
+    m_noDataValue = m_base->get_no_data_value();
+}
+
+bool DownsampledRasterSource::read_window(
+    int cx, int cy, int cw, int ch, double* dst, size_t dst_stride) const
+{
+    const int win = m_window_size;
+    const double ndv = m_noDataValue;
+
+    // one chunk spans win base rows and as many output columns as fit
+    const int chunk_columns = static_cast<int>(
+        std::max<size_t>(1, DOWNSAMPLE_CHUNK_PIXELS / (static_cast<size_t>(win) * win)));
+    std::vector<double> chunk;
+    std::vector<double> sum(std::min(chunk_columns, cw));
+    std::vector<uint32_t> count(sum.size());
+
+    for(int r = 0; r < ch; r++)
+    {
+        double* out = dst + r * dst_stride;
+
+        for(int c0 = 0; c0 < cw; c0 += chunk_columns)
+        {
+            const int columns = std::min(chunk_columns, cw - c0);
+            const size_t base_width = static_cast<size_t>(columns) * win;
+            chunk.resize(base_width * win);
+
+            if(!m_base->read_window(
+                   (cx + c0) * win, (cy + r) * win, columns * win, win, chunk.data(), base_width))
+            {
+                return false;
+            }
+
+            raster_tools::sum_windows(
+                chunk.data(), base_width, columns, win, ndv, sum.data(), count.data());
+
+            for(int c = 0; c < columns; c++)
+            {
+                out[c0 + c] = raster_tools::window_mean(sum[c], count[c], ndv);
+            }
+        }
+    }
+
+    return true;
+}
+
+} // namespace tntn
@@ -6,17 +6,21 @@
 
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 #include <array>
-#include <unordered_map>
 #include <cmath>
+#include <limits>
 
 namespace tntn {
 namespace terra {
 
-void TerraMesh::greedy_insert(double max_error)
+template<typename T>
+void TerraMesh<T>::greedy_insert(double max_error)
 {
     m_max_error = max_error;
     m_counter = 0;
+    m_skipped_scans = 0;
+    m_insertions.clear();
     int w = m_raster->get_width();
     int h = m_raster->get_height();
     TNTN_ASSERT(w > 0);
@@ -34,6 +38,8 @@ void TerraMesh::greedy_insert(double max_error)
     this->repair_point(w - 1, h - 1);
     this->repair_point(w - 1, 0);
 
+    m_bounds.build(*m_raster, m_raster->get_no_data_value());
+
     // Initialize the mesh to two triangles with the height field grid corners as vertices
     TNTN_LOG_INFO("initialize the mesh with four corner points");
     this->init_mesh(
@@ -53,7 +59,7 @@ void TerraMesh::greedy_insert(double max_error)
     while(t)
     {
         scan_triangle(t);
-        t = t->getLink();
+        t = this->next_face(t);
     }
 
     // Iterate until the error threshold is met
@@ -64,58 +70,69 @@ void TerraMesh::greedy_insert(double max_error)
         if(candidate.importance < m_max_error) continue;
 
         // Skip if the candidate is not the latest
-        if(m_token.value(candidate.y, candidate.x) != candidate.token) continue;
+        if(m_token.value(candidate.y, candidate.x) != candidate.token)
+        {
+            m_candidates.count_stale_pop();
+            continue;
+        }
 
         m_used.value(candidate.y, candidate.x) = 1;
+        if(m_record_insertions)
+        {
+            m_insertions.push_back({candidate.x, candidate.y, candidate.importance});
+        }
 
         //TNTN_LOG_DEBUG("inserting point: ({}, {}, {})", candidate.x, candidate.y, candidate.z);
         this->insert(glm::dvec2(candidate.x, candidate.y), candidate.triangle);
     }
 
+    const auto& stats = m_candidates.stats();
+    TNTN_LOG_DEBUG("candidates: {} pushed, {} replaced in place, {} popped, {} stale, peak heap size {}",
+                   stats.pushed,
+                   stats.replaced,
+                   stats.popped,
+                   stats.stale_popped,
+                   stats.peak_size);
+    TNTN_LOG_DEBUG("{} triangle scans skipped by the min/max pyramid", m_skipped_scans);
+    const auto edges = this->edge_stats();
+    TNTN_LOG_DEBUG("edges: {} live, {} recycled for reuse, peak {} live, {} allocated",
+                   edges.live,
+                   edges.free,
+                   edges.peak_live,
+                   edges.capacity);
+
     TNTN_LOG_INFO("finished greedy insertion");
 }
 
-void TerraMesh::scan_triangle_line(const Plane& plane,
-                                   int y,
-                                   double x1,
-                                   double x2,
-                                   Candidate& candidate,
-                                   const double no_data_value)
+template<typename T>
+void TerraMesh<T>::scan_triangle_line(const Plane& plane,
+                                      int y,
+                                      double x1,
+                                      double x2,
+                                      Candidate& candidate,
+                                      const double no_data_value)
 {
     const int startx = static_cast<int>(ceil(fmin(x1, x2)));
     const int endx = static_cast<int>(floor(fmax(x1, x2)));
 
     if(startx > endx) return;
 
-    double z0 = plane.eval(startx, y);
-    double dz = plane.a;
-
-    for(int x = startx; x <= endx; x++)
+    const LineMaximum m = scan_line_maximum(
+        m_raster->get_ptr(y), m_used.get_ptr(y), startx, endx, y, plane, no_data_value);
+    if(m.x >= 0)
     {
-        if(!m_used.value(y, x))
-        {
-            const double z = m_raster->value(y, x);
-            if(!is_no_data(z, no_data_value))
-            {
-                const double diff = fabs(z - z0);
-                //TNTN_LOG_DEBUG("candidate consider: ({}, {}, {}), diff: {}", x, y, z, diff);
-                candidate.consider(x, y, z, diff);
-            }
-        }
-        z0 += dz;
+        candidate.consider(m.x, y, m_raster->value(y, m.x), m.deviation);
     }
 }
 
-void TerraMesh::scan_triangle(dt_ptr t)
+template<typename T>
+void TerraMesh<T>::scan_triangle(dt_ptr t)
 {
+    std::array<Point2D, 3> by_y = this->triangle_points(t);
+
     Plane z_plane;
-    compute_plane(z_plane, t, *m_raster);
+    compute_plane(z_plane, by_y, *m_raster);
 
-    std::array<Point2D, 3> by_y = {{
-        t->point1(),
-        t->point2(),
-        t->point3(),
-    }};
     order_triangle_points(by_y);
     const double v0_x = by_y[0].x;
     const double v0_y = by_y[0].y;
@@ -124,6 +141,20 @@ void TerraMesh::scan_triangle(dt_ptr t)
     const double v2_x = by_y[2].x;
     const double v2_y = by_y[2].y;
 
+    // no pixel scan when the block bounds already prove the triangle to be within max_error
+    const int min_x = static_cast<int>(std::min(std::min(v0_x, v1_x), v2_x));
+    const int max_x = static_cast<int>(std::max(std::max(v0_x, v1_x), v2_x));
+    // the same truncated row bounds the scanlines below start and end on
+    const int first_y = static_cast<int>(v0_y);
+    const int middle_y = static_cast<int>(v1_y);
+    const int last_y = static_cast<int>(v2_y);
+    if(m_bounds.deviation_below(z_plane, min_x, first_y, max_x, last_y, m_max_error))
+    {
+        m_candidates.remove(t);
+        m_skipped_scans++;
+        return;
+    }
+
     Candidate candidate = {0, 0, 0.0, -DBL_MAX, m_counter++, t};
 
     const double dx2 = (v2_x - v0_x) / (v2_y - v0_y);
@@ -136,8 +167,8 @@ void TerraMesh::scan_triangle(dt_ptr t)
         double x1 = v0_x;
         double x2 = v0_x;
 
-        const int starty = v0_y;
-        const int endy = v1_y;
+        const int starty = first_y;
+        const int endy = middle_y;
 
         for(int y = starty; y < endy; y++)
         {
@@ -154,8 +185,8 @@ void TerraMesh::scan_triangle(dt_ptr t)
         double x1 = v1_x;
         double x2 = v0_x;
 
-        const int starty = v1_y;
-        const int endy = v2_y;
+        const int starty = middle_y;
+        const int endy = last_y;
 
         for(int y = starty; y <= endy; y++)
         {
@@ -172,67 +203,110 @@ void TerraMesh::scan_triangle(dt_ptr t)
     m_candidates.push_back(candidate);
 }
 
-std::unique_ptr<Mesh> TerraMesh::convert_to_mesh()
+template<typename T>
+std::unique_ptr<Mesh> TerraMesh<T>::convert_to_mesh()
 {
-    // Find all the vertices
-    int w = m_raster->get_width();
-    int h = m_raster->get_height();
-
-    std::vector<Vertex> mvertices;
-
-    Raster<int> vertex_id;
-    vertex_id.allocate(w, h);
-    vertex_id.set_all(0);
+    return to_mesh(*this);
+}
 
-    const double no_data_value = m_raster->get_no_data_value();
-    int index = 0;
-    for(int y = 0; y < h; y++)
+template<typename T>
+std::vector<std::unique_ptr<Mesh>> TerraMesh<T>::convert_to_meshes(
+    const std::vector<double>& max_errors)
+{
+    // number of recorded insertions made before the run would have stopped at each threshold
+    std::vector<size_t> cuts(max_errors.size(), m_insertions.size());
+    for(size_t i = 0; i < max_errors.size(); i++)
     {
-        for(int x = 0; x < w; x++)
+        for(size_t k = 0; k < m_insertions.size(); k++)
         {
-            if(m_used.value(y, x) == 1)
+            if(m_insertions[k].error < max_errors[i])
             {
-                const double z = m_raster->value(y, x);
-                if(is_no_data(z, no_data_value))
-                {
-                    continue;
-                }
-
-                Vertex v = Vertex({m_raster->col2x(x), m_raster->row2y(y), z});
-                mvertices.push_back(v);
-                vertex_id.value(y, x) = index;
-                index++;
+                cuts[i] = k;
+                break;
             }
         }
     }
 
-    // Find all the faces
-    std::vector<Face> mfaces;
-    dt_ptr t = m_first_face;
-    while(t)
+    std::vector<size_t> order(max_errors.size());
+    for(size_t i = 0; i < order.size(); i++)
     {
-        Face f;
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return cuts[a] < cuts[b]; });
+
+    // replay the insertions once, taking a snapshot at every cut
+    const int w = m_raster->get_width();
+    const int h = m_raster->get_height();
+    DelaunayMesh replay;
+    replay.init_mesh(
+        glm::dvec2(0, 0), glm::dvec2(0, h - 1), glm::dvec2(w - 1, h - 1), glm::dvec2(w - 1, 0));
 
-        glm::dvec2 p1 = t->point1();
-        glm::dvec2 p2 = t->point2();
-        glm::dvec2 p3 = t->point3();
+    // consecutive insertions are far apart and come without a triangle,
+    // so let each walk start from a grid with about one insertion per cell
+    const double area = static_cast<double>(w) * h;
+    const double insertions = static_cast<double>(std::max<size_t>(m_insertions.size(), 1));
+    replay.enable_hint_grid(std::max(1.0, std::sqrt(area / insertions)));
 
-        if(!ccw(p1, p2, p3))
+    std::vector<std::unique_ptr<Mesh>> meshes(max_errors.size());
+    size_t inserted = 0;
+    for(const size_t i : order)
+    {
+        if(cuts[i] == m_insertions.size())
         {
-            f[0] = vertex_id.value((int)p1.y, (int)p1.x);
-            f[1] = vertex_id.value((int)p2.y, (int)p2.x);
-            f[2] = vertex_id.value((int)p3.y, (int)p3.x);
+            meshes[i] = to_mesh(*this);
+            continue;
         }
-        else
+        for(; inserted < cuts[i]; inserted++)
         {
-            f[0] = vertex_id.value((int)p3.y, (int)p3.x);
-            f[1] = vertex_id.value((int)p2.y, (int)p2.x);
-            f[2] = vertex_id.value((int)p1.y, (int)p1.x);
+            const Insertion& p = m_insertions[inserted];
+            replay.insert(glm::dvec2(p.x, p.y), dt_ptr());
         }
+        meshes[i] = to_mesh(replay);
+    }
+    return meshes;
+}
 
-        mfaces.push_back(f);
+template<typename T>
+std::unique_ptr<Mesh> TerraMesh<T>::to_mesh(DelaunayMesh& triangulation) const
+{
+    std::vector<glm::ivec2> points;
+    std::vector<Face> mfaces;
+    triangulation.export_indexed(points, mfaces);
+
+    // vertices without data are dropped together with the faces using them
+    const VertexIndex no_vertex = std::numeric_limits<VertexIndex>::max();
+    std::vector<VertexIndex> vertex_id(points.size(), no_vertex);
 
-        t = t->getLink();
+    std::vector<Vertex> mvertices;
+    mvertices.reserve(points.size());
+
+    const double no_data_value = m_raster->get_no_data_value();
+    for(size_t i = 0; i < points.size(); i++)
+    {
+        const glm::ivec2& p = points[i];
+        const double z = m_raster->value(p.y, p.x);
+        if(is_no_data(z, no_data_value))
+        {
+            continue;
+        }
+
+        vertex_id[i] = mvertices.size();
+        mvertices.push_back(Vertex({m_raster->col2x(p.x), m_raster->row2y(p.y), z}));
+    }
+
+    if(mvertices.size() != points.size())
+    {
+        size_t nfaces = 0;
+        for(const Face& f : mfaces)
+        {
+            const Face g = {{vertex_id[f[0]], vertex_id[f[1]], vertex_id[f[2]]}};
+            if(g[0] != no_vertex && g[1] != no_vertex && g[2] != no_vertex)
+            {
+                mfaces[nfaces++] = g;
+            }
+        }
+        TNTN_LOG_WARN("dropped {} faces at vertices without data", mfaces.size() - nfaces);
+        mfaces.resize(nfaces);
     }
 
     // now initialise our mesh class with this
@@ -241,5 +315,9 @@ std::unique_ptr<Mesh> TerraMesh::convert_to_mesh()
     return mesh;
 }
 
+template class TerraMesh<double>;
+template class TerraMesh<float>;
+template class TerraMesh<int16_t>;
+
 } //namespace terra
 } //namespace tntn
@@ -0,0 +1,330 @@
+#include "tntn/TerraUtils.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if(defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define TNTN_SCAN_LINE_X86 1
+#include <immintrin.h>
+#endif
+
+// The vector kernels evaluate the plane exactly like Plane::eval,
+// i.e. (a * x + b * y) + c for every pixel, and keep the first maximum
+// per lane. Reducing the lanes to the largest deviation with the smallest x
+// then gives the same pixel as the scalar loop.
+
+namespace tntn {
+namespace terra {
+
+template<typename T>
+static LineMaximum scan_line_maximum_scalar(const T* z,
+                                            const char* used,
+                                            int startx,
+                                            int endx,
+                                            int y,
+                                            const Plane& plane,
+                                            double no_data_value)
+{
+    LineMaximum m;
+    for(int x = startx; x <= endx; x++)
+    {
+        if(!used[x])
+        {
+            const double zx = z[x];
+            if(!is_no_data(zx, no_data_value))
+            {
+                const double diff = fabs(zx - plane.eval(x, y));
+                if(diff > m.deviation)
+                {
+                    m.x = x;
+                    m.deviation = diff;
+                }
+            }
+        }
+    }
+    return m;
+}
+
+#if TNTN_SCAN_LINE_X86
+
+// lanes of best holding the same deviation are resolved to the smallest x
+static void reduce_lanes(const double* best, const double* best_x, int lanes, LineMaximum& m)
+{
+    for(int i = 0; i < lanes; i++)
+    {
+        if(best[i] > m.deviation || (best[i] == m.deviation && best_x[i] < m.x))
+        {
+            m.deviation = best[i];
+            m.x = static_cast<int>(best_x[i]);
+        }
+    }
+}
+
+// --------------------------------------------------------------------------------
+// AVX2, 2 x 4 pixels per iteration
+
+__attribute__((target("avx2"))) static inline __m256d load4(const double* p)
+{
+    return _mm256_loadu_pd(p);
+}
+
+__attribute__((target("avx2"))) static inline __m256d load4(const float* p)
+{
+    return _mm256_cvtps_pd(_mm_loadu_ps(p));
+}
+
+__attribute__((target("avx2"))) static inline __m256d load4(const int16_t* p)
+{
+    int64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(_mm_cvtsi64_si128(v)));
+}
+
+__attribute__((target("avx2"))) static inline __m256d unused4(const char* p)
+{
+    int32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    const __m128i used = _mm_cvtepi8_epi32(_mm_cvtsi32_si128(v));
+    return _mm256_castsi256_pd(
+        _mm256_cvtepi32_epi64(_mm_cmpeq_epi32(used, _mm_setzero_si128())));
+}
+
+template<typename T>
+__attribute__((target("avx2"))) static inline void scan4_avx2(const T* z,
+                                                              const char* used,
+                                                              const __m256d xs,
+                                                              const __m256d a,
+                                                              const __m256d by,
+                                                              const __m256d c,
+                                                              const __m256d ndv,
+                                                              const __m256d abs_mask,
+                                                              __m256d& best,
+                                                              __m256d& best_x)
+{
+    const __m256d zx = load4(z);
+    const __m256d z0 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(a, xs), by), c);
+    const __m256d diff = _mm256_and_pd(_mm256_sub_pd(zx, z0), abs_mask);
+
+    __m256d valid = unused4(used);
+    valid = _mm256_and_pd(valid, _mm256_cmp_pd(zx, zx, _CMP_ORD_Q));
+    valid = _mm256_and_pd(valid, _mm256_cmp_pd(zx, ndv, _CMP_NEQ_OQ));
+
+    const __m256d greater = _mm256_and_pd(valid, _mm256_cmp_pd(diff, best, _CMP_GT_OQ));
+    best = _mm256_blendv_pd(best, diff, greater);
+    best_x = _mm256_blendv_pd(best_x, xs, greater);
+}
+
+template<typename T>
+__attribute__((target("avx2"))) static LineMaximum scan_line_maximum_avx2(const T* z,
+                                                                          const char* used,
+                                                                          int startx,
+                                                                          int endx,
+                                                                          int y,
+                                                                          const Plane& plane,
+                                                                          double no_data_value)
+{
+    const __m256d a = _mm256_set1_pd(plane.a);
+    const __m256d by = _mm256_set1_pd(plane.b * y);
+    const __m256d c = _mm256_set1_pd(plane.c);
+    const __m256d ndv = _mm256_set1_pd(no_data_value);
+    const __m256d abs_mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+    const __m256d step = _mm256_set1_pd(8);
+
+    __m256d best0 = _mm256_set1_pd(-DBL_MAX);
+    __m256d best1 = best0;
+    __m256d best_x0 = _mm256_set1_pd(0);
+    __m256d best_x1 = best_x0;
+    __m256d xs0 = _mm256_setr_pd(startx, startx + 1, startx + 2, startx + 3);
+    __m256d xs1 = _mm256_add_pd(xs0, _mm256_set1_pd(4));
+
+    int x = startx;
+    for(; x + 7 <= endx; x += 8)
+    {
+        scan4_avx2(z + x, used + x, xs0, a, by, c, ndv, abs_mask, best0, best_x0);
+        scan4_avx2(z + x + 4, used + x + 4, xs1, a, by, c, ndv, abs_mask, best1, best_x1);
+        xs0 = _mm256_add_pd(xs0, step);
+        xs1 = _mm256_add_pd(xs1, step);
+    }
+
+    double best[8];
+    double best_x[8];
+    _mm256_storeu_pd(best, best0);
+    _mm256_storeu_pd(best + 4, best1);
+    _mm256_storeu_pd(best_x, best_x0);
+    _mm256_storeu_pd(best_x + 4, best_x1);
+
+    LineMaximum m;
+    reduce_lanes(best, best_x, 8, m);
+
+    // remaining pixels lie behind all vector lanes, ties keep the earlier pixel
+    const LineMaximum tail = scan_line_maximum_scalar(z, used, x, endx, y, plane, no_data_value);
+    if(tail.deviation > m.deviation)
+    {
+        m = tail;
+    }
+    return m;
+}
+
+// --------------------------------------------------------------------------------
+// SSE4.1, 2 x 2 pixels per iteration
+
+__attribute__((target("sse4.1"))) static inline __m128d load2(const double* p)
+{
+    return _mm_loadu_pd(p);
+}
+
+__attribute__((target("sse4.1"))) static inline __m128d load2(const float* p)
+{
+    return _mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(p))));
+}
+
+__attribute__((target("sse4.1"))) static inline __m128d load2(const int16_t* p)
+{
+    int32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return _mm_cvtepi32_pd(_mm_cvtepi16_epi32(_mm_cvtsi32_si128(v)));
+}
+
+__attribute__((target("sse4.1"))) static inline __m128d unused2(const char* p)
+{
+    int16_t v;
+    std::memcpy(&v, p, sizeof(v));
+    const __m128i used = _mm_cvtepi8_epi64(_mm_cvtsi32_si128(static_cast<uint16_t>(v)));
+    return _mm_castsi128_pd(_mm_cmpeq_epi64(used, _mm_setzero_si128()));
+}
+
+template<typename T>
+__attribute__((target("sse4.1"))) static inline void scan2_sse41(const T* z,
+                                                                 const char* used,
+                                                                 const __m128d xs,
+                                                                 const __m128d a,
+                                                                 const __m128d by,
+                                                                 const __m128d c,
+                                                                 const __m128d ndv,
+                                                                 const __m128d abs_mask,
+                                                                 __m128d& best,
+                                                                 __m128d& best_x)
+{
+    const __m128d zx = load2(z);
+    const __m128d z0 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(a, xs), by), c);
+    const __m128d diff = _mm_and_pd(_mm_sub_pd(zx, z0), abs_mask);
+
+    __m128d valid = unused2(used);
+    valid = _mm_and_pd(valid, _mm_cmpord_pd(zx, zx));
+    valid = _mm_and_pd(valid, _mm_cmpneq_pd(zx, ndv));
+
+    const __m128d greater = _mm_and_pd(valid, _mm_cmpgt_pd(diff, best));
+    best = _mm_blendv_pd(best, diff, greater);
+    best_x = _mm_blendv_pd(best_x, xs, greater);
+}
+
+template<typename T>
+__attribute__((target("sse4.1"))) static LineMaximum scan_line_maximum_sse41(const T* z,
+                                                                             const char* used,
+                                                                             int startx,
+                                                                             int endx,
+                                                                             int y,
+                                                                             const Plane& plane,
+                                                                             double no_data_value)
+{
+    const __m128d a = _mm_set1_pd(plane.a);
+    const __m128d by = _mm_set1_pd(plane.b * y);
+    const __m128d c = _mm_set1_pd(plane.c);
+    const __m128d ndv = _mm_set1_pd(no_data_value);
+    const __m128d abs_mask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+    const __m128d step = _mm_set1_pd(4);
+
+    __m128d best0 = _mm_set1_pd(-DBL_MAX);
+    __m128d best1 = best0;
+    __m128d best_x0 = _mm_set1_pd(0);
+    __m128d best_x1 = best_x0;
+    __m128d xs0 = _mm_setr_pd(startx, startx + 1);
+    __m128d xs1 = _mm_add_pd(xs0, _mm_set1_pd(2));
+
+    int x = startx;
+    for(; x + 3 <= endx; x += 4)
+    {
+        scan2_sse41(z + x, used + x, xs0, a, by, c, ndv, abs_mask, best0, best_x0);
+        scan2_sse41(z + x + 2, used + x + 2, xs1, a, by, c, ndv, abs_mask, best1, best_x1);
+        xs0 = _mm_add_pd(xs0, step);
+        xs1 = _mm_add_pd(xs1, step);
+    }
+
+    double best[4];
+    double best_x[4];
+    _mm_storeu_pd(best, best0);
+    _mm_storeu_pd(best + 2, best1);
+    _mm_storeu_pd(best_x, best_x0);
+    _mm_storeu_pd(best_x + 2, best_x1);
+
+    LineMaximum m;
+    reduce_lanes(best, best_x, 4, m);
+
+    // remaining pixels lie behind all vector lanes, ties keep the earlier pixel
+    const LineMaximum tail = scan_line_maximum_scalar(z, used, x, endx, y, plane, no_data_value);
+    if(tail.deviation > m.deviation)
+    {
+        m = tail;
+    }
+    return m;
+}
+
+#endif
+
+ScanLineKernel detect_scan_line_kernel()
+{
+#if TNTN_SCAN_LINE_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return ScanLineKernel::AVX2;
+    }
+    if(__builtin_cpu_supports("sse4.1"))
+    {
+        return ScanLineKernel::SSE41;
+    }
+#endif
+    return ScanLineKernel::Scalar;
+}
+
+template<typename T>
+LineMaximum scan_line_maximum(const T* z,
+                              const char* used,
+                              int startx,
+                              int endx,
+                              int y,
+                              const Plane& plane,
+                              double no_data_value,
+                              ScanLineKernel kernel)
+{
+#if TNTN_SCAN_LINE_X86
+    switch(kernel)
+    {
+        case ScanLineKernel::AVX2:
+            return scan_line_maximum_avx2(z, used, startx, endx, y, plane, no_data_value);
+        case ScanLineKernel::SSE41:
+            return scan_line_maximum_sse41(z, used, startx, endx, y, plane, no_data_value);
+        default:
+            break;
+    }
+#endif
+    return scan_line_maximum_scalar(z, used, startx, endx, y, plane, no_data_value);
+}
+
+#define TNTN_INSTANTIATE_SCAN_LINE_MAXIMUM(T)                                                      \
+    template LineMaximum scan_line_maximum(const T* z,                                             \
+                                           const char* used,                                       \
+                                           int startx,                                             \
+                                           int endx,                                               \
+                                           int y,                                                  \
+                                           const Plane& plane,                                     \
+                                           double no_data_value,                                   \
+                                           ScanLineKernel kernel);
+
+TNTN_INSTANTIATE_SCAN_LINE_MAXIMUM(double)
+TNTN_INSTANTIATE_SCAN_LINE_MAXIMUM(float)
+TNTN_INSTANTIATE_SCAN_LINE_MAXIMUM(int16_t)
+
+} // namespace terra
+} // namespace tntn
@@ -1,30 +1,279 @@
 #include "tntn/TerraUtils.h"
 #include "tntn/logging.h"
 #include "tntn/raster_tools.h"
+#include "tntn/tntn_assert.h"
+
+#include <algorithm>
+#include <type_traits>
 
 namespace tntn {
 namespace terra {
 
-void TerraBaseMesh::repair_point(int px, int py)
+template<typename T>
+void TerraBaseMesh<T>::repair_point(int px, int py)
 {
-    double& p = m_raster->value(py, px);
-    const double z = raster_tools::sample_nearest_valid_avg(*m_raster, py, px);
     const double no_data_value = m_raster->get_no_data_value();
+    if(!is_no_data(m_raster->value(py, px), no_data_value))
+    {
+        return;
+    }
+
+    // don't fill in the pixels of the raster a view was taken from
+    if(m_raster->is_view())
+    {
+        *m_raster = m_raster->clone();
+    }
+
+    T& p = m_raster->value(py, px);
+    const double z = raster_tools::sample_nearest_valid_avg(*m_raster, py, px);
     if(is_no_data(z, no_data_value))
     {
-        p = 0.0;
+        p = 0;
     }
     else
     {
         TNTN_LOG_DEBUG("fill missing point: ({}, {}, {})", px, py, z);
-        p = z;
+        p = detail::sample_cast<T>(z);
+    }
+}
+
+template<typename T>
+bool repair_corners_exactly(Raster<T>& raster)
+{
+    // double rasters hold every fill
+    if(std::is_same<T, double>::value || raster.empty())
+    {
+        return true;
+    }
+
+    const int w = raster.get_width();
+    const int h = raster.get_height();
+    const double no_data_value = raster.get_no_data_value();
+
+    // same order as in TerraMesh and ZemlyaMesh, later fills can use earlier ones
+    const int corners[4][2] = {{0, 0}, {0, h - 1}, {w - 1, h - 1}, {w - 1, 0}};
+    for(const auto& corner : corners)
+    {
+        T& p = raster.value(corner[1], corner[0]);
+        if(!is_no_data(p, no_data_value))
+        {
+            continue;
+        }
+
+        const double z = raster_tools::sample_nearest_valid_avg(raster, corner[1], corner[0]);
+        if(is_no_data(z, no_data_value))
+        {
+            p = 0;
+        }
+        else if(detail::sample_holds<T>(z))
+        {
+            p = detail::sample_cast<T>(z);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename T>
+std::unique_ptr<RasterDouble> to_double_raster(const Raster<T>& raster)
+{
+    auto out = std::make_unique<RasterDouble>(raster.get_width(), raster.get_height());
+    out->set_pos_x(raster.get_pos_x());
+    out->set_pos_y(raster.get_pos_y());
+    out->set_cell_size(raster.get_cell_size());
+    out->set_no_data_value(raster.get_no_data_value());
+    for(unsigned int r = 0; r < raster.get_height(); r++)
+    {
+        std::copy(raster.get_ptr(r), raster.get_ptr(r) + raster.get_width(), out->get_ptr(r));
     }
+    return out;
 }
 
-void TerraBaseMesh::load_raster(std::unique_ptr<RasterDouble> raster)
+template<typename T>
+void TerraBaseMesh<T>::load_raster(std::unique_ptr<Raster<T>> raster)
 {
     m_raster = std::move(raster);
 }
 
+template<typename T>
+void MinMaxPyramid::build(const Raster<T>& raster, const double no_data_value)
+{
+    m_levels.clear();
+
+    const int w = raster.get_width();
+    const int h = raster.get_height();
+    if(w <= 0 || h <= 0)
+    {
+        return;
+    }
+
+    Level base;
+    base.width = (w + BLOCK_SIZE - 1) >> BLOCK_SIZE_LOG2;
+    base.height = (h + BLOCK_SIZE - 1) >> BLOCK_SIZE_LOG2;
+    base.min.assign(static_cast<size_t>(base.width) * base.height, DBL_MAX);
+    base.max.assign(static_cast<size_t>(base.width) * base.height, -DBL_MAX);
+
+    for(int y = 0; y < h; y++)
+    {
+        const T* row = raster.get_ptr(y);
+        double* block_min = &base.min[static_cast<size_t>(y >> BLOCK_SIZE_LOG2) * base.width];
+        double* block_max = &base.max[static_cast<size_t>(y >> BLOCK_SIZE_LOG2) * base.width];
+        for(int x = 0; x < w; x++)
+        {
+            const double z = row[x];
+            if(is_no_data(z, no_data_value))
+            {
+                continue;
+            }
+            const int bx = x >> BLOCK_SIZE_LOG2;
+            block_min[bx] = std::min(block_min[bx], z);
+            block_max[bx] = std::max(block_max[bx], z);
+        }
+    }
+    m_levels.push_back(std::move(base));
+
+    while(m_levels.back().width > 1 || m_levels.back().height > 1)
+    {
+        const Level& below = m_levels.back();
+
+        Level level;
+        level.width = (below.width + 1) / 2;
+        level.height = (below.height + 1) / 2;
+        level.min.assign(static_cast<size_t>(level.width) * level.height, DBL_MAX);
+        level.max.assign(static_cast<size_t>(level.width) * level.height, -DBL_MAX);
+
+        for(int y = 0; y < below.height; y++)
+        {
+            for(int x = 0; x < below.width; x++)
+            {
+                const size_t from = static_cast<size_t>(y) * below.width + x;
+                const size_t to = static_cast<size_t>(y / 2) * level.width + x / 2;
+                level.min[to] = std::min(level.min[to], below.min[from]);
+                level.max[to] = std::max(level.max[to], below.max[from]);
+            }
+        }
+        m_levels.push_back(std::move(level));
+    }
+}
+
+bool MinMaxPyramid::deviation_below(const Plane& plane,
+                                    const int x0,
+                                    const int y0,
+                                    const int x1,
+                                    const int y1,
+                                    const double threshold) const noexcept
+{
+    if(m_levels.empty())
+    {
+        return false;
+    }
+
+    // start at the finest level where the rectangle spans at most 2x2 blocks
+    const int extent = std::max(x1 - x0, y1 - y0) + 1;
+    int start_level = 0;
+    while(start_level + 1 < static_cast<int>(m_levels.size()) &&
+          (BLOCK_SIZE << start_level) < extent)
+    {
+        start_level++;
+    }
+
+    struct Block
+    {
+        int level;
+        int bx;
+        int by;
+    };
+
+    // depth first, every refined block replaces itself with at most 4 children
+    std::array<Block, 4 + 3 * 32> stack;
+    size_t top = 0;
+
+    const int start_shift = BLOCK_SIZE_LOG2 + start_level;
+    for(int by = y0 >> start_shift; by <= y1 >> start_shift; by++)
+    {
+        for(int bx = x0 >> start_shift; bx <= x1 >> start_shift; bx++)
+        {
+            stack[top++] = {start_level, bx, by};
+        }
+    }
+
+    while(top > 0)
+    {
+        const Block b = stack[--top];
+        const Level& level = m_levels[b.level];
+        const size_t i = static_cast<size_t>(b.by) * level.width + b.bx;
+        const double zmin = level.min[i];
+        const double zmax = level.max[i];
+        if(zmin > zmax)
+        {
+            continue;
+        }
+
+        const int shift = BLOCK_SIZE_LOG2 + b.level;
+        const int rx0 = std::max(x0, b.bx << shift);
+        const int rx1 = std::min(x1, ((b.bx + 1) << shift) - 1);
+        const int ry0 = std::max(y0, b.by << shift);
+        const int ry1 = std::min(y1, ((b.by + 1) << shift) - 1);
+
+        // the plane is linear, so its extremes over the rectangle are at the corners
+        const double ax0 = plane.a * rx0;
+        const double ax1 = plane.a * rx1;
+        const double by0 = plane.b * ry0;
+        const double by1 = plane.b * ry1;
+        const double plane_min = std::min(ax0, ax1) + std::min(by0, by1) + plane.c;
+        const double plane_max = std::max(ax0, ax1) + std::max(by0, by1) + plane.c;
+        const double bound = std::max(zmax - plane_min, plane_max - zmin);
+
+        // margin for the rounding of the plane evaluation in the pixel scan
+        const double magnitude = std::max(std::fabs(ax0), std::fabs(ax1)) +
+                                 std::max(std::fabs(by0), std::fabs(by1)) + std::fabs(plane.c) +
+                                 std::max(std::fabs(zmin), std::fabs(zmax));
+        const double slack = 1e-12 * magnitude;
+        if(bound + slack < threshold)
+        {
+            continue;
+        }
+        if(b.level == 0)
+        {
+            return false;
+        }
+
+        const Level& children = m_levels[b.level - 1];
+        const int child_shift = shift - 1;
+        const int cy0 = std::max(2 * b.by, ry0 >> child_shift);
+        const int cy1 = std::min(std::min(2 * b.by + 1, ry1 >> child_shift), children.height - 1);
+        const int cx0 = std::max(2 * b.bx, rx0 >> child_shift);
+        const int cx1 = std::min(std::min(2 * b.bx + 1, rx1 >> child_shift), children.width - 1);
+        for(int cy = cy0; cy <= cy1; cy++)
+        {
+            for(int cx = cx0; cx <= cx1; cx++)
+            {
+                TNTN_ASSERT(top < stack.size());
+                stack[top++] = {b.level - 1, cx, cy};
+            }
+        }
+    }
+    return true;
+}
+
+template void MinMaxPyramid::build(const Raster<double>&, double);
+template void MinMaxPyramid::build(const Raster<float>&, double);
+template void MinMaxPyramid::build(const Raster<int16_t>&, double);
+
+template bool repair_corners_exactly(Raster<double>&);
+template bool repair_corners_exactly(Raster<float>&);
+template bool repair_corners_exactly(Raster<int16_t>&);
+
+template std::unique_ptr<RasterDouble> to_double_raster(const Raster<double>&);
+template std::unique_ptr<RasterDouble> to_double_raster(const Raster<float>&);
+template std::unique_ptr<RasterDouble> to_double_raster(const Raster<int16_t>&);
+
+template class TerraBaseMesh<double>;
+template class TerraBaseMesh<float>;
+template class TerraBaseMesh<int16_t>;
+
 } // namespace terra
 } // namespace tntn
@@ -12,6 +12,8 @@
 #include <vector>
 #include <string>
 #include <array>
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
 
 namespace tntn {
@@ -39,10 +41,160 @@ bool TileMaker::loadObj(const char* filename)
 void TileMaker::loadMesh(std::unique_ptr<Mesh> mesh)
 {
     m_mesh = std::move(mesh);
+    m_mesh->generate_triangles();
+    build_grid_index();
 }
 
-// Dump a tile into an terrain tile in format determined by a MeshWriter
-bool TileMaker::dumpTile(int tx, int ty, int zoom, const char* filename, MeshWriter& mesh_writer)
+// average number of triangles per grid cell
+static constexpr double TRIANGLES_PER_GRID_CELL = 4.0;
+
+static int clamp_cell(const double v, const int cells)
+{
+    // v may be out of the grid's range, also +/- inf for degenerate cell sizes
+    if(!(v > 0))
+    {
+        return 0;
+    }
+    if(v >= cells - 1)
+    {
+        return cells - 1;
+    }
+    return static_cast<int>(v);
+}
+
+void TileMaker::build_grid_index()
+{
+    m_cell_start.clear();
+    m_cell_triangles.clear();
+    m_grid_columns = 0;
+    m_grid_rows = 0;
+
+    const auto triangles_range = m_mesh->triangles();
+    const size_t triangle_count = triangles_range.distance();
+    if(triangle_count == 0)
+    {
+        return;
+    }
+
+    m_grid_bbox.reset();
+    triangles_range.for_each([this](const Triangle& t) { m_grid_bbox.add(t); });
+
+    const double width = m_grid_bbox.max.x - m_grid_bbox.min.x;
+    const double height = m_grid_bbox.max.y - m_grid_bbox.min.y;
+
+    // square-ish cells, sized so each cell holds a few triangles on average
+    const double cell_count = std::max(1.0, triangle_count / TRIANGLES_PER_GRID_CELL);
+    if(width > 0 && height > 0)
+    {
+        const double cell_size = std::sqrt(width * height / cell_count);
+        m_grid_columns = static_cast<int>(std::ceil(width / cell_size));
+        m_grid_rows = static_cast<int>(std::ceil(height / cell_size));
+    }
+    m_grid_columns = std::max(1, std::min(m_grid_columns, 4096));
+    m_grid_rows = std::max(1, std::min(m_grid_rows, 4096));
+    m_grid_cell_width = width / m_grid_columns;
+    m_grid_cell_height = height / m_grid_rows;
+
+    // counting sort of triangle indices into cells (CSR layout)
+    std::vector<std::array<int, 4>> cell_ranges;
+    cell_ranges.reserve(triangle_count);
+    m_cell_start.assign(static_cast<size_t>(m_grid_columns) * m_grid_rows + 1, 0);
+
+    for(const Triangle* tp = triangles_range.begin; tp != triangles_range.end; tp++)
+    {
+        const BBox2D tb(*tp);
+        const std::array<int, 4> r = {{
+            clamp_cell((tb.min.x - m_grid_bbox.min.x) / m_grid_cell_width, m_grid_columns),
+            clamp_cell((tb.min.y - m_grid_bbox.min.y) / m_grid_cell_height, m_grid_rows),
+            clamp_cell((tb.max.x - m_grid_bbox.min.x) / m_grid_cell_width, m_grid_columns),
+            clamp_cell((tb.max.y - m_grid_bbox.min.y) / m_grid_cell_height, m_grid_rows),
+        }};
+        for(int row = r[1]; row <= r[3]; row++)
+        {
+            for(int col = r[0]; col <= r[2]; col++)
+            {
+                m_cell_start[static_cast<size_t>(row) * m_grid_columns + col + 1]++;
+            }
+        }
+        cell_ranges.push_back(r);
+    }
+
+    for(size_t c = 1; c < m_cell_start.size(); c++)
+    {
+        m_cell_start[c] += m_cell_start[c - 1];
+    }
+    m_cell_triangles.resize(m_cell_start.back());
+
+    std::vector<uint32_t> cell_fill(m_cell_start.begin(), m_cell_start.end() - 1);
+    for(size_t ti = 0; ti < triangle_count; ti++)
+    {
+        const auto& r = cell_ranges[ti];
+        for(int row = r[1]; row <= r[3]; row++)
+        {
+            for(int col = r[0]; col <= r[2]; col++)
+            {
+                const size_t c = static_cast<size_t>(row) * m_grid_columns + col;
+                m_cell_triangles[cell_fill[c]++] = static_cast<uint32_t>(ti);
+            }
+        }
+    }
+
+    TNTN_LOG_DEBUG("triangle grid index: {} triangles in {}x{} cells, {} cell entries",
+                   triangle_count,
+                   m_grid_columns,
+                   m_grid_rows,
+                   m_cell_triangles.size());
+}
+
+void TileMaker::find_triangles(const BBox2D& bounds,
+                               std::vector<uint32_t>& triangle_indices) const
+{
+    triangle_indices.clear();
+    if(m_cell_start.empty() || !bounds.intersects(m_grid_bbox))
+    {
+        return;
+    }
+
+    // BBox2D::intersects grows both boxes by eps, so must the cell lookup
+    BBox2D query = bounds;
+    query.grow(2 * BBox2D::eps);
+
+    const int col_min =
+        clamp_cell((query.min.x - m_grid_bbox.min.x) / m_grid_cell_width, m_grid_columns);
+    const int row_min =
+        clamp_cell((query.min.y - m_grid_bbox.min.y) / m_grid_cell_height, m_grid_rows);
+    const int col_max =
+        clamp_cell((query.max.x - m_grid_bbox.min.x) / m_grid_cell_width, m_grid_columns);
+    const int row_max =
+        clamp_cell((query.max.y - m_grid_bbox.min.y) / m_grid_cell_height, m_grid_rows);
+
+    // cells also hold triangles whose bounding box only overlaps the cell, not bounds
+    const Triangle* triangles = m_mesh->triangles().begin;
+    for(int row = row_min; row <= row_max; row++)
+    {
+        for(int col = col_min; col <= col_max; col++)
+        {
+            const size_t c = static_cast<size_t>(row) * m_grid_columns + col;
+            for(uint32_t k = m_cell_start[c]; k < m_cell_start[c + 1]; k++)
+            {
+                const uint32_t ti = m_cell_triangles[k];
+                if(triangle_could_be_in_tile(triangles[ti], bounds))
+                {
+                    triangle_indices.push_back(ti);
+                }
+            }
+        }
+    }
+
+    // triangles spanning several cells were collected more than once
+    std::sort(triangle_indices.begin(), triangle_indices.end());
+    triangle_indices.erase(std::unique(triangle_indices.begin(), triangle_indices.end()),
+                           triangle_indices.end());
+}
+
+// Cuts the triangles of a tile out of the mesh and scales them to the unit square,
+// returns false if the tile is empty
+bool TileMaker::make_tile_mesh(int tx, int ty, int zoom, Mesh& tileMesh, BBox3D& tileSpaceBbox) const
 {
     MercatorProjection projection;
 
@@ -55,15 +207,14 @@ bool TileMaker::dumpTile(int tx, int ty, int zoom, const char* filename, MeshWri
 
     // Find all triangles within the tile bounds
     std::vector<Triangle> trianglesInTile;
-    m_mesh->generate_triangles();
     const auto triangles_range = m_mesh->triangles();
 
-    for(const Triangle* tp = triangles_range.begin; tp != triangles_range.end; tp++)
+    std::vector<uint32_t> candidates;
+    find_triangles(tileBoundsWithBuffer, candidates);
+
+    for(const uint32_t ti : candidates)
     {
-        if(triangle_could_be_in_tile(*tp, tileBoundsWithBuffer))
-        {
-            trianglesInTile.push_back(*tp);
-        }
+        trianglesInTile.push_back(triangles_range.begin[ti]);
     }
 
     TNTN_LOG_DEBUG("before clipping: {} triangles in tile", trianglesInTile.size());
@@ -71,8 +222,7 @@ bool TileMaker::dumpTile(int tx, int ty, int zoom, const char* filename, MeshWri
     // Convert to 0-1 scale (upper right quadrant)
     const glm::dvec2 tileOrigin = {tileBounds.min.x, tileBounds.min.y};
 
-    BBox3D tileSpaceBbox;
-
+    tileSpaceBbox = BBox3D();
     tileSpaceBbox.min.x = tileBounds.min.x;
     tileSpaceBbox.min.y = tileBounds.min.y;
     tileSpaceBbox.max.x = tileBounds.max.x;
@@ -112,15 +262,44 @@ bool TileMaker::dumpTile(int tx, int ty, int zoom, const char* filename, MeshWri
 
     if(trianglesInTile.size() == 0)
     {
-        //ignore empty meshes
-        return true;
+        return false;
     }
 
-    Mesh tileMesh;
     tileMesh.from_triangles(std::move(trianglesInTile));
     tileMesh.generate_decomposed();
+    return true;
+}
+
+// Dump a tile into an terrain tile in format determined by a MeshWriter
+bool TileMaker::dumpTile(int tx, int ty, int zoom, const char* filename, MeshWriter& mesh_writer)
+{
+    Mesh tileMesh;
+    BBox3D tileSpaceBbox;
+    if(!make_tile_mesh(tx, ty, zoom, tileMesh, tileSpaceBbox))
+    {
+        //ignore empty meshes
+        return true;
+    }
 
     return mesh_writer.write_mesh_to_file(filename, tileMesh, tileSpaceBbox);
 }
 
+bool TileMaker::dumpTile(int tx, int ty, int zoom, TileSink& sink, MeshWriter& mesh_writer)
+{
+    Mesh tileMesh;
+    BBox3D tileSpaceBbox;
+    if(!make_tile_mesh(tx, ty, zoom, tileMesh, tileSpaceBbox))
+    {
+        //ignore empty meshes
+        return true;
+    }
+
+    if(!mesh_writer.encode_mesh(tileMesh, tileSpaceBbox, m_tile_buffer))
+    {
+        return false;
+    }
+
+    return sink.write_tile(zoom, tx, ty, m_tile_buffer.data(), m_tile_buffer.size());
+}
+
 } //namespace tntn
@@ -0,0 +1,446 @@
+#include "tntn/TileStore.h"
+#include "tntn/endianness.h"
+#include "tntn/logging.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <tuple>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace tntn {
+
+static const char ARCHIVE_MAGIC[8] = {'T', 'N', 'T', 'N', 'T', 'I', 'L', 'E'};
+static const char ARCHIVE_INDEX_MAGIC[8] = {'T', 'N', 'T', 'N', 'I', 'N', 'D', 'X'};
+static constexpr uint32_t ARCHIVE_VERSION = 1;
+static constexpr size_t ARCHIVE_HEADER_SIZE = 8 + 4;
+static constexpr size_t ARCHIVE_INDEX_ENTRY_SIZE = 4 + 4 + 4 + 8 + 4;
+static constexpr size_t ARCHIVE_FOOTER_SIZE = 8 + 8 + 8;
+
+DirectoryTileSink::DirectoryTileSink(const std::string& basedir, const std::string& extension) :
+    m_basedir(basedir),
+    m_extension(extension)
+{
+}
+
+bool DirectoryTileSink::write_tile(
+    int zoom, int tx, int ty, const unsigned char* data, size_t size)
+{
+    const auto tile_dir = fs::path(m_basedir) / std::to_string(zoom) / std::to_string(tx);
+
+    // several threads may race to create the same directory
+    boost::system::error_code ec;
+    fs::create_directories(tile_dir, ec);
+    if(ec && !fs::is_directory(tile_dir))
+    {
+        TNTN_LOG_ERROR("unable to create directory {}: {}", tile_dir.string(), ec.message());
+        return false;
+    }
+
+    const auto file_path = tile_dir / (std::to_string(ty) + "." + m_extension);
+
+    File f;
+    if(!f.open(file_path.c_str(), File::OM_RWCF) || !f.write(0, data, size))
+    {
+        TNTN_LOG_ERROR("unable to write tile {}", file_path.string());
+        return false;
+    }
+    return f.close();
+}
+
+ArchiveTileSink::ArchiveTileSink(size_t batch_size) : m_batch_size(batch_size) {}
+
+// a sink destroyed without finish() is on an error path, the archive is left without
+// index and magic so readers reject it instead of taking a partial tile set as complete
+ArchiveTileSink::~ArchiveTileSink()
+{
+    if(m_is_open)
+    {
+        TNTN_LOG_WARN("tile archive {} was not finished and is incomplete", m_file.name());
+        m_file.close();
+    }
+}
+
+bool ArchiveTileSink::open(const std::string& filename)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(!m_file.open(filename, File::OM_RWCF))
+    {
+        TNTN_LOG_ERROR("unable to create tile archive {}", filename);
+        return false;
+    }
+
+    // the magic is written by finish()
+    unsigned char header[ARCHIVE_HEADER_SIZE] = {};
+    store_little_endian(ARCHIVE_VERSION, header + 8);
+    if(!m_file.write(0, header, sizeof(header)))
+    {
+        TNTN_LOG_ERROR("unable to write tile archive header to {}", filename);
+        return false;
+    }
+
+    m_is_open = true;
+    m_batch.clear();
+    m_batch_offset = ARCHIVE_HEADER_SIZE;
+    m_index.clear();
+    return true;
+}
+
+bool ArchiveTileSink::write_tile(
+    int zoom, int tx, int ty, const unsigned char* data, size_t size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(!m_is_open)
+    {
+        TNTN_LOG_ERROR("tile archive is not open");
+        return false;
+    }
+
+    if(size > std::numeric_limits<uint32_t>::max())
+    {
+        TNTN_LOG_ERROR("tile z:{} x:{} y:{} is too large for a tile archive", zoom, tx, ty);
+        return false;
+    }
+
+    IndexEntry e;
+    e.zoom = zoom;
+    e.tx = tx;
+    e.ty = ty;
+    e.offset = m_batch_offset + m_batch.size();
+    e.size = static_cast<uint32_t>(size);
+    m_index.push_back(e);
+
+    m_batch.insert(m_batch.end(), data, data + size);
+
+    if(m_batch.size() >= m_batch_size)
+    {
+        return flush_batch();
+    }
+    return true;
+}
+
+// appends the collected tiles with a single write
+bool ArchiveTileSink::flush_batch()
+{
+    if(m_batch.empty())
+    {
+        return true;
+    }
+
+    if(!m_file.write(m_batch_offset, m_batch.data(), m_batch.size()))
+    {
+        TNTN_LOG_ERROR("unable to append {} bytes of tiles to {}", m_batch.size(), m_file.name());
+        return false;
+    }
+
+    m_batch_offset += m_batch.size();
+    m_batch.clear();
+    return true;
+}
+
+bool ArchiveTileSink::finish()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(!m_is_open)
+    {
+        return false;
+    }
+    m_is_open = false;
+
+    if(!flush_batch())
+    {
+        m_file.close();
+        return false;
+    }
+
+    // a tile written twice keeps its last version
+    std::stable_sort(
+        m_index.begin(), m_index.end(), [](const IndexEntry& a, const IndexEntry& b) {
+            return std::tie(a.zoom, a.tx, a.ty) < std::tie(b.zoom, b.tx, b.ty);
+        });
+    std::vector<IndexEntry> unique_index;
+    unique_index.reserve(m_index.size());
+    for(const auto& e : m_index)
+    {
+        if(!unique_index.empty() && unique_index.back().zoom == e.zoom &&
+           unique_index.back().tx == e.tx && unique_index.back().ty == e.ty)
+        {
+            unique_index.back() = e;
+        }
+        else
+        {
+            unique_index.push_back(e);
+        }
+    }
+
+    std::vector<unsigned char> index(unique_index.size() * ARCHIVE_INDEX_ENTRY_SIZE +
+                                     ARCHIVE_FOOTER_SIZE);
+    unsigned char* p = index.data();
+    for(const auto& e : unique_index)
+    {
+        store_little_endian(e.zoom, p);
+        store_little_endian(e.tx, p + 4);
+        store_little_endian(e.ty, p + 8);
+        store_little_endian(e.offset, p + 12);
+        store_little_endian(e.size, p + 20);
+        p += ARCHIVE_INDEX_ENTRY_SIZE;
+    }
+    store_little_endian(m_batch_offset, p);
+    store_little_endian(static_cast<uint64_t>(unique_index.size()), p + 8);
+    std::memcpy(p + 16, ARCHIVE_INDEX_MAGIC, 8);
+
+    const bool ok = m_file.write(m_batch_offset, index.data(), index.size()) &&
+        m_file.write(0, ARCHIVE_MAGIC, 8);
+    if(!ok)
+    {
+        TNTN_LOG_ERROR("unable to write tile archive index to {}", m_file.name());
+    }
+
+    TNTN_LOG_INFO("wrote {} tiles to archive {}", unique_index.size(), m_file.name());
+    m_index.clear();
+    m_index.shrink_to_fit();
+    return m_file.close() && ok;
+}
+
+AsyncTileSink::AsyncTileSink(std::unique_ptr<TileSink> target,
+                             int num_writers,
+                             size_t max_queued_bytes) :
+    m_target(std::move(target)),
+    m_max_queued_bytes(max_queued_bytes)
+{
+    num_writers = std::max(1, num_writers);
+    m_writers.reserve(num_writers);
+    for(int i = 0; i < num_writers; i++)
+    {
+        m_writers.emplace_back(&AsyncTileSink::write_queued_tiles, this);
+    }
+}
+
+// without finish() the run was aborted, the target isn't finished either
+AsyncTileSink::~AsyncTileSink()
+{
+    if(!m_writers.empty())
+    {
+        stop_writers();
+    }
+}
+
+bool AsyncTileSink::write_tile(int zoom, int tx, int ty, const unsigned char* data, size_t size)
+{
+    QueuedTile tile;
+    tile.zoom = zoom;
+    tile.tx = tx;
+    tile.ty = ty;
+    tile.data.assign(data, data + size);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // a tile larger than the whole queue is accepted once the queue is empty
+    m_tile_taken.wait(lock, [&]() {
+        return m_failed || m_stopping || m_queue.empty() ||
+            m_queued_bytes + size <= m_max_queued_bytes;
+    });
+
+    if(m_failed || m_stopping)
+    {
+        return false;
+    }
+
+    m_queued_bytes += size;
+    m_queue.push_back(std::move(tile));
+    lock.unlock();
+
+    m_tile_queued.notify_one();
+    return true;
+}
+
+void AsyncTileSink::write_queued_tiles()
+{
+    while(true)
+    {
+        QueuedTile tile;
+        bool failed = false;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_tile_queued.wait(lock, [&]() { return m_stopping || !m_queue.empty(); });
+            if(m_queue.empty())
+            {
+                return;
+            }
+            tile = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_queued_bytes -= tile.data.size();
+            failed = m_failed;
+        }
+        m_tile_taken.notify_all();
+
+        // the output is incomplete anyway, just drain the queue
+        if(failed)
+        {
+            continue;
+        }
+
+        if(!m_target->write_tile(tile.zoom, tile.tx, tile.ty, tile.data.data(), tile.data.size()))
+        {
+            TNTN_LOG_ERROR("unable to write tile z:{} x:{} y:{}", tile.zoom, tile.tx, tile.ty);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_failed = true;
+            m_tile_taken.notify_all();
+        }
+    }
+}
+
+// lets the writers drain the queue and waits for them
+bool AsyncTileSink::stop_writers()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_tile_queued.notify_all();
+    m_tile_taken.notify_all();
+
+    for(auto& t : m_writers)
+    {
+        t.join();
+    }
+    m_writers.clear();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_failed;
+}
+
+bool AsyncTileSink::finish()
+{
+    if(m_writers.empty())
+    {
+        return false;
+    }
+
+    const bool ok = stop_writers();
+    return m_target->finish() && ok;
+}
+
+bool TileArchive::open(const std::string& filename)
+{
+    m_index = nullptr;
+    m_tile_count = 0;
+
+    if(!m_file.open(filename))
+    {
+        return false;
+    }
+
+    const unsigned char* data = m_file.data();
+    const size_t size = m_file.size();
+
+    if(size < ARCHIVE_HEADER_SIZE + ARCHIVE_FOOTER_SIZE ||
+       std::memcmp(data, ARCHIVE_MAGIC, 8) != 0 ||
+       std::memcmp(data + size - 8, ARCHIVE_INDEX_MAGIC, 8) != 0)
+    {
+        TNTN_LOG_ERROR("{} is not a complete tile archive", filename);
+        m_file.close();
+        return false;
+    }
+
+    const uint32_t version = load_little_endian<uint32_t>(data + 8);
+    if(version != ARCHIVE_VERSION)
+    {
+        TNTN_LOG_ERROR("unsupported tile archive version {} in {}", version, filename);
+        m_file.close();
+        return false;
+    }
+
+    const unsigned char* footer = data + size - ARCHIVE_FOOTER_SIZE;
+    const uint64_t index_offset = load_little_endian<uint64_t>(footer);
+    const uint64_t tile_count = load_little_endian<uint64_t>(footer + 8);
+
+    // compared without adding or multiplying so crafted values can't wrap around
+    const uint64_t index_end = size - ARCHIVE_FOOTER_SIZE;
+    if(index_offset < ARCHIVE_HEADER_SIZE || index_offset > index_end ||
+       (index_end - index_offset) % ARCHIVE_INDEX_ENTRY_SIZE != 0 ||
+       tile_count != (index_end - index_offset) / ARCHIVE_INDEX_ENTRY_SIZE)
+    {
+        TNTN_LOG_ERROR("corrupt index in tile archive {}", filename);
+        m_file.close();
+        return false;
+    }
+
+    m_index = data + index_offset;
+    m_tile_count = static_cast<size_t>(tile_count);
+
+    for(size_t i = 0; i < m_tile_count; i++)
+    {
+        const auto e = entry(i);
+        if(e.offset < ARCHIVE_HEADER_SIZE || e.offset > index_offset ||
+           e.size > index_offset - e.offset)
+        {
+            TNTN_LOG_ERROR("tile {} in archive {} points outside of the tile data", i, filename);
+            m_index = nullptr;
+            m_tile_count = 0;
+            m_file.close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+ArchiveTileSink::IndexEntry TileArchive::entry(const size_t i) const
+{
+    const unsigned char* p = m_index + i * ARCHIVE_INDEX_ENTRY_SIZE;
+    ArchiveTileSink::IndexEntry e;
+    e.zoom = load_little_endian<uint32_t>(p);
+    e.tx = load_little_endian<uint32_t>(p + 4);
+    e.ty = load_little_endian<uint32_t>(p + 8);
+    e.offset = load_little_endian<uint64_t>(p + 12);
+    e.size = load_little_endian<uint32_t>(p + 20);
+    return e;
+}
+
+bool TileArchive::find_tile(
+    int zoom, int tx, int ty, const unsigned char*& data, size_t& size) const
+{
+    const auto key = std::make_tuple(static_cast<uint32_t>(zoom),
+                                     static_cast<uint32_t>(tx),
+                                     static_cast<uint32_t>(ty));
+
+    // binary search on the sorted index
+    size_t lo = 0;
+    size_t hi = m_tile_count;
+    while(lo < hi)
+    {
+        const size_t mid = lo + (hi - lo) / 2;
+        const auto e = entry(mid);
+        if(std::tie(e.zoom, e.tx, e.ty) < key)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    if(lo == m_tile_count)
+    {
+        return false;
+    }
+
+    const auto e = entry(lo);
+    if(std::tie(e.zoom, e.tx, e.ty) != key)
+    {
+        return false;
+    }
+
+    data = m_file.data() + e.offset;
+    size = e.size;
+    return true;
+}
+
+} // namespace tntn
@@ -8,8 +8,8 @@
 #include <iostream>
 #include <fstream>
 #include <array>
-#include <unordered_map>
 #include <cmath>
+#include <limits>
 
 namespace tntn {
 namespace zemlya {
@@ -40,10 +40,12 @@ static double average_of(
     }
 }
 
-void ZemlyaMesh::greedy_insert(double max_error)
+template<typename T>
+void ZemlyaMesh<T>::greedy_insert(double max_error)
 {
     m_max_error = max_error;
     m_counter = 0;
+    m_skipped_scans = 0;
     int w = m_raster->get_width();
     int h = m_raster->get_height();
     m_max_level = static_cast<int>(ceil(log2(w > h ? w : h)));
@@ -227,12 +229,21 @@ void ZemlyaMesh::greedy_insert(double max_error)
             }
         }
 
+        if(level == m_max_level)
+        {
+            m_bounds.build(*m_raster, no_data_value);
+        }
+        else
+        {
+            m_bounds.build(m_insert, no_data_value);
+        }
+
         // Scan all the triangles and push all candidates into a stack
         dt_ptr t = m_first_face;
         while(t)
         {
             scan_triangle(t);
-            t = t->getLink();
+            t = this->next_face(t);
         }
 
         // Iterate until the error threshold is met
@@ -243,7 +254,11 @@ void ZemlyaMesh::greedy_insert(double max_error)
             if(candidate.importance < m_max_error) continue;
 
             // Skip if the candidate is not the latest
-            if(m_token.value(candidate.y, candidate.x) != candidate.token) continue;
+            if(m_token.value(candidate.y, candidate.x) != candidate.token)
+            {
+                m_candidates.count_stale_pop();
+                continue;
+            }
 
             m_result.value(candidate.y, candidate.x) = candidate.z;
             m_used.value(candidate.y, candidate.x) = 1;
@@ -253,52 +268,66 @@ void ZemlyaMesh::greedy_insert(double max_error)
         }
     }
 
+    const auto& stats = m_candidates.stats();
+    TNTN_LOG_DEBUG("candidates: {} pushed, {} replaced in place, {} popped, {} stale, peak heap size {}",
+                   stats.pushed,
+                   stats.replaced,
+                   stats.popped,
+                   stats.stale_popped,
+                   stats.peak_size);
+    TNTN_LOG_DEBUG("{} triangle scans skipped by the min/max pyramid", m_skipped_scans);
+    const auto edges = this->edge_stats();
+    TNTN_LOG_DEBUG("edges: {} live, {} recycled for reuse, peak {} live, {} allocated",
+                   edges.live,
+                   edges.free,
+                   edges.peak_live,
+                   edges.capacity);
+
     TNTN_LOG_INFO("finished greedy insertion");
 }
 
-void ZemlyaMesh::scan_triangle_line(const Plane& plane,
-                                    int y,
-                                    double x1,
-                                    double x2,
-                                    Candidate& candidate,
-                                    const double no_data_value)
+template<typename T>
+void ZemlyaMesh<T>::scan_triangle_line(const Plane& plane,
+                                       int y,
+                                       double x1,
+                                       double x2,
+                                       Candidate& candidate,
+                                       const double no_data_value)
 {
     const int startx = static_cast<int>(ceil(fmin(x1, x2)));
     const int endx = static_cast<int>(floor(fmax(x1, x2)));
 
     if(startx > endx) return;
 
-    double z0 = plane.eval(startx, y);
-    const double dz = plane.a;
+    //attention - use m_raster/m_insert depending on level
+    terra::LineMaximum m;
+    if(m_current_level == m_max_level)
+    {
+        m = terra::scan_line_maximum(
+            m_raster->get_ptr(y), m_used.get_ptr(y), startx, endx, y, plane, no_data_value);
+    }
+    else
+    {
+        m = terra::scan_line_maximum(
+            m_insert.get_ptr(y), m_used.get_ptr(y), startx, endx, y, plane, no_data_value);
+    }
 
-    for(int x = startx; x <= endx; x++)
+    if(m.x >= 0)
     {
-        if(!m_used.value(y, x))
-        {
-            //attention - use m_raster/m_insert depending on level
-            const double z =
-                m_current_level == m_max_level ? m_raster->value(y, x) : m_insert.value(y, x);
-            if(!terra::is_no_data(z, no_data_value))
-            {
-                const double diff = fabs(z - z0);
-                //TNTN_LOG_DEBUG("candidate consider: ({}, {}, {}), diff: {}", x, y, z, diff);
-                candidate.consider(x, y, z, diff);
-            }
-        }
-        z0 += dz;
+        const double z =
+            m_current_level == m_max_level ? m_raster->value(y, m.x) : m_insert.value(y, m.x);
+        candidate.consider(m.x, y, z, m.deviation);
     }
 }
 
-void ZemlyaMesh::scan_triangle(dt_ptr t)
+template<typename T>
+void ZemlyaMesh<T>::scan_triangle(dt_ptr t)
 {
+    std::array<Point2D, 3> by_y = this->triangle_points(t);
+
     Plane z_plane;
-    terra::compute_plane(z_plane, t, m_result);
+    terra::compute_plane(z_plane, by_y, m_result);
 
-    std::array<Point2D, 3> by_y = {{
-        t->point1(),
-        t->point2(),
-        t->point3(),
-    }};
     terra::order_triangle_points(by_y);
     const double v0_x = by_y[0].x;
     const double v0_y = by_y[0].y;
@@ -307,6 +336,20 @@ void ZemlyaMesh::scan_triangle(dt_ptr t)
     const double v2_x = by_y[2].x;
     const double v2_y = by_y[2].y;
 
+    // no pixel scan when the block bounds already prove the triangle to be within max_error
+    const int min_x = static_cast<int>(std::min(std::min(v0_x, v1_x), v2_x));
+    const int max_x = static_cast<int>(std::max(std::max(v0_x, v1_x), v2_x));
+    // the same truncated row bounds the scanlines below start and end on
+    const int first_y = static_cast<int>(v0_y);
+    const int middle_y = static_cast<int>(v1_y);
+    const int last_y = static_cast<int>(v2_y);
+    if(m_bounds.deviation_below(z_plane, min_x, first_y, max_x, last_y, m_max_error))
+    {
+        m_candidates.remove(t);
+        m_skipped_scans++;
+        return;
+    }
+
     terra::Candidate candidate = {0, 0, 0.0, -DBL_MAX, m_counter++, t};
 
     const double dx2 = (v2_x - v0_x) / (v2_y - v0_y);
@@ -319,8 +362,8 @@ void ZemlyaMesh::scan_triangle(dt_ptr t)
         double x1 = v0_x;
         double x2 = v0_x;
 
-        const int starty = v0_y;
-        const int endy = v1_y;
+        const int starty = first_y;
+        const int endy = middle_y;
 
         for(int y = starty; y < endy; y++)
         {
@@ -337,8 +380,8 @@ void ZemlyaMesh::scan_triangle(dt_ptr t)
         double x1 = v1_x;
         double x2 = v0_x;
 
-        const int starty = v1_y;
-        const int endy = v2_y;
+        const int starty = middle_y;
+        const int endy = last_y;
 
         for(int y = starty; y <= endy; y++)
         {
@@ -355,62 +398,47 @@ void ZemlyaMesh::scan_triangle(dt_ptr t)
     m_candidates.push_back(candidate);
 }
 
-std::unique_ptr<Mesh> ZemlyaMesh::convert_to_mesh()
+template<typename T>
+std::unique_ptr<Mesh> ZemlyaMesh<T>::convert_to_mesh()
 {
-    // Find all the vertices
-    int w = m_raster->get_width();
-    int h = m_raster->get_height();
+    std::vector<glm::ivec2> points;
+    std::vector<Face> mfaces;
+    export_indexed(points, mfaces);
 
-    std::vector<Vertex> mvertices;
+    // vertices without data are dropped together with the faces using them
+    const VertexIndex no_vertex = std::numeric_limits<VertexIndex>::max();
+    std::vector<VertexIndex> vertex_id(points.size(), no_vertex);
 
-    Raster<int> vertex_id;
-    vertex_id.allocate(w, h);
-    vertex_id.set_all(0);
+    std::vector<Vertex> mvertices;
+    mvertices.reserve(points.size());
 
-    int index = 0;
     const double no_data_value = m_raster->get_no_data_value();
-    for(int y = 0; y < h; y++)
+    for(size_t i = 0; i < points.size(); i++)
     {
-        for(int x = 0; x < w; x++)
+        const glm::ivec2& p = points[i];
+        const double z = m_result.value(p.y, p.x);
+        if(terra::is_no_data(z, no_data_value))
         {
-            const double z = m_result.value(y, x);
-            if(!terra::is_no_data(z, no_data_value))
-            {
-                Vertex v = Vertex({m_raster->col2x(x), m_raster->row2y(y), z});
-                mvertices.push_back(v);
-                vertex_id.value(y, x) = index;
-                index++;
-            }
+            continue;
         }
+
+        vertex_id[i] = mvertices.size();
+        mvertices.push_back(Vertex({m_raster->col2x(p.x), m_raster->row2y(p.y), z}));
     }
 
-    // Find all the faces
-    std::vector<Face> mfaces;
-    dt_ptr t = m_first_face;
-    while(t)
+    if(mvertices.size() != points.size())
     {
-        Face f;
-
-        glm::dvec2 p1 = t->point1();
-        glm::dvec2 p2 = t->point2();
-        glm::dvec2 p3 = t->point3();
-
-        if(!terra::ccw(p1, p2, p3))
-        {
-            f[0] = vertex_id.value((int)p1.y, (int)p1.x);
-            f[1] = vertex_id.value((int)p2.y, (int)p2.x);
-            f[2] = vertex_id.value((int)p3.y, (int)p3.x);
-        }
-        else
+        size_t nfaces = 0;
+        for(const Face& f : mfaces)
         {
-            f[0] = vertex_id.value((int)p3.y, (int)p3.x);
-            f[1] = vertex_id.value((int)p2.y, (int)p2.x);
-            f[2] = vertex_id.value((int)p1.y, (int)p1.x);
+            const Face g = {{vertex_id[f[0]], vertex_id[f[1]], vertex_id[f[2]]}};
+            if(g[0] != no_vertex && g[1] != no_vertex && g[2] != no_vertex)
+            {
+                mfaces[nfaces++] = g;
+            }
         }
-
-        mfaces.push_back(f);
-
-        t = t->getLink();
+        TNTN_LOG_WARN("dropped {} faces at vertices without data", mfaces.size() - nfaces);
+        mfaces.resize(nfaces);
     }
 
     // now initialise our mesh class with this
@@ -419,5 +447,9 @@ std::unique_ptr<Mesh> ZemlyaMesh::convert_to_mesh()
     return mesh;
 }
 
+template class ZemlyaMesh<double>;
+template class ZemlyaMesh<float>;
+template class ZemlyaMesh<int16_t>;
+
 } //namespace zemlya
 } //namespace tntn
@@ -13,6 +13,7 @@
 #include "tntn/simple_meshing.h"
 #include "tntn/version_info.h"
 #include "tntn/RasterOverviews.h"
+#include "tntn/TileStore.h"
 #include "tntn/println.h"
 
 #include <boost/filesystem.hpp>
@@ -23,6 +24,7 @@
 #include <algorithm>
 #include <chrono>
 #include <string>
+#include <thread>
 
 namespace po = boost::program_options;
 
@@ -50,11 +52,19 @@ static int subcommand_dem2tintiles(bool need_help,
     subdesc.add_options()
         ("input", po::value<std::string>(), "input filename")
         ("output-dir", po::value<std::string>()->default_value("./output"))
+        ("output-archive", po::value<std::string>(), "write all tiles into this single indexed archive file instead of one file per tile in output-dir")
         ("max-zoom", po::value<int>()->default_value(-1), "maximum zoom level to generate tiles for. will guesstimate from resolution if not provided.")
         ("min-zoom", po::value<int>()->default_value(-1), "minimum zoom level to generate tiles for will guesstimate from resolution if not provided.")
         ("max-error", po::value<double>(), "max error parameter when using terra or zemlya method")
         ("step", po::value<int>()->default_value(1), "grid spacing in pixels when using dense method")
         ("output-format", po::value<std::string>()->default_value("terrain"), "output tiles in terrain (quantized mesh) or obj")
+        ("threads", po::value<int>()->default_value(1), "number of partitions to mesh and write in parallel, 0 uses all available cores")
+        ("writer-threads", po::value<int>()->default_value(1), "number of threads writing finished tiles while meshing continues, 0 writes tiles on the meshing threads")
+        ("write-queue", po::value<int>()->default_value(64), "size in MB of encoded tiles waiting for the writer threads before meshing pauses")
+        ("block-cache", po::value<int>()->default_value(512), "size in MB of the cache for blocks read from the input raster")
+        ("precompute-overviews", "compute all downsampled zoom levels in memory before meshing, reads the input raster only once")
+        ("cascade-overviews", "compute every downsampled zoom level in memory from the previous one instead of window by window from the input raster, needs memory for the largest downsampled zoom level")
+        ("progressive", "(terra) mesh the input once and cut that run into the meshes of all zoom levels, the max error doubles with every zoom level above max-zoom")
 #if defined(TNTN_USE_ADDONS) && TNTN_USE_ADDONS
         ("method", po::value<std::string>()->default_value("terra"), "meshing algorithm. one of: terra, zemlya, curvature or dense")
         ("threshold", po::value<double>(), "threshold when using curvature method");
@@ -95,6 +105,34 @@ static int subcommand_dem2tintiles(bool need_help,
         throw po::error("max zoom is less than min zoom");
     }
 
+    int threads = local_varmap["threads"].as<int>();
+    if(threads < 0)
+    {
+        throw po::error("--threads must not be negative");
+    }
+    if(threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    const int writer_threads = local_varmap["writer-threads"].as<int>();
+    if(writer_threads < 0)
+    {
+        throw po::error("--writer-threads must not be negative");
+    }
+
+    const int write_queue_mb = local_varmap["write-queue"].as<int>();
+    if(write_queue_mb < 1)
+    {
+        throw po::error("--write-queue must be at least 1 MB");
+    }
+
+    const int block_cache_mb = local_varmap["block-cache"].as<int>();
+    if(block_cache_mb < 1)
+    {
+        throw po::error("--block-cache must be at least 1 MB");
+    }
+
     if(!local_varmap.count("input"))
     {
         throw po::error("no --input option given");
@@ -140,9 +178,10 @@ static int subcommand_dem2tintiles(bool need_help,
 
     const std::string meshing_method = local_varmap["method"].as<std::string>();
 
-    auto input_raster = std::make_unique<RasterDouble>();
+    std::shared_ptr<const RasterSource> input_raster =
+        open_raster_source(input_file, true, static_cast<size_t>(block_cache_mb) * 1024 * 1024);
 
-    if(!load_raster_file(input_file.c_str(), *input_raster))
+    if(!input_raster)
     {
         return false;
     }
@@ -176,9 +215,76 @@ static int subcommand_dem2tintiles(bool need_help,
         throw po::error(std::string("unknown method ") + meshing_method);
     }
 
-    RasterOverviews overviews(std::move(input_raster), min_zoom, max_zoom);
+    const bool progressive = local_varmap.count("progressive") > 0;
+    if(progressive && meshing_method != "terra")
+    {
+        throw po::error("--progressive only works with the terra method");
+    }
+
+    std::unique_ptr<TileSink> tile_sink;
+    if(local_varmap.count("output-archive"))
+    {
+        auto archive = std::make_unique<ArchiveTileSink>();
+        if(!archive->open(local_varmap["output-archive"].as<std::string>()))
+        {
+            return -2;
+        }
+        tile_sink = std::move(archive);
+    }
+    else
+    {
+        tile_sink = std::make_unique<DirectoryTileSink>(output_basedir, w->file_extension());
+    }
 
-    RasterOverview overview;
+    if(writer_threads > 0)
+    {
+        const size_t write_queue_bytes = static_cast<size_t>(write_queue_mb) * 1024 * 1024;
+        tile_sink =
+            std::make_unique<AsyncTileSink>(std::move(tile_sink), writer_threads, write_queue_bytes);
+    }
+
+    RasterOverviews overviews(input_raster, min_zoom, max_zoom, threads);
+
+    if(progressive)
+    {
+        const int finest_zoom = overviews.get_max_zoom();
+
+        // a given max error is the error of the finest zoom level, coarser levels
+        // double it like the resolution so that they keep fewer vertices
+        const std::vector<double> max_errors = progressive_max_errors(
+            overviews.get_min_zoom(),
+            finest_zoom,
+            max_error_given ? max_error : overviews.get_resolution(finest_zoom));
+
+        if(!create_tiles_progressive(*input_raster,
+                                     overviews.get_min_zoom(),
+                                     finest_zoom,
+                                     max_errors,
+                                     *tile_sink,
+                                     *w,
+                                     threads))
+        {
+            TNTN_LOG_ERROR("error creating progressive tiles");
+            return -2;
+        }
+
+        if(!tile_sink->finish())
+        {
+            TNTN_LOG_ERROR("error finishing tile output");
+            return -2;
+        }
+        return 0;
+    }
+
+    overviews.set_cascade(local_varmap.count("cascade-overviews") > 0);
+
+    if(local_varmap.count("precompute-overviews") && !overviews.precompute())
+    {
+        TNTN_LOG_ERROR("error computing raster overviews");
+        return -2;
+    }
+
+    RasterSourceOverview overview;
 
     while(overviews.next(overview))
     {
@@ -189,8 +295,8 @@ static int subcommand_dem2tintiles(bool need_help,
 
         const int zoom_level = overview.zoom_level;
 
-        int overview_width = overview.raster->get_width();
-        int overview_height = overview.raster->get_height();
+        int overview_width = overview.source->get_width();
+        int overview_height = overview.source->get_height();
 
         if(overview_height < 1 || overview_width < 1)
         {
@@ -204,26 +310,33 @@ static int subcommand_dem2tintiles(bool need_help,
                       overview_width,
                       overview_height);
 
-        const auto& partitions = create_partitions_for_zoom_level(*overview.raster, zoom_level);
+        const auto& partitions = create_partitions_for_zoom_level(*overview.source, zoom_level);
 
         if(partitions.empty())
         {
             continue;
         }
 
-        if(!create_tiles_for_zoom_level(*overview.raster,
+        if(!create_tiles_for_zoom_level(*overview.source,
                                         partitions,
                                         zoom_level,
-                                        output_basedir,
+                                        *tile_sink,
                                         max_error,
                                         meshing_method,
-                                        *w))
+                                        *w,
+                                        threads))
         {
             TNTN_LOG_ERROR("error creating files for zoom level {}", zoom_level);
             return -2;
         }
     }
 
+    if(!tile_sink->finish())
+    {
+        TNTN_LOG_ERROR("error finishing tile output");
+        return -2;
+    }
+
     return 0;
 }
 
@@ -344,39 +457,53 @@ static int subcommand_dem2tin(bool need_help,
 
     const std::string method = local_varmap["method"].as<std::string>();
 
-    auto raster = std::make_unique<RasterDouble>();
+    std::unique_ptr<Mesh> mesh;
+    std::unique_ptr<RasterDouble> raster;
+    std::unique_ptr<RasterSource> raster_source;
 
-    // Import raster file without projection validation
-    if(!load_raster_file(input_file, *raster, false))
+    if(method == "terra" || method == "zemlya")
     {
-        TNTN_LOG_ERROR("Unable to load input file, aborting");
-        return false;
+        // Open raster file without projection validation, terra and zemlya
+        // read it with its native sample type
+        raster_source = open_raster_source(input_file, false);
+        if(!raster_source)
+        {
+            TNTN_LOG_ERROR("Unable to load input file, aborting");
+            return false;
+        }
     }
+    else
+    {
+        raster = std::make_unique<RasterDouble>();
 
-    TNTN_LOG_INFO("done");
+        // Import raster file without projection validation
+        if(!load_raster_file(input_file, *raster, false))
+        {
+            TNTN_LOG_ERROR("Unable to load input file, aborting");
+            return false;
+        }
+    }
 
-    std::unique_ptr<Mesh> mesh;
+    TNTN_LOG_INFO("done");
 
     const auto t_start = std::chrono::high_resolution_clock::now();
 
     if(method == "terra" || method == "zemlya")
     {
-        double max_error = raster->get_cell_size();
+        double max_error = raster_source->get_cell_size();
         if(local_varmap.count("max-error"))
         {
             max_error = local_varmap["max-error"].as<double>();
         }
 
-        if("terra" == method)
-        {
-            TNTN_LOG_INFO("performing terra meshing...");
-            mesh = generate_tin_terra(std::move(raster), max_error);
-        }
-        else if("zemlya" == method)
-        {
-            TNTN_LOG_INFO("performing zemlya meshing...");
-            mesh = generate_tin_zemlya(std::move(raster), max_error);
-        }
+        TNTN_LOG_INFO("performing {} meshing...", method);
+        mesh = generate_tin_from_window(*raster_source,
+                                        0,
+                                        0,
+                                        raster_source->get_width(),
+                                        raster_source->get_height(),
+                                        method,
+                                        max_error);
     }
     else if(method == "dense")
     {
@@ -552,6 +679,70 @@ static int subcommand_benchmark(bool need_help,
     return 0;
 }
 
+static int subcommand_raster_cache(bool need_help,
+                                   const po::variables_map& global_varmap,
+                                   const std::vector<std::string>& unrecognized)
+{
+    po::options_description subdesc("raster-cache options");
+    // clang-format off
+    subdesc.add_options()
+        ("input", po::value<std::string>(), "input raster filename")
+        ("output", po::value<std::string>(), "output raster cache filename")
+        ("block-size", po::value<int>()->default_value(DEFAULT_RASTER_CACHE_BLOCK_SIZE), "width and height of the blocks in pixels")
+    ;
+    // clang-format on
+
+    auto parsed = po::command_line_parser(unrecognized).options(subdesc).run();
+
+    po::variables_map local_varmap;
+    po::store(parsed, local_varmap);
+    po::notify(local_varmap);
+
+    if(need_help)
+    {
+        println("usage:");
+        println("  tin-terrain raster-cache [OPTION]...");
+        println();
+        println("converts a raster into a memory mapped file that the other commands");
+        println("open without parsing, flipping or decoding it, use it as their --input");
+        println();
+        println(subdesc);
+        return 0;
+    }
+
+    if(!local_varmap.count("input"))
+    {
+        throw po::error("no --input option given");
+    }
+    const std::string input_file = local_varmap["input"].as<std::string>();
+
+    if(!local_varmap.count("output"))
+    {
+        throw po::error("no --output option given");
+    }
+    const std::string output_file = local_varmap["output"].as<std::string>();
+
+    const int block_size = local_varmap["block-size"].as<int>();
+    if(block_size < 1)
+    {
+        throw po::error("--block-size must be positive");
+    }
+
+    if(!boost::filesystem::is_regular_file(input_file))
+    {
+        throw std::runtime_error(std::string("input file ") + input_file + " does not exist");
+    }
+
+    if(!create_raster_cache(input_file, output_file, block_size))
+    {
+        TNTN_LOG_ERROR("error creating raster cache");
+        return -1;
+    }
+
+    TNTN_LOG_INFO("done");
+    return 0;
+}
+
 static int subcommand_version(bool need_help,
                               const po::variables_map& global_varmap,
                               const std::vector<std::string>& unrecognized)
@@ -578,6 +769,9 @@ static const subcommand_t subcommands_list[] = {
     {"benchmark",
      subcommand_benchmark,
      "run all available meshing methods on a given set of input files and produce statistics (performance, error rate)"},
+    {"raster-cache",
+     subcommand_raster_cache,
+     "convert a raster into a file all other commands can open without parsing it"},
     {"version", subcommand_version, "print version information"},
 };
 
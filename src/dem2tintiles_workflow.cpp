@@ -7,13 +7,28 @@
 #include "tntn/logging.h"
 
 #include <vector>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <cmath>
 #include <boost/filesystem.hpp>
 
 namespace tntn {
 
 namespace fs = boost::filesystem;
 
+// wraps a raster owned by the caller
+static MemoryRasterSource borrowed_raster_source(const RasterDouble& dem)
+{
+    return MemoryRasterSource(std::shared_ptr<const RasterDouble>(&dem, [](const RasterDouble*) {}));
+}
+
 std::vector<Partition> create_partitions_for_zoom_level(const RasterDouble& dem, int zoom)
+{
+    return create_partitions_for_zoom_level(borrowed_raster_source(dem), zoom);
+}
+
+std::vector<Partition> create_partitions_for_zoom_level(const RasterSource& dem, int zoom)
 {
     MercatorProjection projection;
     std::vector<Partition> partitions;
@@ -63,53 +78,171 @@ std::vector<Partition> create_partitions_for_zoom_level(const RasterDouble& dem,
     return partitions;
 }
 
-bool create_tiles_for_zoom_level(const RasterDouble& dem,
-                                 const std::vector<Partition>& partitions,
-                                 int zoom,
-                                 const std::string& output_basedir,
-                                 const double method_parameter,
-                                 const std::string& meshing_method,
-                                 MeshWriter& mesh_writer)
+template<typename T>
+static std::unique_ptr<Mesh> generate_tin_from_window(const RasterSource& dem,
+                                                      int cx,
+                                                      int cy,
+                                                      int cw,
+                                                      int ch,
+                                                      const std::string& meshing_method,
+                                                      const double max_error)
+{
+    auto raster_tile = std::make_unique<Raster<T>>();
+    if(!dem.crop(cx, cy, cw, ch, *raster_tile))
+    {
+        TNTN_LOG_ERROR("error reading raster for partition");
+        return nullptr;
+    }
+
+    if(meshing_method == "terra")
+    {
+        return generate_tin_terra(std::move(raster_tile), max_error);
+    }
+    return generate_tin_zemlya(std::move(raster_tile), max_error);
+}
+
+std::unique_ptr<Mesh> generate_tin_from_window(const RasterSource& dem,
+                                               int cx,
+                                               int cy,
+                                               int cw,
+                                               int ch,
+                                               const std::string& meshing_method,
+                                               const double max_error)
+{
+    // mesh with the input's native samples to save memory and bandwidth
+    switch(dem.get_sample_type())
+    {
+        case RasterSampleType::Int16:
+            return generate_tin_from_window<int16_t>(
+                dem, cx, cy, cw, ch, meshing_method, max_error);
+        case RasterSampleType::Float32:
+            return generate_tin_from_window<float>(dem, cx, cy, cw, ch, meshing_method, max_error);
+        default:
+            return generate_tin_from_window<double>(
+                dem, cx, cy, cw, ch, meshing_method, max_error);
+    }
+}
+
+template<typename T>
+static std::vector<std::unique_ptr<Mesh>> generate_tins_from_window(
+    const RasterSource& dem,
+    int cx,
+    int cy,
+    int cw,
+    int ch,
+    const std::vector<double>& max_errors)
+{
+    auto raster_tile = std::make_unique<Raster<T>>();
+    if(!dem.crop(cx, cy, cw, ch, *raster_tile))
+    {
+        TNTN_LOG_ERROR("error reading raster for partition");
+        return std::vector<std::unique_ptr<Mesh>>();
+    }
+    return generate_tins_terra(std::move(raster_tile), max_errors);
+}
+
+static std::vector<std::unique_ptr<Mesh>> generate_tins_from_window(
+    const RasterSource& dem,
+    int cx,
+    int cy,
+    int cw,
+    int ch,
+    const std::vector<double>& max_errors)
 {
-    for(const auto& part : partitions)
+    switch(dem.get_sample_type())
     {
-        const auto bbox = part.bbox;
-        TNTN_LOG_DEBUG("current tile bbox (world coordinates) [({},{}),({},{})]",
-                       bbox.min.x,
-                       bbox.min.y,
-                       bbox.max.x,
-                       bbox.max.y);
+        case RasterSampleType::Int16:
+            return generate_tins_from_window<int16_t>(dem, cx, cy, cw, ch, max_errors);
+        case RasterSampleType::Float32:
+            return generate_tins_from_window<float>(dem, cx, cy, cw, ch, max_errors);
+        default:
+            return generate_tins_from_window<double>(dem, cx, cy, cw, ch, max_errors);
+    }
+}
 
-        int x1 = dem.x2col(bbox.min.x);
-        int y1 = dem.y2row(bbox.min.y);
+// raster window covered by a partition's bounding box
+static void partition_window(
+    const RasterSource& dem, const Partition& part, int& x1, int& y1, int& x2, int& y2)
+{
+    const auto bbox = part.bbox;
+    TNTN_LOG_DEBUG("current tile bbox (world coordinates) [({},{}),({},{})]",
+                   bbox.min.x,
+                   bbox.min.y,
+                   bbox.max.x,
+                   bbox.max.y);
 
-        int x2 = dem.x2col(bbox.max.x);
-        int y2 = dem.y2row(bbox.max.y);
+    x1 = dem.x2col(bbox.min.x);
+    y1 = dem.y2row(bbox.min.y);
 
-        TNTN_LOG_DEBUG("current tile raster crop box: [({},{}),({},{})]", x1, y1, x2, y2);
+    x2 = dem.x2col(bbox.max.x);
+    y2 = dem.y2row(bbox.max.y);
 
-        if(x2 < x1)
-        {
-            std::swap(x1, x2);
-        }
+    TNTN_LOG_DEBUG("current tile raster crop box: [({},{}),({},{})]", x1, y1, x2, y2);
 
-        if(y2 < y1)
+    if(x2 < x1)
+    {
+        std::swap(x1, x2);
+    }
+
+    if(y2 < y1)
+    {
+        std::swap(y1, y2);
+    }
+}
+
+static bool dump_tiles(TileMaker& tm,
+                       const glm::ivec2& tmin,
+                       const glm::ivec2& tmax,
+                       int zoom,
+                       TileSink& tile_sink,
+                       MeshWriter& mesh_writer)
+{
+    for(int tx = tmin.x; tx <= tmax.x; tx++)
+    {
+        for(int ty = tmin.y; ty <= tmax.y; ty++)
         {
-            std::swap(y1, y2);
+            TNTN_LOG_INFO("Creating tile: {},{}", tx, ty);
+
+            if(!tm.dumpTile(tx, ty, zoom, tile_sink, mesh_writer))
+            {
+                TNTN_LOG_ERROR("error dumping tile z:{} x:{} y:{}", zoom, tx, ty);
+                return false;
+            }
         }
+    }
+    return true;
+}
 
-        auto raster_tile = std::make_unique<RasterDouble>();
-        dem.crop(x1, y1, x2 - x1, y2 - y1, *raster_tile);
+static bool create_tiles_for_partition(const RasterSource& dem,
+                                       const Partition& part,
+                                       int zoom,
+                                       TileSink& tile_sink,
+                                       const double method_parameter,
+                                       const std::string& meshing_method,
+                                       MeshWriter& mesh_writer)
+{
+    int x1, y1, x2, y2;
+    partition_window(dem, part, x1, y1, x2, y2);
 
-        std::unique_ptr<Mesh> mesh;
+    std::unique_ptr<Mesh> mesh;
 
-        if(meshing_method == "terra")
+    if(meshing_method == "terra" || meshing_method == "zemlya")
+    {
+        mesh = generate_tin_from_window(
+            dem, x1, y1, x2 - x1, y2 - y1, meshing_method, method_parameter);
+    }
+    else
+    {
+        auto raster_tile = std::make_unique<RasterDouble>();
+        if(!dem.crop(x1, y1, x2 - x1, y2 - y1, *raster_tile))
         {
-            mesh = generate_tin_terra(std::move(raster_tile), method_parameter);
+            TNTN_LOG_ERROR("error reading raster for partition");
+            return false;
         }
-        else if(meshing_method == "zemlya")
+
+        if(meshing_method == "dense")
         {
-            mesh = generate_tin_zemlya(std::move(raster_tile), method_parameter);
+            mesh = generate_tin_dense_quadwalk(*raster_tile, (int)method_parameter);
         }
 #if defined(TNTN_USE_ADDONS) && TNTN_USE_ADDONS
         else if(meshing_method == "curvature")
@@ -117,45 +250,234 @@ bool create_tiles_for_zoom_level(const RasterDouble& dem,
             mesh = generate_tin_curvature(*raster_tile, method_parameter);
         }
 #endif
-        else if(meshing_method == "dense")
-        {
-            mesh = generate_tin_dense_quadwalk(*raster_tile, (int)method_parameter);
-        }
         else
         {
             TNTN_LOG_ERROR("Unknown meshing method {}, aborting", meshing_method);
             return false;
         }
+    }
+
+    if(!mesh)
+    {
+        return false;
+    }
+
+    // Cut the TIN into tiles
+    TileMaker tm;
+    tm.loadMesh(std::move(mesh));
+    return dump_tiles(tm, part.tmin, part.tmax, zoom, tile_sink, mesh_writer);
+}
+
+static bool create_progressive_tiles_for_partition(const RasterSource& dem,
+                                                   const Partition& part,
+                                                   int min_zoom,
+                                                   int max_zoom,
+                                                   const std::vector<double>& max_errors,
+                                                   TileSink& tile_sink,
+                                                   MeshWriter& mesh_writer)
+{
+    int x1, y1, x2, y2;
+    partition_window(dem, part, x1, y1, x2, y2);
+
+    auto meshes = generate_tins_from_window(dem, x1, y1, x2 - x1, y2 - y1, max_errors);
+    if(meshes.size() != max_errors.size())
+    {
+        return false;
+    }
+
+    MercatorProjection projection;
+    const auto data_bbox = dem.get_bounding_box();
+
+    for(int zoom = min_zoom; zoom <= max_zoom; zoom++)
+    {
+        std::unique_ptr<Mesh>& mesh = meshes[zoom - min_zoom];
+        if(!mesh)
+        {
+            return false;
+        }
+
+        // tiles below the partition's tiles, without those outside of the raster
+        const int scale = 1 << (zoom - min_zoom);
+        const glm::ivec2 data_tmin =
+            projection.MetersToTileXY({data_bbox.min.x, data_bbox.min.y}, zoom);
+        const glm::ivec2 data_tmax =
+            projection.MetersToTileXY({data_bbox.max.x, data_bbox.max.y}, zoom);
+        const glm::ivec2 tmin(std::max(part.tmin.x * scale, data_tmin.x),
+                              std::max(part.tmin.y * scale, data_tmin.y));
+        const glm::ivec2 tmax(std::min((part.tmax.x + 1) * scale - 1, data_tmax.x),
+                              std::min((part.tmax.y + 1) * scale - 1, data_tmax.y));
+
+        TNTN_LOG_INFO(
+            "Processing zoom level {}, error threshold {}", zoom, max_errors[zoom - min_zoom]);
 
-        // Cut the TIN into tiles
         TileMaker tm;
         tm.loadMesh(std::move(mesh));
+        if(!dump_tiles(tm, tmin, tmax, zoom, tile_sink, mesh_writer))
+        {
+            return false;
+        }
+    }
+    return true;
+}
 
-        fs::create_directory(fs::path(output_basedir));
-        fs::create_directory(fs::path(output_basedir) / std::to_string(zoom));
+bool create_tiles_for_zoom_level(const RasterDouble& dem,
+                                 const std::vector<Partition>& partitions,
+                                 int zoom,
+                                 const std::string& output_basedir,
+                                 const double method_parameter,
+                                 const std::string& meshing_method,
+                                 MeshWriter& mesh_writer,
+                                 int num_threads)
+{
+    return create_tiles_for_zoom_level(borrowed_raster_source(dem),
+                                       partitions,
+                                       zoom,
+                                       output_basedir,
+                                       method_parameter,
+                                       meshing_method,
+                                       mesh_writer,
+                                       num_threads);
+}
 
-        for(int tx = part.tmin.x; tx <= part.tmax.x; tx++)
+bool create_tiles_for_zoom_level(const RasterSource& dem,
+                                 const std::vector<Partition>& partitions,
+                                 int zoom,
+                                 const std::string& output_basedir,
+                                 const double method_parameter,
+                                 const std::string& meshing_method,
+                                 MeshWriter& mesh_writer,
+                                 int num_threads)
+{
+    fs::create_directory(fs::path(output_basedir));
+    fs::create_directory(fs::path(output_basedir) / std::to_string(zoom));
+
+    // files are written on a separate thread while the next tiles are meshed
+    AsyncTileSink tile_sink(
+        std::make_unique<DirectoryTileSink>(output_basedir, mesh_writer.file_extension()));
+    const bool ok = create_tiles_for_zoom_level(dem,
+                                                partitions,
+                                                zoom,
+                                                tile_sink,
+                                                method_parameter,
+                                                meshing_method,
+                                                mesh_writer,
+                                                num_threads);
+    return tile_sink.finish() && ok;
+}
+
+// calls process for every partition, on num_threads threads if there is more than one
+template<typename F>
+static bool for_each_partition(const std::vector<Partition>& partitions,
+                               int num_threads,
+                               F process)
+{
+    if(num_threads <= 1 || partitions.size() <= 1)
+    {
+        for(const auto& part : partitions)
         {
-            for(int ty = part.tmin.y; ty <= part.tmax.y; ty++)
+            if(!process(part))
             {
-                TNTN_LOG_INFO("Creating tile: {},{}", tx, ty);
+                return false;
+            }
+        }
+        return true;
+    }
 
-                auto tile_dir =
-                    fs::path(output_basedir) / std::to_string(zoom) / std::to_string(tx);
-                fs::create_directory(tile_dir);
+    // Partitions cover disjoint tile ranges, so they can be meshed and written
+    // independently. Every worker holds at most one partition at a time, which
+    // keeps memory use bounded by the number of threads.
+    const size_t worker_count = std::min(static_cast<size_t>(num_threads), partitions.size());
+    TNTN_LOG_DEBUG("processing {} partitions with {} threads", partitions.size(), worker_count);
 
-                auto file_path =
-                    tile_dir / (std::to_string(ty) + "." + mesh_writer.file_extension());
+    std::atomic<size_t> next_partition(0);
+    std::atomic<bool> failed(false);
 
-                if(!tm.dumpTile(tx, ty, zoom, file_path.c_str(), mesh_writer))
+    auto worker = [&]() {
+        while(!failed)
+        {
+            const size_t i = next_partition++;
+            if(i >= partitions.size())
+            {
+                break;
+            }
+
+            try
+            {
+                if(!process(partitions[i]))
                 {
-                    TNTN_LOG_ERROR("error dumping tile z:{} x:{} y:{}", zoom, tx, ty);
-                    return false;
+                    failed = true;
                 }
             }
+            catch(const std::exception& e)
+            {
+                TNTN_LOG_ERROR("exception while processing partition {}: {}", i, e.what());
+                failed = true;
+            }
         }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(worker_count);
+    for(size_t i = 0; i < worker_count; i++)
+    {
+        workers.emplace_back(worker);
     }
-    return true;
+    for(auto& t : workers)
+    {
+        t.join();
+    }
+
+    return !failed;
+}
+
+bool create_tiles_for_zoom_level(const RasterSource& dem,
+                                 const std::vector<Partition>& partitions,
+                                 int zoom,
+                                 TileSink& tile_sink,
+                                 const double method_parameter,
+                                 const std::string& meshing_method,
+                                 MeshWriter& mesh_writer,
+                                 int num_threads)
+{
+    return for_each_partition(partitions, num_threads, [&](const Partition& part) {
+        return create_tiles_for_partition(
+            dem, part, zoom, tile_sink, method_parameter, meshing_method, mesh_writer);
+    });
+}
+
+std::vector<double> progressive_max_errors(const int min_zoom,
+                                           const int max_zoom,
+                                           const double finest_error)
+{
+    std::vector<double> max_errors;
+    for(int zoom = min_zoom; zoom <= max_zoom; zoom++)
+    {
+        max_errors.push_back(std::ldexp(finest_error, max_zoom - zoom));
+    }
+    return max_errors;
+}
+
+bool create_tiles_progressive(const RasterSource& dem,
+                              int min_zoom,
+                              int max_zoom,
+                              const std::vector<double>& max_errors,
+                              TileSink& tile_sink,
+                              MeshWriter& mesh_writer,
+                              int num_threads)
+{
+    if(max_zoom < min_zoom || max_errors.size() != static_cast<size_t>(max_zoom - min_zoom + 1))
+    {
+        TNTN_LOG_ERROR("need one error threshold for each zoom level from {} to {}",
+                       min_zoom,
+                       max_zoom);
+        return false;
+    }
+
+    const auto partitions = create_partitions_for_zoom_level(dem, min_zoom);
+    return for_each_partition(partitions, num_threads, [&](const Partition& part) {
+        return create_progressive_tiles_for_partition(
+            dem, part, min_zoom, max_zoom, max_errors, tile_sink, mesh_writer);
+    });
 }
 
 } //namespace tntn
@@ -1,18 +1,27 @@
 #include "tntn/raster_tools.h"
+#include "tntn/util.h"
 #include <vector>
 #include <algorithm>
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
 
 namespace tntn {
+
+// output rows a separable filter computes at once per thread
+static constexpr int FILTER_BAND_ROWS = 32;
+
 /** downsample image by an integer factor
-     takes the mean of all pixels in a window_size by window_size sub window
+     takes the mean of all valid pixels in a window_size by window_size sub window
      @param src - source raster image
      @param window_size - factor to downsample by (will truncate output size to nearest integer)
+     @param num_threads - output rows are split across this many threads
      @return downsampled raster image
     */
-RasterDouble raster_tools::integer_downsample_mean(const RasterDouble& src, int win)
+RasterDouble raster_tools::integer_downsample_mean(const RasterDouble& src,
+                                                   int win,
+                                                   int num_threads)
 {
     int w = src.get_width();
     int h = src.get_height();
@@ -26,42 +35,119 @@ RasterDouble raster_tools::integer_downsample_mean(const RasterDouble& src, int
 
     dst.copy_parameters(src);
     dst.set_cell_size(src.get_cell_size() * win);
-    dst.set_all(ndv);
 
-    for(int rs = 0; rs < hs; rs++)
+    // every thread sums whole output rows, win source rows at a time
+    for_each_row_range(hs, num_threads, [&](int begin, int end) {
+        std::vector<double> sum(ws);
+        std::vector<uint32_t> count(ws);
+        for(int rs = begin; rs < end; rs++)
+        {
+            sum_windows(src.get_ptr(rs * win),
+                        src.get_stride(),
+                        ws,
+                        win,
+                        ndv,
+                        sum.data(),
+                        count.data());
+
+            double* out = dst.get_ptr(rs);
+            for(int cs = 0; cs < ws; cs++)
+            {
+                out[cs] = window_mean(sum[cs], count[cs], ndv);
+            }
+        }
+        return true;
+    });
+
+    return dst;
+}
+
+// adds ROWS consecutive rows of pixels of each window to the window's sum and count
+template<int ROWS>
+static void add_window_rows(const double* p,
+                            const size_t row_stride,
+                            const int columns,
+                            const int win,
+                            const double ndv,
+                            double* sum,
+                            uint32_t* count)
+{
+    for(int c = 0; c < columns; c++, p += win)
     {
-        for(int cs = 0; cs < ws; cs++)
+        double s = sum[c];
+        uint32_t n = count[c];
+        for(int i = 0; i < ROWS; i++)
         {
-            int count = 0;
-            double sum = 0;
+            const double* q = p + i * row_stride;
+            for(int j = 0; j < win; j++)
+            {
+                // adding 0 for no-data leaves the sum unchanged and needs no branch
+                const bool valid = q[j] != ndv;
+                s += valid ? q[j] : 0.0;
+                n += valid;
+            }
+        }
+        sum[c] = s;
+        count[c] = n;
+    }
+}
 
-            for(int i = 0; i < win; i++)
+// Pixels are added in row-major order within each window, so both loops below and all
+// callers get bit-identical sums for the same window.
+void raster_tools::sum_windows(const double* rows,
+                               const size_t row_stride,
+                               const int columns,
+                               const int win,
+                               const double ndv,
+                               double* sum,
+                               uint32_t* count)
+{
+    // Small windows, like the 2x2 steps of the overview cascade, are fastest one window
+    // at a time, the window's rows are only a few cache lines apart.
+    if(win < 64)
+    {
+        for(int c = 0; c < columns; c++)
+        {
+            const double* p = rows + static_cast<size_t>(c) * win;
+            double s = 0;
+            uint32_t n = 0;
+            for(int i = 0; i < win; i++, p += row_stride)
             {
                 for(int j = 0; j < win; j++)
                 {
-                    double sv = src.value(rs * win + i, cs * win + j);
-
-                    if(sv != ndv)
+                    if(p[j] != ndv)
                     {
-                        sum += src.value(rs * win + i, cs * win + j);
-                        count++;
+                        s += p[j];
+                        n++;
                     }
                 }
             }
-
-            if(count == 0)
-                dst.value(rs, cs) = ndv;
-            else if(sum > 0)
-                dst.value(rs, cs) = sum / (double)(count);
+            sum[c] = s;
+            count[c] = n;
         }
+        return;
     }
 
-    return dst;
+    // Large windows keep too many distant rows in flight that way, walk them from left
+    // to right in bands of 4 rows instead, each band reads 4 contiguous streams.
+    std::fill(sum, sum + columns, 0.0);
+    std::fill(count, count + columns, 0u);
+
+    int i = 0;
+    for(; i + 4 <= win; i += 4)
+    {
+        add_window_rows<4>(rows + i * row_stride, row_stride, columns, win, ndv, sum, count);
+    }
+    for(; i < win; i++)
+    {
+        add_window_rows<1>(rows + i * row_stride, row_stride, columns, win, ndv, sum, count);
+    }
 }
 
 RasterDouble raster_tools::convolution_filter(const RasterDouble& src,
                                               std::vector<double> kernel,
-                                              int size)
+                                              int size,
+                                              int num_threads)
 {
     RasterDouble dst;
 
@@ -79,38 +165,196 @@ RasterDouble raster_tools::convolution_filter(const RasterDouble& src,
     dst.set_all(dst.get_no_data_value());
 
     double src_ndv = src.get_no_data_value();
-    double* pS = src.get_ptr(0);
     int s2 = size / 2;
 
-    // not optimsed yet!
-    for(int r = s2; r < h - s2; r++)
+    for_each_row_range(h - 2 * s2, num_threads, [&](int begin, int end) {
+        for(int r = begin + s2; r < end + s2; r++)
+        {
+            double* pD = dst.get_ptr(r);
+
+            for(int c = s2; c < w - s2; c++)
+            {
+                double sum = 0;
+
+                for(int i = 0; i < size; i++) // filter rows
+                {
+                    const double* pS = src.get_ptr(r + i - s2) + (c - s2);
+                    const double* pK = kernel.data() + i * size;
+                    for(int j = 0; j < size; j++) // filter colums
+                    {
+                        if(pS[j] != src_ndv)
+                        {
+                            sum += pS[j] * pK[j];
+                        }
+                    }
+                }
+
+                pD[c] = sum;
+            }
+        }
+        return true;
+    });
+
+    return dst;
+}
+
+/** convolution with the kernel column_kernel * row_kernel^T as two 1D passes
+     no-data pixels count as 0 and the border that the kernel doesn't fully cover
+     is no-data, like in the 2D convolution_filter
+    */
+RasterDouble raster_tools::convolution_filter(const RasterDouble& src,
+                                              const std::vector<double>& row_kernel,
+                                              const std::vector<double>& column_kernel,
+                                              int num_threads)
+{
+    RasterDouble dst;
+
+    const int row_size = static_cast<int>(row_kernel.size());
+    const int column_size = static_cast<int>(column_kernel.size());
+    if(row_size % 2 != 1 || column_size % 2 != 1)
     {
-        double* pD = dst.get_ptr(r);
+        TNTN_LOG_ERROR("kernel size must be odd");
+        return dst;
+    }
 
-        for(int c = s2; c < w - s2; c++)
+    int w = src.get_width();
+    int h = src.get_height();
+
+    dst.allocate(w, h);
+    dst.copy_parameters(src);
+    dst.set_all(dst.get_no_data_value());
+
+    const int rs2 = row_size / 2;
+    const int cs2 = column_size / 2;
+    if(w <= 2 * rs2 || h <= 2 * cs2)
+    {
+        return dst;
+    }
+
+    double src_ndv = src.get_no_data_value();
+    const int inner_width = w - 2 * rs2;
+
+    // each thread filters bands of output rows, the horizontal pass of a band
+    // includes the column_size - 1 rows the vertical pass needs above and below
+    for_each_row_range(h - 2 * cs2, num_threads, [&](int begin, int end) {
+        std::vector<double> tmp(static_cast<size_t>(FILTER_BAND_ROWS + 2 * cs2) * inner_width);
+        for(int band = begin; band < end; band += FILTER_BAND_ROWS)
         {
-            pD[c] = 0;
+            const int band_rows = std::min(FILTER_BAND_ROWS, end - band);
 
-            for(int i = 0; i < size; i++) // filter rows
+            for(int r = 0; r < band_rows + 2 * cs2; r++)
             {
-                for(int j = 0; j < size; j++) // filter colums
+                const double* pS = src.get_ptr(band + r);
+                double* pT = tmp.data() + static_cast<size_t>(r) * inner_width;
+                for(int c = 0; c < inner_width; c++)
                 {
-                    if(pS[(r + i - s2) * w + (c + j - s2)] != src_ndv)
+                    double sum = 0;
+                    for(int j = 0; j < row_size; j++)
                     {
-                        pD[c] += pS[(r + i - s2) * w + (c + j - s2)] * kernel[i * size + j];
+                        if(pS[c + j] != src_ndv)
+                        {
+                            sum += pS[c + j] * row_kernel[j];
+                        }
+                    }
+                    pT[c] = sum;
+                }
+            }
+
+            for(int r = 0; r < band_rows; r++)
+            {
+                double* pD = dst.get_ptr(band + r + cs2) + rs2;
+                std::fill(pD, pD + inner_width, 0.0);
+                for(int i = 0; i < column_size; i++)
+                {
+                    const double* pT = tmp.data() + static_cast<size_t>(r + i) * inner_width;
+                    const double k = column_kernel[i];
+                    for(int c = 0; c < inner_width; c++)
+                    {
+                        pD[c] += pT[c] * k;
                     }
                 }
             }
         }
-    }
+        return true;
+    });
 
     return dst;
 }
 
+// Running maximum of all windows of size consecutive values with the van Herk/Gil-Werman
+// algorithm: the sequence is cut into blocks of size values, the window starting at a
+// is max(suffix max of a's block from a, prefix max of the next block up to a + size - 1).
+// Runs on lanes independent sequences at once, value i of lane l is in[i * step + l].
+// out[a * lanes + l] is the window maximum of lane l starting at a for all n - size + 1
+// window starts. NaN and values below -max() are ignored like in the 2D max_filter.
+static void running_max(const double* in,
+                        const size_t step,
+                        const int n,
+                        const int lanes,
+                        const int size,
+                        double* prefix,
+                        double* suffix,
+                        double* out)
+{
+    const double lowest = -std::numeric_limits<double>::max();
+    auto max_of = [](const double a, const double b) { return b > a ? b : a; };
+
+    // for tiny windows the prefix and suffix passes cost more than they save
+    if(size <= 3)
+    {
+        for(int a = 0; a + size <= n; a++)
+        {
+            double* o = out + a * lanes;
+            for(int l = 0; l < lanes; l++)
+            {
+                double m = lowest;
+                for(int k = 0; k < size; k++)
+                {
+                    m = max_of(m, in[(a + k) * step + l]);
+                }
+                o[l] = m;
+            }
+        }
+        return;
+    }
+
+    for(int i = 0; i < n; i++)
+    {
+        const double* v = in + i * step;
+        double* p = prefix + i * lanes;
+        const bool block_start = i % size == 0;
+        for(int l = 0; l < lanes; l++)
+        {
+            p[l] = max_of(block_start ? lowest : p[l - lanes], v[l]);
+        }
+    }
+    for(int i = n - 1; i >= 0; i--)
+    {
+        const double* v = in + i * step;
+        double* s = suffix + i * lanes;
+        const bool block_end = i % size == size - 1 || i == n - 1;
+        for(int l = 0; l < lanes; l++)
+        {
+            s[l] = max_of(block_end ? lowest : s[l + lanes], v[l]);
+        }
+    }
+    for(int a = 0; a + size <= n; a++)
+    {
+        const double* s = suffix + a * lanes;
+        const double* p = prefix + (a + size - 1) * lanes;
+        double* o = out + a * lanes;
+        for(int l = 0; l < lanes; l++)
+        {
+            o[l] = max_of(s[l], p[l]);
+        }
+    }
+}
+
 RasterDouble raster_tools::max_filter(const RasterDouble& src,
                                       int size,
                                       double pos,
-                                      double factor)
+                                      double factor,
+                                      int num_threads)
 {
     RasterDouble dst;
 
@@ -125,54 +369,94 @@ RasterDouble raster_tools::max_filter(const RasterDouble& src,
 
     dst.allocate(w, h);
 
-    double* pS = src.get_ptr(0);
-
     int s2 = size / 2;
 
     dst.set_all(dst.get_no_data_value());
 
-    for(int r = s2; r < h - s2; r++)
+    if(w < size || h < size)
     {
-        double* pD = dst.get_ptr(r);
+        return dst;
+    }
+
+    const int inner_width = w - 2 * s2;
 
-        for(int c = s2; c < w - s2; c++)
+    // each thread filters bands of output rows, the horizontal pass of a band
+    // includes the size - 1 rows the vertical pass needs above and below
+    const int block_columns = 16;
+    for_each_row_range(h - 2 * s2, num_threads, [&](int begin, int end) {
+        const int max_rows = FILTER_BAND_ROWS + 2 * s2;
+        std::vector<double> row_max(static_cast<size_t>(max_rows) * inner_width);
+        std::vector<double> prefix(std::max(w, max_rows * block_columns));
+        std::vector<double> suffix(prefix.size());
+        std::vector<double> window_max(static_cast<size_t>(max_rows) * block_columns);
+
+        for(int band = begin; band < end; band += FILTER_BAND_ROWS)
         {
-            double max = -std::numeric_limits<double>::max();
-            for(int i = 0; i < size; i++) // filter rows
+            const int band_rows = std::min(FILTER_BAND_ROWS, end - band);
+            const int rows = band_rows + 2 * s2;
+
+            for(int r = 0; r < rows; r++)
             {
-                for(int j = 0; j < size; j++) // filter colums
+                running_max(src.get_ptr(band + r),
+                            1,
+                            w,
+                            1,
+                            size,
+                            prefix.data(),
+                            suffix.data(),
+                            row_max.data() + static_cast<size_t>(r) * inner_width);
+            }
+
+            // blocks of adjacent columns, so row_max is read row by row
+            for(int c0 = 0; c0 < inner_width; c0 += block_columns)
+            {
+                const int lanes = std::min(block_columns, inner_width - c0);
+                running_max(row_max.data() + c0,
+                            inner_width,
+                            rows,
+                            lanes,
+                            size,
+                            prefix.data(),
+                            suffix.data(),
+                            window_max.data());
+
+                for(int r = 0; r < band_rows; r++)
                 {
-                    if(pS[(r + i - s2) * w + (c + j - s2)] > max)
+                    const double* pS = src.get_ptr(band + r + s2) + s2 + c0;
+                    const double* pM = window_max.data() + static_cast<size_t>(r) * lanes;
+                    double* pD = dst.get_ptr(band + r + s2) + s2 + c0;
+                    for(int l = 0; l < lanes; l++)
                     {
-                        max = pS[(r + i - s2) * w + (c + j - s2)];
+                        if(pS[l] >= pM[l] * factor)
+                        {
+                            pD[l] = pos;
+                        }
                     }
                 }
             }
-
-            if(pS[r * w + c] >= max * factor)
-            {
-                pD[c] = pos;
-            }
         }
-    }
+        return true;
+    });
 
     return dst;
 }
 
-void raster_tools::flip_data_x(RasterDouble& raster)
+template<typename T>
+void raster_tools::flip_data_x(Raster<T>& raster)
 {
     const int height = raster.get_height();
     const int width = raster.get_width();
 
     for(int row = 0; row < height; row++)
     {
-        double* begin = raster.get_ptr(row);
-        double* end = begin + width;
+        T* begin = raster.get_ptr(row);
+        T* end = begin + width;
         std::reverse(begin, end);
     }
 }
 
-void raster_tools::flip_data_y(RasterDouble& raster)
+template<typename T>
+void raster_tools::flip_data_y(Raster<T>& raster)
 {
     int row = 0;
     const int height = raster.get_height();
@@ -181,15 +465,22 @@ void raster_tools::flip_data_y(RasterDouble& raster)
 
     while(row < half_height)
     {
-        double* a_begin = raster.get_ptr(row);
-        double* a_end = a_begin + width;
-        double* b_begin = raster.get_ptr_ll(row);
+        T* a_begin = raster.get_ptr(row);
+        T* a_end = a_begin + width;
+        T* b_begin = raster.get_ptr_ll(row);
 
         std::swap_ranges(a_begin, a_end, b_begin);
         row++;
     }
 }
 
+template void raster_tools::flip_data_x(RasterDouble&);
+template void raster_tools::flip_data_x(RasterFloat&);
+template void raster_tools::flip_data_x(RasterInt16&);
+template void raster_tools::flip_data_y(RasterDouble&);
+template void raster_tools::flip_data_y(RasterFloat&);
+template void raster_tools::flip_data_y(RasterInt16&);
+
 void raster_tools::find_minmax(const RasterDouble& raster, double& min_val, double& max_val)
 {
     if(raster.empty())
@@ -200,18 +491,21 @@ void raster_tools::find_minmax(const RasterDouble& raster, double& min_val, doub
     double min = raster.value(0, 0);
     double max = raster.value(0, 0);
 
-    const auto pixel_start = raster.get_ptr();
-    const auto pixel_end = pixel_start + raster.get_height() * raster.get_width();
-
-    for(auto pixel = pixel_start; pixel != pixel_end; ++pixel)
+    for(unsigned int r = 0; r < raster.get_height(); r++)
     {
-        if(raster.is_no_data(*pixel))
+        const auto pixel_start = raster.get_ptr(r);
+        const auto pixel_end = pixel_start + raster.get_width();
+
+        for(auto pixel = pixel_start; pixel != pixel_end; ++pixel)
         {
-            continue;
-        }
+            if(raster.is_no_data(*pixel))
+            {
+                continue;
+            }
 
-        min = std::min(*pixel, min);
-        max = std::max(*pixel, max);
+            min = std::min(*pixel, min);
+            max = std::max(*pixel, max);
+        }
     }
 
     min_val = min;
@@ -265,13 +559,15 @@ static inline double average_nan_arr(const std::array<double, Size>& to_average)
     return sum / avg_count;
 }
 
+template<typename T>
 static inline double safe_get_pixel(
-    const RasterDouble& src, const int64_t w, const int64_t h, const int64_t r, const int64_t c)
+    const Raster<T>& src, const int64_t w, const int64_t h, const int64_t r, const int64_t c)
 {
     return r >= 0 && r < h && c >= 0 && c < w ? src.value(r, c) : NAN;
 }
 
-static double subsample_raster_3x3(const RasterDouble& src,
+template<typename T>
+static double subsample_raster_3x3(const Raster<T>& src,
                                    const double no_data_value,
                                    const int64_t w,
                                    const int64_t h,
@@ -340,7 +636,8 @@ static inline double average(const std::array<double, MAX_AVERAGING_SAMPLES>& to
     return avg;
 }
 
-double raster_tools::sample_nearest_valid_avg(const RasterDouble& src,
+template<typename T>
+double raster_tools::sample_nearest_valid_avg(const Raster<T>& src,
                                               const unsigned int _row,
                                               const unsigned int _column,
                                               int min_averaging_samples)
@@ -352,7 +649,7 @@ double raster_tools::sample_nearest_valid_avg(const RasterDouble& src,
     const int64_t w = src.get_width();
     const int64_t h = src.get_height();
     const int64_t max_radius = static_cast<int64_t>(std::sqrt(w * w + h * h));
-    const auto no_data_value = src.get_no_data_value();
+    const double no_data_value = src.get_no_data_value();
 
     double z = 0;
     if(row < h && column < w)
@@ -426,4 +723,17 @@ double raster_tools::sample_nearest_valid_avg(const RasterDouble& src,
     return average(to_average, avg_count);
 }
 
+template double raster_tools::sample_nearest_valid_avg(const RasterDouble&,
+                                                       const unsigned int,
+                                                       const unsigned int,
+                                                       int);
+template double raster_tools::sample_nearest_valid_avg(const RasterFloat&,
+                                                       const unsigned int,
+                                                       const unsigned int,
+                                                       int);
+template double raster_tools::sample_nearest_valid_avg(const RasterInt16&,
+                                                       const unsigned int,
+                                                       const unsigned int,
+                                                       int);
+
 } // namespace tntn
@@ -3,24 +3,67 @@
 #include "tntn/TerraMesh.h"
 #include "tntn/tntn_assert.h"
 
+#include <algorithm>
+
 namespace tntn {
 
-std::unique_ptr<Mesh> generate_tin_terra(std::unique_ptr<RasterDouble> raster, double max_error)
+template<typename T>
+static std::unique_ptr<Mesh> generate_tin_terra_raster(std::unique_ptr<Raster<T>> raster,
+                                                       double max_error)
 {
     TNTN_ASSERT(raster != nullptr);
-    terra::TerraMesh g;
+    if(!terra::repair_corners_exactly(*raster))
+    {
+        // the corner fill is a mean T can't hold, mesh the heights of the double path
+        return generate_tin_terra_raster(terra::to_double_raster(*raster), max_error);
+    }
+
+    terra::TerraMesh<T> g;
     g.load_raster(std::move(raster));
     g.greedy_insert(max_error);
     return g.convert_to_mesh();
 }
 
+template<typename T>
+static std::vector<std::unique_ptr<Mesh>> generate_tins_terra_raster(
+    std::unique_ptr<Raster<T>> raster, const std::vector<double>& max_errors)
+{
+    TNTN_ASSERT(raster != nullptr);
+    TNTN_ASSERT(!max_errors.empty());
+    if(!terra::repair_corners_exactly(*raster))
+    {
+        return generate_tins_terra_raster(terra::to_double_raster(*raster), max_errors);
+    }
+
+    terra::TerraMesh<T> g;
+    g.load_raster(std::move(raster));
+    g.record_insertions(true);
+    g.greedy_insert(*std::min_element(max_errors.begin(), max_errors.end()));
+    return g.convert_to_meshes(max_errors);
+}
+
+std::unique_ptr<Mesh> generate_tin_terra(std::unique_ptr<RasterDouble> raster, double max_error)
+{
+    return generate_tin_terra_raster(std::move(raster), max_error);
+}
+
+std::unique_ptr<Mesh> generate_tin_terra(std::unique_ptr<RasterFloat> raster, double max_error)
+{
+    return generate_tin_terra_raster(std::move(raster), max_error);
+}
+
+std::unique_ptr<Mesh> generate_tin_terra(std::unique_ptr<RasterInt16> raster, double max_error)
+{
+    return generate_tin_terra_raster(std::move(raster), max_error);
+}
+
 std::unique_ptr<Mesh> generate_tin_terra(std::unique_ptr<SurfacePoints> surface_points,
                                          double max_error)
 {
     auto raster = surface_points->to_raster();
     surface_points.reset();
 
-    terra::TerraMesh g;
+    terra::TerraMesh<double> g;
     g.load_raster(std::move(raster));
     g.greedy_insert(max_error);
     return g.convert_to_mesh();
@@ -30,10 +73,28 @@ std::unique_ptr<Mesh> generate_tin_terra(const SurfacePoints& surface_points, do
 {
     auto raster = surface_points.to_raster();
 
-    terra::TerraMesh g;
+    terra::TerraMesh<double> g;
     g.load_raster(std::move(raster));
     g.greedy_insert(max_error);
     return g.convert_to_mesh();
 }
 
+std::vector<std::unique_ptr<Mesh>> generate_tins_terra(std::unique_ptr<RasterDouble> raster,
+                                                       const std::vector<double>& max_errors)
+{
+    return generate_tins_terra_raster(std::move(raster), max_errors);
+}
+
+std::vector<std::unique_ptr<Mesh>> generate_tins_terra(std::unique_ptr<RasterFloat> raster,
+                                                       const std::vector<double>& max_errors)
+{
+    return generate_tins_terra_raster(std::move(raster), max_errors);
+}
+
+std::vector<std::unique_ptr<Mesh>> generate_tins_terra(std::unique_ptr<RasterInt16> raster,
+                                                       const std::vector<double>& max_errors)
+{
+    return generate_tins_terra_raster(std::move(raster), max_errors);
+}
+
 } //namespace tntn
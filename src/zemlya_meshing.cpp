@@ -4,14 +4,37 @@
 
 namespace tntn {
 
-std::unique_ptr<Mesh> generate_tin_zemlya(std::unique_ptr<RasterDouble> raster, double max_error)
+template<typename T>
+static std::unique_ptr<Mesh> generate_tin_zemlya_raster(std::unique_ptr<Raster<T>> raster,
+                                                        double max_error)
 {
-    zemlya::ZemlyaMesh g;
+    if(!terra::repair_corners_exactly(*raster))
+    {
+        // the corner fill is a mean T can't hold, mesh the heights of the double path
+        return generate_tin_zemlya_raster(terra::to_double_raster(*raster), max_error);
+    }
+
+    zemlya::ZemlyaMesh<T> g;
     g.load_raster(std::move(raster));
     g.greedy_insert(max_error);
     return g.convert_to_mesh();
 }
 
+std::unique_ptr<Mesh> generate_tin_zemlya(std::unique_ptr<RasterDouble> raster, double max_error)
+{
+    return generate_tin_zemlya_raster(std::move(raster), max_error);
+}
+
+std::unique_ptr<Mesh> generate_tin_zemlya(std::unique_ptr<RasterFloat> raster, double max_error)
+{
+    return generate_tin_zemlya_raster(std::move(raster), max_error);
+}
+
+std::unique_ptr<Mesh> generate_tin_zemlya(std::unique_ptr<RasterInt16> raster, double max_error)
+{
+    return generate_tin_zemlya_raster(std::move(raster), max_error);
+}
+
 std::unique_ptr<Mesh> generate_tin_zemlya(std::unique_ptr<SurfacePoints> surface_points,
                                           double max_error)
 {
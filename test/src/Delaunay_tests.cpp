@@ -2,6 +2,8 @@
 
 #include <chrono>
 #include <fstream>
+#include <limits>
+#include <random>
 
 #include <boost/filesystem.hpp>
 #include <boost/scope_exit.hpp>
@@ -141,5 +143,93 @@ TEST_CASE("simple delaunay", "[tntn]")
     //std::cout <<"delaunay on " << vlist.size()/1000.0 << "k vertices in " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() / 1000.0 << "seconds" << std::endl;
 }
 
+static std::vector<int> check_duplicates_brute_force(const std::vector<Vertex>& vlist,
+                                                     const double precision)
+{
+    std::vector<int> duplicates;
+    for(size_t i = 0; i < vlist.size(); i++)
+    {
+        for(size_t j = i + 1; j < vlist.size(); j++)
+        {
+            const double dx = vlist[i].x - vlist[j].x;
+            const double dy = vlist[i].y - vlist[j].y;
+            if(dx * dx + dy * dy < precision * precision)
+            {
+                duplicates.push_back(i);
+                break;
+            }
+        }
+    }
+    return duplicates;
+}
+
+TEST_CASE("check_duplicates finds the same points as pairwise comparison", "[tntn]")
+{
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> coord(-50, 50);
+    std::uniform_real_distribution<double> jitter(-0.2, 0.2);
+
+    std::vector<Vertex> vlist;
+    for(int i = 0; i < 3000; i++)
+    {
+        vlist.push_back({coord(gen), coord(gen), 0});
+        if(i % 5 == 0)
+        {
+            // near duplicates of earlier points, some across cell borders
+            const Vertex& v = vlist[gen() % vlist.size()];
+            vlist.push_back({v.x + jitter(gen), v.y + jitter(gen), 1});
+        }
+    }
+
+    const double precision = 0.25;
+    const auto expected = check_duplicates_brute_force(vlist, precision);
+    CHECK(!expected.empty());
+    CHECK(check_duplicates(vlist, precision) == expected);
+    CHECK(check_duplicates(vlist, precision, 4) == expected);
+    CHECK(check_duplicates(vlist, 0).empty());
+}
+
+TEST_CASE("check_duplicates handles huge and non-finite coordinates", "[tntn]")
+{
+    const double inf = std::numeric_limits<double>::infinity();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double huge = std::numeric_limits<double>::max();
+
+    std::vector<Vertex> vlist = {{0, 0, 0},
+                                 {nan, 0, 0},
+                                 {inf, -inf, 0},
+                                 {huge, 1e300, 0},
+                                 {huge, 1e300, 0},
+                                 {-huge, 1e300, 0},
+                                 {0.1, 0, 0},
+                                 {nan, 0, 0},
+                                 {inf, -inf, 0}};
+
+    const auto expected = check_duplicates_brute_force(vlist, 0.25);
+    CHECK(expected == std::vector<int>({0, 3}));
+    CHECK(check_duplicates(vlist, 0.25) == expected);
+    CHECK(check_duplicates(vlist, 1e-300) == check_duplicates_brute_force(vlist, 1e-300));
+}
+
+TEST_CASE("remove_duplicates keeps the order of the remaining vertices", "[tntn]")
+{
+    std::vector<Vertex> vlist;
+    for(int i = 0; i < 10; i++)
+    {
+        vlist.push_back({i, 0, 0});
+    }
+
+    // includes the last vertex, which must not be used to fill the other gaps
+    remove_duplicates(vlist, {0, 3, 4, 9});
+
+    REQUIRE(vlist.size() == 6);
+    CHECK(vlist[0].x == 1);
+    CHECK(vlist[1].x == 2);
+    CHECK(vlist[2].x == 5);
+    CHECK(vlist[3].x == 6);
+    CHECK(vlist[4].x == 7);
+    CHECK(vlist[5].x == 8);
+}
+
 } //namespace unittests
 } //namespace tntn
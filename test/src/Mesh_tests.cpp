@@ -186,6 +186,42 @@ TEST_CASE("Mesh triangle/decomposed round tripping", "[tntn]")
 }
 #endif
 
+TEST_CASE("Mesh::generate_decomposed shares vertices in order of appearance", "[tntn]")
+{
+    Mesh m;
+    // 4x4 grid of quads, every inner vertex is used by 6 triangles
+    const int c = 4;
+    for(int y = 0; y < c; y++)
+    {
+        for(int x = 0; x < c; x++)
+        {
+            m.add_triangle({{{x, y, x + y}, {x + 1, y, x + 1 + y}, {x, y + 1, x + y + 1}}});
+            m.add_triangle(
+                {{{x + 1, y, x + 1 + y}, {x + 1, y + 1, x + y + 2}, {x, y + 1, x + y + 1}}});
+        }
+    }
+
+    m.generate_decomposed();
+
+    CHECK(m.vertices().distance() == (c + 1) * (c + 1));
+    CHECK(m.faces().distance() == 2 * c * c);
+
+    // first triangle introduces vertices 0, 1, 2
+    CHECK(m.faces().begin[0] == Face({{0, 1, 2}}));
+    CHECK(m.vertices().begin[1] == Vertex(1, 0, 1));
+
+    auto faces = m.faces();
+    auto triangles = m.triangles();
+    auto vertices = m.vertices();
+    for(size_t i = 0; i < faces.distance(); i++)
+    {
+        for(int n = 0; n < 3; n++)
+        {
+            CHECK(vertices.begin[faces.begin[i][n]] == triangles.begin[i][n]);
+        }
+    }
+}
+
 TEST_CASE("Mesh move construction", "[tntn]")
 {
     Mesh m1;
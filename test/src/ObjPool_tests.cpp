@@ -2,6 +2,7 @@
 
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 #include "tntn/ObjPool.h"
 
@@ -48,5 +49,52 @@ TEST_CASE("ObjPool operations", "[tntn]")
     CHECK(p3 == p4);
 }
 
+TEST_CASE("ObjPool keeps addresses stable and reuses recycled slots", "[tntn]")
+{
+    auto pool = ObjPool<std::string>::create();
+
+    const size_t n = 3 * ObjPool<std::string>::CHUNK_SIZE + 5;
+    std::vector<pool_ptr<std::string>> ptrs;
+    std::vector<const std::string*> addresses;
+    for(size_t i = 0; i < n; i++)
+    {
+        ptrs.push_back(pool->spawn(std::to_string(i)));
+        addresses.push_back(ptrs.back().get());
+    }
+
+    for(size_t i = 0; i < n; i++)
+    {
+        REQUIRE(ptrs[i].get() == addresses[i]);
+        REQUIRE(*ptrs[i] == std::to_string(i));
+    }
+
+    auto stats = pool->stats();
+    CHECK(stats.live == n);
+    CHECK(stats.free == 0);
+    CHECK(stats.peak_live == n);
+    CHECK(stats.capacity == 4 * ObjPool<std::string>::CHUNK_SIZE);
+
+    const size_t recycled_index = ptrs[7].index();
+    ptrs[7].recycle();
+    CHECK(!ptrs[7]);
+    ptrs[9].recycle();
+
+    stats = pool->stats();
+    CHECK(stats.live == n - 2);
+    CHECK(stats.free == 2);
+    CHECK(stats.peak_live == n);
+
+    // the free list is used before the pool grows, spawned objects start out fresh
+    pool->spawn();
+    const auto reused = pool->spawn();
+    CHECK(reused.index() == recycled_index);
+    CHECK(reused->empty());
+
+    stats = pool->stats();
+    CHECK(stats.live == n);
+    CHECK(stats.free == 0);
+    CHECK(stats.capacity == 4 * ObjPool<std::string>::CHUNK_SIZE);
+}
+
 } // namespace unittests
 } // namespace tntn
@@ -1,12 +1,18 @@
 #include "catch.hpp"
 
 #include <random>
+#include <boost/filesystem.hpp>
+#include <boost/scope_exit.hpp>
 
 #include "tntn/QuantizedMeshIO.h"
+#include "tntn/QuantizedMeshView.h"
+#include "tntn/MercatorProjection.h"
 #include "tntn/MeshIO.h"
 #include "tntn/terra_meshing.h"
 #include "tntn/geometrix.h"
 
+#include "test_common.h"
+
 using namespace tntn::detail;
 
 namespace tntn {
@@ -59,6 +65,54 @@ TEST_CASE("zig_zag_decode on reference values", "[tntn]")
 }
 
 #if 1
+TEST_CASE("web_mercator_to_ecef on reference points", "[tntn]")
+{
+    const glm::dvec3 origin = web_mercator_to_ecef({0, 0, 0});
+    CHECK(origin.x == Approx(6378137.0));
+    CHECK(origin.y == Approx(0).margin(1e-6));
+    CHECK(origin.z == Approx(0).margin(1e-6));
+
+    const double quarter_circumference = MercatorProjection::HALF_CIRCUMFERENCE / 2;
+    const glm::dvec3 east = web_mercator_to_ecef({quarter_circumference, 0, 100});
+    CHECK(east.x == Approx(0).margin(1e-6));
+    CHECK(east.y == Approx(6378237.0));
+    CHECK(east.z == Approx(0).margin(1e-6));
+
+    // latitude 45 degrees
+    const glm::dvec3 lat45 = web_mercator_to_ecef({0, 5621521.486192066, 0});
+    CHECK(lat45.x == Approx(4517590.878848932).epsilon(1e-12));
+    CHECK(lat45.y == Approx(0).margin(1e-6));
+    CHECK(lat45.z == Approx(4487348.408865919).epsilon(1e-12));
+}
+
+TEST_CASE("make_qm_headers converts many tiles like make_qm_header", "[tntn]")
+{
+    std::vector<BBox3D> bboxes;
+    for(int i = 0; i < 10; i++)
+    {
+        bboxes.emplace_back(glm::dvec3(i * 1000.0, -i * 2000.0, -10),
+                            glm::dvec3(i * 1000.0 + 500, -i * 2000.0 + 500, 100 + i));
+    }
+
+    std::vector<QuantizedMeshHeader> headers(bboxes.size());
+    REQUIRE(make_qm_headers(bboxes.data(), bboxes.size(), headers.data()));
+
+    for(size_t i = 0; i < bboxes.size(); i++)
+    {
+        QuantizedMeshHeader h;
+        REQUIRE(make_qm_header(bboxes[i], h));
+        CHECK(headers[i].center == h.center);
+        CHECK(headers[i].bounding_sphere_center == h.bounding_sphere_center);
+        CHECK(headers[i].BoundingSphereRadius == h.BoundingSphereRadius);
+        CHECK(headers[i].MinimumHeight == h.MinimumHeight);
+        CHECK(headers[i].MaximumHeight == h.MaximumHeight);
+        CHECK(headers[i].horizon_occlusion == h.horizon_occlusion);
+    }
+
+    QuantizedMeshHeader h;
+    CHECK(!make_qm_header(BBox3D(), h));
+}
+
 TEST_CASE("quantized mesh writer/loader round trip on small mesh", "[tntn]")
 {
     const int xscale = 2;
@@ -115,6 +169,41 @@ TEST_CASE("quantized mesh writer/loader round trip on small mesh", "[tntn]")
 }
 #endif
 
+TEST_CASE("encode_mesh_as_qm produces the bytes written to a file", "[tntn]")
+{
+    std::vector<Vertex> vertices;
+    for(int y = 0; y < 20; y++)
+    {
+        for(int x = 0; x < 20; x++)
+        {
+            vertices.push_back({x, y, (x * 7 + y * 3) % 11});
+        }
+    }
+    auto sp = std::make_unique<SurfacePoints>();
+    sp->load_from_memory(std::move(vertices));
+    auto mesh = generate_tin_terra(std::move(sp), 0.1);
+    REQUIRE(mesh != nullptr);
+    mesh->generate_triangles();
+
+    BBox3D bbox;
+    mesh->get_bbox(bbox);
+
+    auto mf = std::make_shared<MemoryFile>();
+    REQUIRE(write_mesh_as_qm(mf, *mesh, bbox));
+
+    // the buffer is cleared, so stale content from a previous tile doesn't leak
+    std::vector<unsigned char> buffer(1000, 0xFF);
+    REQUIRE(encode_mesh_as_qm(*mesh, bbox, false, buffer));
+    CHECK(buffer == mf->data());
+
+    REQUIRE(encode_mesh_as_qm(*mesh, bbox, false, buffer));
+    CHECK(buffer == mf->data());
+
+    QuantizedMeshView view;
+    REQUIRE(view.parse(buffer.data(), buffer.size()));
+    CHECK(view.triangle_count() == mesh->poly_count());
+}
+
 #if 1
 TEST_CASE("quantized mesh writer/loader round trip on empty mesh", "[tntn]")
 {
@@ -129,6 +218,78 @@ TEST_CASE("quantized mesh writer/loader round trip on empty mesh", "[tntn]")
 }
 #endif
 
+TEST_CASE("quantized mesh view reads tiles without decoding them", "[tntn]")
+{
+    std::vector<Vertex> vertices;
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<double> height(10, 50);
+    for(int y = 0; y <= 20; y += 2)
+    {
+        for(int x = 0; x <= 20; x += 2)
+        {
+            vertices.push_back({x, y, height(generator)});
+        }
+    }
+
+    auto sp = std::make_unique<SurfacePoints>();
+    sp->load_from_memory(std::move(vertices));
+    auto mesh = generate_tin_terra(std::move(sp), 0.1);
+    REQUIRE(mesh != nullptr);
+    mesh->generate_triangles();
+
+    auto tempfilename =
+        boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    REQUIRE(write_mesh_as_qm(tempfilename.c_str(), *mesh));
+    BOOST_SCOPE_EXIT(&tempfilename) { boost::filesystem::remove(tempfilename); }
+    BOOST_SCOPE_EXIT_END
+
+    QuantizedMeshView view;
+    REQUIRE(view.open(tempfilename.string()));
+    CHECK(view.triangle_count() == mesh->triangles().distance());
+    CHECK(view.indices().size() == 3 * view.triangle_count());
+    CHECK(view.indices().element_bytes() == 2);
+    CHECK(!view.west_indices().empty());
+    CHECK(!view.south_indices().empty());
+    CHECK(!view.east_indices().empty());
+    CHECK(!view.north_indices().empty());
+
+    int min_height = 0;
+    int max_height = 0;
+    REQUIRE(view.quantized_height_range(min_height, max_height));
+    CHECK(min_height == 0);
+    CHECK(max_height == 32767);
+    CHECK(double_eq(view.dequantize_height(min_height), view.header().MinimumHeight, 1e-6));
+    CHECK(double_eq(view.dequantize_height(max_height), view.header().MaximumHeight, 1e-6));
+
+    // the view decodes to the same mesh as the FileLike reader
+    auto from_view = load_mesh_from_qm(view);
+    auto from_file = load_mesh_from_qm(tempfilename.c_str());
+    REQUIRE(from_view != nullptr);
+    REQUIRE(from_file != nullptr);
+    CHECK(from_view->faces().distance() == mesh->faces().distance());
+    CHECK(from_view->semantic_equal(*from_file));
+
+    size_t visited = 0;
+    auto decoded = from_view->vertices();
+    view.for_each_vertex([&](int u, int v, int h) {
+        REQUIRE(u >= 0);
+        REQUIRE(u <= 32767);
+        REQUIRE(v >= 0);
+        REQUIRE(v <= 32767);
+        CHECK(double_eq(view.dequantize_height(h), decoded.begin[visited].z, 1e-6));
+        visited++;
+    });
+    CHECK(visited == view.vertex_count());
+
+    // truncated tiles are rejected
+    MappedFile mapped;
+    REQUIRE(mapped.open(tempfilename.string()));
+    QuantizedMeshView truncated;
+    CHECK(!truncated.parse(mapped.data(), 100));
+    CHECK(!truncated.parse(mapped.data(), mapped.size() - 1));
+    CHECK(truncated.parse(mapped.data(), mapped.size()));
+}
+
 #if 0
 TEST_CASE("load reference quantized mesh", "[tntn]")
 {
@@ -0,0 +1,305 @@
+#include "catch.hpp"
+
+#include "tntn/RasterCache.h"
+#include "tntn/RasterIO.h"
+#include "tntn/endianness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/scope_exit.hpp>
+
+namespace tntn {
+namespace unittests {
+
+static std::shared_ptr<RasterDouble> make_cache_test_raster(int w, int h)
+{
+    auto raster = std::make_shared<RasterDouble>(w, h);
+    raster->set_pos_x(1000.5);
+    raster->set_pos_y(-2000.25);
+    raster->set_cell_size(10);
+    raster->set_no_data_value(-9999);
+
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> dist(-20, 500);
+    for(int r = 0; r < h; r++)
+    {
+        for(int c = 0; c < w; c++)
+        {
+            raster->value(r, c) = (r * 5 + c * 3) % 13 == 0 ? -9999 : dist(gen) * 0.25;
+        }
+    }
+    return raster;
+}
+
+// reports a native sample type like GDALRasterSource does for integer bands
+class Int16TestSource : public MemoryRasterSource
+{
+  public:
+    using MemoryRasterSource::MemoryRasterSource;
+    RasterSampleType get_sample_type() const override { return RasterSampleType::Int16; }
+};
+
+static void require_same_pixels(const RasterSource& a, const RasterSource& b)
+{
+    REQUIRE(a.get_width() == b.get_width());
+    REQUIRE(a.get_height() == b.get_height());
+    REQUIRE(a.get_pos_x() == b.get_pos_x());
+    REQUIRE(a.get_pos_y() == b.get_pos_y());
+    REQUIRE(a.get_cell_size() == b.get_cell_size());
+    REQUIRE(a.get_no_data_value() == b.get_no_data_value());
+
+    RasterDouble ra;
+    RasterDouble rb;
+    REQUIRE(a.crop(0, 0, a.get_width(), a.get_height(), ra));
+    REQUIRE(b.crop(0, 0, b.get_width(), b.get_height(), rb));
+    for(unsigned int r = 0; r < ra.get_height(); r++)
+    {
+        for(unsigned int c = 0; c < ra.get_width(); c++)
+        {
+            REQUIRE(ra.value(r, c) == rb.value(r, c));
+        }
+    }
+}
+
+TEST_CASE("raster cache round trip", "[tntn]")
+{
+    auto path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    BOOST_SCOPE_EXIT(&path) { boost::filesystem::remove(path); }
+    BOOST_SCOPE_EXIT_END
+
+    const auto raster = make_cache_test_raster(53, 37);
+    const MemoryRasterSource memory(raster);
+
+    REQUIRE(write_raster_cache(memory, path.string(), "PROJCS[\"test\"]", 16));
+    REQUIRE(is_raster_cache_file(path.string()));
+
+    RasterCacheSource cache;
+    REQUIRE(cache.open(path.string()));
+    CHECK(cache.get_projection() == "PROJCS[\"test\"]");
+    CHECK(cache.get_sample_type() == RasterSampleType::Float64);
+    CHECK(cache.get_blocks_x() == 4);
+    CHECK(cache.get_blocks_y() == 3);
+    require_same_pixels(cache, memory);
+
+    // windows crossing block borders
+    RasterDouble part;
+    RasterDouble expected;
+    REQUIRE(cache.crop(10, 14, 30, 20, part));
+    raster->crop(10, 14, 30, 20, expected);
+    for(unsigned int r = 0; r < expected.get_height(); r++)
+    {
+        for(unsigned int c = 0; c < expected.get_width(); c++)
+        {
+            REQUIRE(part.value(r, c) == expected.value(r, c));
+        }
+    }
+
+    for(int by = 0; by < cache.get_blocks_y(); by++)
+    {
+        for(int bx = 0; bx < cache.get_blocks_x(); bx++)
+        {
+            double min = raster->get_no_data_value();
+            double max = raster->get_no_data_value();
+            uint32_t no_data_count = 0;
+            bool any_valid = false;
+            for(int r = by * 16; r < std::min(by * 16 + 16, 37); r++)
+            {
+                for(int c = bx * 16; c < std::min(bx * 16 + 16, 53); c++)
+                {
+                    const double v = raster->value(r, c);
+                    if(raster->is_no_data(v))
+                    {
+                        no_data_count++;
+                    }
+                    else
+                    {
+                        min = any_valid ? std::min(min, v) : v;
+                        max = any_valid ? std::max(max, v) : v;
+                        any_valid = true;
+                    }
+                }
+            }
+
+            const RasterBlockSummary s = cache.get_block_summary(bx, by);
+            CHECK(s.min == min);
+            CHECK(s.max == max);
+            CHECK(s.no_data_count == no_data_count);
+        }
+    }
+}
+
+TEST_CASE("raster cache keeps the native sample type", "[tntn]")
+{
+    auto path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    BOOST_SCOPE_EXIT(&path) { boost::filesystem::remove(path); }
+    BOOST_SCOPE_EXIT_END
+
+    auto raster = make_cache_test_raster(40, 30);
+    for(int r = 0; r < 30; r++)
+    {
+        for(int c = 0; c < 40; c++)
+        {
+            raster->value(r, c) = std::round(raster->value(r, c));
+        }
+    }
+    const Int16TestSource memory(raster);
+
+    REQUIRE(write_raster_cache(memory, path.string(), "", 32));
+
+    RasterCacheSource cache;
+    REQUIRE(cache.open(path.string()));
+    CHECK(cache.get_sample_type() == RasterSampleType::Int16);
+    require_same_pixels(cache, memory);
+
+    RasterInt16 samples;
+    REQUIRE(cache.crop(0, 0, 40, 30, samples));
+    CHECK(samples.value(3, 4) == static_cast<int16_t>(raster->value(3, 4)));
+}
+
+TEST_CASE("raster files open raster caches", "[tntn]")
+{
+    auto path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    BOOST_SCOPE_EXIT(&path) { boost::filesystem::remove(path); }
+    BOOST_SCOPE_EXIT_END
+
+    const auto raster = make_cache_test_raster(21, 19);
+    const MemoryRasterSource memory(raster);
+    REQUIRE(write_raster_cache(memory, path.string(), "", 8));
+
+    auto source = open_raster_source(path.string(), false);
+    REQUIRE(source != nullptr);
+    require_same_pixels(*source, memory);
+
+    RasterDouble loaded;
+    REQUIRE(load_raster_file(path.string(), loaded, false));
+    REQUIRE(loaded.get_width() == raster->get_width());
+    REQUIRE(loaded.get_height() == raster->get_height());
+    CHECK(loaded.get_pos_x() == raster->get_pos_x());
+    CHECK(loaded.get_pos_y() == raster->get_pos_y());
+    for(unsigned int r = 0; r < loaded.get_height(); r++)
+    {
+        for(unsigned int c = 0; c < loaded.get_width(); c++)
+        {
+            REQUIRE(loaded.value(r, c) == raster->value(r, c));
+        }
+    }
+}
+
+TEST_CASE("raster cache keeps -32768 samples without a no-data value int16 holds", "[tntn]")
+{
+    auto path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    BOOST_SCOPE_EXIT(&path) { boost::filesystem::remove(path); }
+    BOOST_SCOPE_EXIT_END
+
+    CHECK(sample_type_holds(RasterSampleType::Int16, -32768));
+    CHECK(!sample_type_holds(RasterSampleType::Int16, -1e10));
+    CHECK(!sample_type_holds(RasterSampleType::Int16, 0.5));
+    CHECK(sample_type_holds(RasterSampleType::Float32, -1e10));
+
+    // no declared no-data, like an int16 band GDAL reports -1e10 for
+    auto raster = std::make_shared<RasterDouble>(20, 10);
+    raster->set_no_data_value(-1e10);
+    raster->set_all(100);
+    raster->value(3, 4) = -32768;
+    const Int16TestSource memory(raster);
+
+    REQUIRE(write_raster_cache(memory, path.string(), "", 8));
+
+    RasterCacheSource cache;
+    REQUIRE(cache.open(path.string()));
+    CHECK(cache.get_sample_type() == RasterSampleType::Float64);
+    CHECK(cache.get_no_data_value() == -1e10);
+    require_same_pixels(cache, memory);
+    CHECK(cache.get_block_summary(0, 0).no_data_count == 0);
+    CHECK(cache.get_block_summary(0, 0).min == -32768);
+
+    // clamping -1e10 would turn the -32768 sample into no-data
+    RasterInt16 samples;
+    CHECK(!load_raster_file(path.string(), samples, false));
+}
+
+TEST_CASE("raster cache rejects incomplete files", "[tntn]")
+{
+    auto path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    BOOST_SCOPE_EXIT(&path) { boost::filesystem::remove(path); }
+    BOOST_SCOPE_EXIT_END
+
+    const auto raster = make_cache_test_raster(30, 30);
+    REQUIRE(write_raster_cache(MemoryRasterSource(raster), path.string(), "", 16));
+
+    boost::filesystem::resize_file(path, boost::filesystem::file_size(path) - 1);
+    RasterCacheSource cache;
+    CHECK(!cache.open(path.string()));
+
+    boost::filesystem::resize_file(path, 4);
+    CHECK(!is_raster_cache_file(path.string()));
+    CHECK(!cache.open(path.string()));
+}
+
+TEST_CASE("raster cache rejects corrupt headers", "[tntn]")
+{
+    auto path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    BOOST_SCOPE_EXIT(&path) { boost::filesystem::remove(path); }
+    BOOST_SCOPE_EXIT_END
+
+    const auto raster = make_cache_test_raster(30, 30);
+
+    // writes a fresh cache and overwrites uint32 values at offsets in its header
+    auto write_corrupt_cache = [&](const std::vector<std::pair<size_t, uint32_t>>& values) {
+        REQUIRE(write_raster_cache(MemoryRasterSource(raster), path.string(), "", 16));
+        std::fstream f(path.string(), std::ios::in | std::ios::out | std::ios::binary);
+        for(const auto& v : values)
+        {
+            unsigned char bytes[4];
+            store_little_endian(v.second, bytes);
+            f.seekp(v.first);
+            f.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+        }
+    };
+
+    RasterCacheSource cache;
+    const size_t width_offset = 16;
+    const size_t height_offset = 20;
+    const size_t block_width_offset = 24;
+    const size_t block_height_offset = 28;
+    const size_t projection_size_offset = 64;
+
+    write_corrupt_cache({{width_offset, 0}});
+    CHECK(!cache.open(path.string()));
+
+    // would turn negative as int
+    write_corrupt_cache({{width_offset, 0x80000000u}});
+    CHECK(!cache.open(path.string()));
+
+    write_corrupt_cache({{height_offset, 0xffffffffu}});
+    CHECK(!cache.open(path.string()));
+
+    write_corrupt_cache({{block_width_offset, 0}});
+    CHECK(!cache.open(path.string()));
+
+    // width + block width - 1 would overflow int
+    write_corrupt_cache({{block_width_offset, 0x7fffffffu}});
+    CHECK(!cache.open(path.string()));
+
+    // block count * block bytes would wrap around in uint64
+    write_corrupt_cache({{width_offset, 0x7fffffffu}, {height_offset, 0x7fffffffu}});
+    CHECK(!cache.open(path.string()));
+
+    write_corrupt_cache({{block_height_offset, 0x7fffffffu}});
+    CHECK(!cache.open(path.string()));
+
+    write_corrupt_cache({{projection_size_offset, 0xffffffffu}});
+    CHECK(!cache.open(path.string()));
+
+    REQUIRE(write_raster_cache(MemoryRasterSource(raster), path.string(), "", 16));
+    CHECK(cache.open(path.string()));
+}
+
+} // namespace unittests
+} // namespace tntn
@@ -7,7 +7,13 @@
 
 #include <memory>
 #include <cstdlib>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <string>
 #include <boost/filesystem.hpp>
+#include <boost/scope_exit.hpp>
 
 namespace tntn {
 namespace unittests {
@@ -37,5 +43,130 @@ TEST_CASE("load_raster_file", "[tntn]")
     REQUIRE(double_eq(raster.get_pos_y(), 4543905.659, 0.001));
 }
 
+TEST_CASE("open_raster_source reads the same pixels as load_raster_file", "[tntn]")
+{
+    fs::path bogus_file = fixture_path("there.is.no.such.raster.file");
+    REQUIRE(open_raster_source(bogus_file.string()) == nullptr);
+
+    fs::path valid_raster_file = fixture_path("valid_raster.tif");
+
+    RasterDouble raster;
+    REQUIRE(load_raster_file(valid_raster_file.string(), raster));
+
+    // a tiny cache forces blocks to be evicted and read again
+    auto source = open_raster_source(valid_raster_file.string(), true, 1);
+    REQUIRE(source != nullptr);
+    REQUIRE(source->get_width() == raster.get_width());
+    REQUIRE(source->get_height() == raster.get_height());
+    REQUIRE(source->get_pos_x() == raster.get_pos_x());
+    REQUIRE(source->get_pos_y() == raster.get_pos_y());
+    REQUIRE(source->get_cell_size() == raster.get_cell_size());
+
+    RasterDouble expected;
+    raster.crop(13, 7, 60, 50, expected);
+
+    RasterDouble cropped;
+    REQUIRE(source->crop(13, 7, 60, 50, cropped));
+    REQUIRE(cropped.get_width() == expected.get_width());
+    REQUIRE(cropped.get_height() == expected.get_height());
+    REQUIRE(cropped.get_pos_x() == expected.get_pos_x());
+    REQUIRE(cropped.get_pos_y() == expected.get_pos_y());
+    REQUIRE(std::equal(cropped.get_ptr(),
+                       cropped.get_ptr() + cropped.get_width() * cropped.get_height(),
+                       expected.get_ptr()));
+}
+
+TEST_CASE("load_raster_from_asc reads what write_raster_to_asc wrote", "[tntn]")
+{
+    auto path = fs::temp_directory_path() / fs::unique_path();
+    BOOST_SCOPE_EXIT(&path) { fs::remove(path); }
+    BOOST_SCOPE_EXIT_END
+
+    // large enough to be split into several chunks
+    RasterDouble raster(700, 500);
+    raster.set_pos_x(1000.5);
+    raster.set_pos_y(-2000.25);
+    raster.set_cell_size(2.5);
+    raster.set_no_data_value(-9999);
+
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<double> dist(-500, 9000);
+    for(unsigned int r = 0; r < raster.get_height(); r++)
+    {
+        for(unsigned int c = 0; c < raster.get_width(); c++)
+        {
+            raster.value(r, c) = c % 5 == 0 ? std::round(dist(gen)) : dist(gen);
+        }
+    }
+    REQUIRE(write_raster_to_asc(path.string(), raster));
+
+    for(int num_threads : {1, 3})
+    {
+        const RasterDouble loaded = load_raster_from_asc(path.string(), num_threads);
+        REQUIRE(loaded.get_width() == raster.get_width());
+        REQUIRE(loaded.get_height() == raster.get_height());
+        CHECK(loaded.get_pos_x() == raster.get_pos_x());
+        CHECK(loaded.get_pos_y() == raster.get_pos_y());
+        CHECK(loaded.get_cell_size() == raster.get_cell_size());
+        CHECK(loaded.get_no_data_value() == raster.get_no_data_value());
+        REQUIRE(std::equal(loaded.get_ptr(),
+                           loaded.get_ptr() + loaded.get_width() * loaded.get_height(),
+                           raster.get_ptr()));
+    }
+}
+
+TEST_CASE("load_raster_from_asc parses numbers like std::stod", "[tntn]")
+{
+    auto path = fs::temp_directory_path() / fs::unique_path();
+    BOOST_SCOPE_EXIT(&path) { fs::remove(path); }
+    BOOST_SCOPE_EXIT_END
+
+    const std::vector<std::string> values = {"0",
+                                             "-0",
+                                             "+12",
+                                             "007.50",
+                                             ".25",
+                                             "-3.",
+                                             "1e3",
+                                             "2.5E-4",
+                                             "0.1",
+                                             "0.000000000000000000000000123",
+                                             "123456789012345678901234567890",
+                                             "9007199254740993",
+                                             "1e-300",
+                                             "-1.7976931348623157e308",
+                                             "12abc"};
+    {
+        std::ofstream f(path.string());
+        f << "ncols " << values.size() << "\r\nnrows 2\r\n"
+          << "xllcorner 10\r\nyllcorner 20\r\ncellsize 1\r\nNODATA_value -9999\r\n";
+        for(int r = 0; r < 2; r++)
+        {
+            f << "\t";
+            for(const auto& v : values)
+            {
+                f << v << "  ";
+            }
+            // lines with a single token are skipped
+            f << "\r\n\r\nx\r\n";
+        }
+    }
+
+    const RasterDouble loaded = load_raster_from_asc(path.string(), 1);
+    REQUIRE(loaded.get_width() == values.size());
+    REQUIRE(loaded.get_height() == 2);
+    CHECK(loaded.get_pos_x() == 10);
+    CHECK(loaded.get_no_data_value() == -9999);
+    for(unsigned int r = 0; r < 2; r++)
+    {
+        for(unsigned int c = 0; c < values.size(); c++)
+        {
+            const double expected = std::stod(values[c]);
+            CHECK(loaded.value(r, c) == expected);
+            CHECK(std::signbit(loaded.value(r, c)) == std::signbit(expected));
+        }
+    }
+}
+
 } // namespace unittests
 } // namespace tntn
@@ -3,11 +3,13 @@
 #include "tntn/Raster.h"
 #include "tntn/RasterIO.h"
 #include "tntn/RasterOverviews.h"
+#include "tntn/raster_tools.h"
 
 #include "test_common.h"
 
 #include <memory>
 #include <cstdlib>
+#include <random>
 #include <boost/filesystem.hpp>
 
 namespace tntn {
@@ -77,6 +79,123 @@ TEST_CASE("raster_overviews_tests_2", "[tntn]")
     }
 }
 
+// cell size of zoom level 3, a 1000 pixel wide raster then has overviews down to zoom 0
+static std::unique_ptr<RasterDouble> make_overview_test_raster()
+{
+    auto raster = std::make_unique<RasterDouble>(1000, 700);
+    raster->set_cell_size(156543.04 / 8);
+    raster->set_pos_x(100);
+    raster->set_pos_y(200);
+    raster->set_no_data_value(-9999);
+
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> value(-20, 500);
+    for(int r = 0; r < 700; r++)
+    {
+        for(int c = 0; c < 1000; c++)
+        {
+            raster->value(r, c) = r > 600 && c > 900 ? -9999 : value(gen);
+        }
+    }
+    // a block without any data and one with a negative sum
+    for(int r = 0; r < 8; r++)
+    {
+        for(int c = 0; c < 8; c++)
+        {
+            raster->value(r, c) = -9999;
+            raster->value(r + 8, c) = -1;
+        }
+    }
+    return raster;
+}
+
+static void require_same_overview(const RasterDouble& expected, const RasterDouble& actual)
+{
+    REQUIRE(actual.get_width() == expected.get_width());
+    REQUIRE(actual.get_height() == expected.get_height());
+    REQUIRE(actual.get_cell_size() == expected.get_cell_size());
+    REQUIRE(actual.get_pos_x() == expected.get_pos_x());
+    REQUIRE(actual.get_pos_y() == expected.get_pos_y());
+    REQUIRE(actual.get_no_data_value() == expected.get_no_data_value());
+
+    for(unsigned int r = 0; r < expected.get_height(); r++)
+    {
+        for(unsigned int c = 0; c < expected.get_width(); c++)
+        {
+            // sums are added up in a different order
+            REQUIRE(double_eq(actual.value(r, c), expected.value(r, c), 1e-9));
+        }
+    }
+}
+
+TEST_CASE("raster overviews cascade matches integer_downsample_mean", "[tntn]")
+{
+    const auto base = make_overview_test_raster();
+
+    for(const bool precompute : {false, true})
+    {
+        RasterOverviews overviews(
+            std::make_unique<RasterDouble>(base->clone()), 0, 3, precompute ? 3 : 1);
+        if(precompute)
+        {
+            REQUIRE(overviews.precompute());
+        }
+
+        RasterOverview overview;
+        int expected_zoom = 3;
+        while(overviews.next(overview))
+        {
+            REQUIRE(overview.zoom_level == expected_zoom);
+            const int window_size = 1 << (3 - expected_zoom);
+            if(window_size == 1)
+            {
+                require_same_overview(*base, *overview.raster);
+            }
+            else
+            {
+                require_same_overview(raster_tools::integer_downsample_mean(*base, window_size),
+                                      *overview.raster);
+            }
+            expected_zoom--;
+        }
+        REQUIRE(expected_zoom == -1);
+    }
+}
+
+TEST_CASE("cascaded and precomputed raster source overviews match lazy ones", "[tntn]")
+{
+    std::shared_ptr<const RasterDouble> base = make_overview_test_raster();
+    auto source = std::make_shared<MemoryRasterSource>(base);
+
+    RasterOverviews lazy(source, 0, 3);
+    RasterOverviews cascaded(source, 0, 3, 2);
+    cascaded.set_cascade(true);
+    RasterOverviews precomputed(source, 0, 3, 2);
+    REQUIRE(precomputed.precompute());
+
+    RasterSourceOverview a;
+    RasterSourceOverview b;
+    RasterSourceOverview c;
+    while(lazy.next(a))
+    {
+        REQUIRE(cascaded.next(b));
+        REQUIRE(precomputed.next(c));
+        REQUIRE(a.zoom_level == b.zoom_level);
+        REQUIRE(a.zoom_level == c.zoom_level);
+        REQUIRE(a.resolution == b.resolution);
+        REQUIRE(a.resolution == c.resolution);
+
+        RasterDouble expected;
+        RasterDouble actual;
+        REQUIRE(a.source->crop(0, 0, a.source->get_width(), a.source->get_height(), expected));
+        REQUIRE(b.source->crop(0, 0, b.source->get_width(), b.source->get_height(), actual));
+        require_same_overview(expected, actual);
+        REQUIRE(c.source->crop(0, 0, c.source->get_width(), c.source->get_height(), actual));
+        require_same_overview(expected, actual);
+    }
+    REQUIRE_FALSE(cascaded.next(b));
+    REQUIRE_FALSE(precomputed.next(c));
+}
 
 } // namespace unittests
 } // namespace tntn
@@ -0,0 +1,202 @@
+#include "catch.hpp"
+
+#include "tntn/Raster.h"
+#include "tntn/RasterSource.h"
+#include "tntn/RasterOverviews.h"
+#include "tntn/raster_tools.h"
+#include "tntn/dem2tintiles_workflow.h"
+
+#include <cmath>
+#include <memory>
+#include <random>
+
+namespace tntn {
+namespace unittests {
+
+static std::shared_ptr<RasterDouble> make_test_raster(int w, int h)
+{
+    auto raster = std::make_shared<RasterDouble>(w, h);
+    raster->set_pos_x(1000.5);
+    raster->set_pos_y(-2000.25);
+    raster->set_cell_size(10);
+    raster->set_no_data_value(-9999);
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> dist(-20, 500);
+    for(int r = 0; r < h; r++)
+    {
+        for(int c = 0; c < w; c++)
+        {
+            raster->value(r, c) = (r * 7 + c * 3) % 11 == 0 ? -9999 : dist(gen);
+        }
+    }
+    return raster;
+}
+
+// uses the generic RasterSource::crop on top of read_window
+class WindowedTestSource : public RasterSource
+{
+  public:
+    explicit WindowedTestSource(std::shared_ptr<const RasterDouble> raster) : m_memory(raster)
+    {
+        copy_parameters(*raster);
+    }
+
+    bool read_window(int cx, int cy, int cw, int ch, double* dst, size_t dst_stride) const override
+    {
+        return m_memory.read_window(cx, cy, cw, ch, dst, dst_stride);
+    }
+
+  private:
+    MemoryRasterSource m_memory;
+};
+
+static void require_same_raster(const RasterDouble& a, const RasterDouble& b, double eps = 0)
+{
+    REQUIRE(a.get_width() == b.get_width());
+    REQUIRE(a.get_height() == b.get_height());
+    REQUIRE(a.get_pos_x() == b.get_pos_x());
+    REQUIRE(a.get_pos_y() == b.get_pos_y());
+    REQUIRE(a.get_cell_size() == b.get_cell_size());
+    REQUIRE(a.get_no_data_value() == b.get_no_data_value());
+    for(unsigned int r = 0; r < a.get_height(); r++)
+    {
+        for(unsigned int c = 0; c < a.get_width(); c++)
+        {
+            if(eps == 0)
+            {
+                REQUIRE(a.value(r, c) == b.value(r, c));
+            }
+            else
+            {
+                REQUIRE(std::fabs(a.value(r, c) - b.value(r, c)) <= eps);
+            }
+        }
+    }
+}
+
+TEST_CASE("RasterSource geometry matches Raster", "[tntn]")
+{
+    auto raster = make_test_raster(37, 23);
+    MemoryRasterSource source(raster);
+
+    CHECK(source.get_width() == raster->get_width());
+    CHECK(source.get_height() == raster->get_height());
+    CHECK(source.get_bounding_box().min == raster->get_bounding_box().min);
+    CHECK(source.get_bounding_box().max == raster->get_bounding_box().max);
+
+    for(double v = 900; v < 1500; v += 7.3)
+    {
+        CHECK(source.x2col(v) == raster->x2col(v));
+        CHECK(source.y2row(v - 3000) == raster->y2row(v - 3000));
+    }
+}
+
+TEST_CASE("RasterSource crop matches Raster::crop", "[tntn]")
+{
+    auto raster = make_test_raster(37, 23);
+
+    auto source = std::make_shared<WindowedTestSource>(raster);
+
+    const int windows[][4] = {
+        {0, 0, 37, 23}, {5, 3, 10, 7}, {-4, -2, 12, 9}, {30, 20, 20, 20}, {36, 22, 1, 1}};
+
+    for(const auto& w : windows)
+    {
+        RasterDouble expected;
+        raster->crop(w[0], w[1], w[2], w[3], expected);
+
+        RasterDouble cropped;
+        REQUIRE(source->crop(w[0], w[1], w[2], w[3], cropped));
+        require_same_raster(cropped, expected);
+    }
+}
+
+TEST_CASE("MemoryRasterSource crop shares the raster's pixels", "[tntn]")
+{
+    auto raster = make_test_raster(37, 23);
+    MemoryRasterSource source(raster);
+
+    const int windows[][4] = {
+        {0, 0, 37, 23}, {5, 3, 10, 7}, {-4, -2, 12, 9}, {30, 20, 20, 20}, {36, 22, 1, 1}};
+
+    for(const auto& w : windows)
+    {
+        RasterDouble expected;
+        raster->crop(w[0], w[1], w[2], w[3], expected);
+
+        RasterDouble cropped;
+        REQUIRE(source.crop(w[0], w[1], w[2], w[3], cropped));
+        CHECK(cropped.is_view());
+        require_same_raster(cropped, expected);
+    }
+
+    // meshing fills missing corners in a copy, not in the source's raster
+    REQUIRE(raster->is_no_data(raster->value(0, 0)));
+    auto mesh = generate_tin_from_window(source, 0, 0, 37, 23, "terra", 50.0);
+    REQUIRE(mesh != nullptr);
+    CHECK(mesh->poly_count() > 0);
+    CHECK(raster->is_no_data(raster->value(0, 0)));
+}
+
+TEST_CASE("DownsampledRasterSource matches integer_downsample_mean", "[tntn]")
+{
+    auto raster = make_test_raster(50, 35);
+    auto base = std::make_shared<MemoryRasterSource>(raster);
+
+    for(int win : {2, 3, 4, 8})
+    {
+        const RasterDouble expected = raster_tools::integer_downsample_mean(*raster, win);
+        DownsampledRasterSource source(base, win);
+
+        RasterDouble whole;
+        REQUIRE(source.crop(0, 0, source.get_width(), source.get_height(), whole));
+        require_same_raster(whole, expected);
+
+        RasterDouble part;
+        REQUIRE(source.crop(1, 2, 3, 2, part));
+        RasterDouble expected_part;
+        expected.crop(1, 2, 3, 2, expected_part);
+        require_same_raster(part, expected_part);
+    }
+}
+
+TEST_CASE("RasterOverviews of a source match in-memory overviews", "[tntn]")
+{
+    auto raster = make_test_raster(300, 260);
+    raster->set_cell_size(2.5);
+
+    RasterOverviews source_overviews(std::make_shared<MemoryRasterSource>(raster), 12, 20);
+    RasterOverviews raster_overviews(
+        std::make_unique<RasterDouble>(raster->clone()), 12, 20);
+
+    RasterSourceOverview source_overview;
+    RasterOverview raster_overview;
+    int count = 0;
+
+    while(raster_overviews.next(raster_overview))
+    {
+        REQUIRE(source_overviews.next(source_overview));
+        CHECK(source_overview.zoom_level == raster_overview.zoom_level);
+        CHECK(source_overview.resolution == raster_overview.resolution);
+
+        const RasterSource& s = *source_overview.source;
+        RasterDouble cropped;
+        REQUIRE(s.crop(0, 0, s.get_width(), s.get_height(), cropped));
+        // in-memory overviews are reduced level by level and sum in a different order
+        require_same_raster(cropped, *raster_overview.raster, 1e-9);
+
+        const auto source_partitions =
+            create_partitions_for_zoom_level(s, source_overview.zoom_level);
+        const auto raster_partitions =
+            create_partitions_for_zoom_level(*raster_overview.raster, raster_overview.zoom_level);
+        REQUIRE(source_partitions.size() == raster_partitions.size());
+
+        count++;
+    }
+    CHECK(count > 1);
+    CHECK(!source_overviews.next(source_overview));
+}
+
+} // namespace unittests
+} // namespace tntn
@@ -138,6 +138,34 @@ TEST_CASE("Raster integer downsampe", "[tntn]")
     }
 }
 
+TEST_CASE("Raster integer downsample below sea level and with no data", "[tntn]")
+{
+    RasterDouble big(7, 9);
+    big.set_no_data_value(-9999);
+    for(int r = 0; r < 9; r++)
+    {
+        for(int c = 0; c < 7; c++)
+        {
+            big.value(r, c) = -10.0 * r - c;
+        }
+    }
+    // one window without any valid pixel and one with a single valid pixel
+    big.value(0, 0) = big.value(0, 1) = big.value(1, 0) = big.value(1, 1) = -9999;
+    big.value(2, 2) = big.value(2, 3) = big.value(3, 2) = -9999;
+
+    for(int threads : {1, 3})
+    {
+        RasterDouble small = raster_tools::integer_downsample_mean(big, 2, threads);
+
+        REQUIRE(small.get_width() == 3);
+        REQUIRE(small.get_height() == 4);
+        CHECK(small.value(0, 0) == -9999);
+        CHECK(small.value(1, 1) == -33.0);
+        CHECK(small.value(0, 1) == -7.5);
+        CHECK(small.value(3, 2) == -69.5);
+    }
+}
+
 TEST_CASE("Raster crop", "[tntn]")
 {
     struct P
@@ -300,6 +328,67 @@ TEST_CASE("Raster crop", "[tntn]")
     }
 }
 
+TEST_CASE("Raster view shares pixels", "[tntn]")
+{
+    RasterDouble raster(7, 5);
+    raster.set_cell_size(2);
+    raster.set_pos_x(100);
+    raster.set_pos_y(-50);
+    raster.set_no_data_value(-1);
+    for(int r = 0; r < 5; r++)
+    {
+        for(int c = 0; c < 7; c++)
+        {
+            raster.value(r, c) = r * 10 + c;
+        }
+    }
+
+    const int windows[][4] = {{0, 0, 7, 5}, {2, 1, 3, 3}, {-2, -1, 4, 3}, {5, 3, 10, 10}};
+    for(const auto& w : windows)
+    {
+        const RasterDouble cropped = raster.crop(w[0], w[1], w[2], w[3]);
+        const RasterDouble view = raster.view(w[0], w[1], w[2], w[3]);
+
+        CHECK(view.is_view());
+        CHECK(view.get_stride() == raster.get_width());
+        REQUIRE(view.get_width() == cropped.get_width());
+        REQUIRE(view.get_height() == cropped.get_height());
+        CHECK(view.get_pos_x() == cropped.get_pos_x());
+        CHECK(view.get_pos_y() == cropped.get_pos_y());
+        CHECK(view.get_cell_size() == cropped.get_cell_size());
+        CHECK(view.get_no_data_value() == cropped.get_no_data_value());
+        const int top = std::max(w[1], 0);
+        const int left = std::max(w[0], 0);
+        for(unsigned int r = 0; r < view.get_height(); r++)
+        {
+            for(unsigned int c = 0; c < view.get_width(); c++)
+            {
+                CHECK(view.value(r, c) == cropped.value(r, c));
+                CHECK(&view.value(r, c) == &raster.value(r + top, c + left));
+            }
+        }
+    }
+
+    RasterDouble view = raster.view(2, 1, 3, 2);
+    view.set_all(99);
+    CHECK(raster.value(1, 2) == 99);
+    CHECK(raster.value(2, 4) == 99);
+    CHECK(raster.value(1, 1) == 11);
+    CHECK(raster.value(1, 5) == 15);
+    CHECK(raster.value(3, 2) == 32);
+    CHECK(raster.count(99) == 6);
+
+    // a clone of a view has its own contiguous pixels
+    RasterDouble copy = view.clone();
+    CHECK(!copy.is_view());
+    CHECK(copy.get_stride() == 3);
+    CHECK(copy.count(99) == 6);
+
+    // the view keeps the pixels alive
+    raster.clear();
+    CHECK(view.value(1, 2) == 99);
+}
+
 TEST_CASE("Raster setAll", "[tntn]")
 {
 
@@ -0,0 +1,155 @@
+#include "catch.hpp"
+
+#include "tntn/TileMaker.h"
+#include "tntn/Mesh.h"
+#include "tntn/geometrix.h"
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace tntn {
+namespace unittests {
+
+static std::vector<uint32_t> find_triangles_brute_force(const std::vector<Triangle>& triangles,
+                                                        const BBox2D& bounds)
+{
+    std::vector<uint32_t> indices;
+    for(size_t i = 0; i < triangles.size(); i++)
+    {
+        if(BBox2D(triangles[i]).intersects(bounds))
+        {
+            indices.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    return indices;
+}
+
+static void load_triangles(TileMaker& tile_maker, std::vector<Triangle> triangles)
+{
+    auto mesh = std::make_unique<Mesh>();
+    mesh->from_triangles(std::move(triangles));
+    tile_maker.loadMesh(std::move(mesh));
+}
+
+static void check_find_triangles(const std::vector<Triangle>& triangles,
+                                 const std::vector<BBox2D>& queries)
+{
+    TileMaker tile_maker;
+    load_triangles(tile_maker, triangles);
+
+    std::vector<uint32_t> found;
+    for(const BBox2D& query : queries)
+    {
+        tile_maker.find_triangles(query, found);
+        CHECK(found == find_triangles_brute_force(triangles, query));
+    }
+}
+
+static BBox2D box(double min_x, double min_y, double max_x, double max_y)
+{
+    return BBox2D(glm::dvec2(min_x, min_y), glm::dvec2(max_x, max_y));
+}
+
+// a width x height grid of unit squares, each split into two triangles
+static std::vector<Triangle> make_grid_triangles(const int width, const int height)
+{
+    std::vector<Triangle> triangles;
+    for(int y = 0; y < height; y++)
+    {
+        for(int x = 0; x < width; x++)
+        {
+            const Vertex a = {x, y, 0};
+            const Vertex b = {x + 1, y, 0};
+            const Vertex c = {x + 1, y + 1, 0};
+            const Vertex d = {x, y + 1, 0};
+            triangles.push_back({{a, b, c}});
+            triangles.push_back({{a, c, d}});
+        }
+    }
+    return triangles;
+}
+
+TEST_CASE("tile maker grid finds the triangles of tiles on mesh edges and corners", "[tntn]")
+{
+    const auto triangles = make_grid_triangles(40, 30);
+
+    const std::vector<BBox2D> queries = {
+        // corners, partly outside the mesh
+        box(-5, -5, 3.5, 2.5),
+        box(37.5, -5, 45, 2.5),
+        box(37.5, 27.5, 45, 35),
+        box(-5, 27.5, 3.5, 35),
+        // edges
+        box(10.5, -5, 20.5, 1),
+        box(39.5, 10.5, 50, 20.5),
+        box(10.5, 29.5, 20.5, 50),
+        box(-10, 10.5, 0.5, 20.5),
+        // touching the mesh bounds from outside, and just missing them
+        box(-5, -5, 0, 0),
+        box(40, 30, 45, 35),
+        box(-5, 10, -0.001, 20),
+        box(40.001, 10, 45, 20),
+        // cell and triangle borders, the whole mesh and more
+        box(10, 10, 20, 20),
+        box(0, 0, 40, 30),
+        box(-100, -100, 100, 100),
+    };
+    check_find_triangles(triangles, queries);
+}
+
+TEST_CASE("tile maker grid finds triangles spanning many cells", "[tntn]")
+{
+    auto triangles = make_grid_triangles(40, 30);
+    // spans most of the grid, but its bounding box misses the bottom left corner
+    triangles.push_back({{Vertex{2, 1, 0}, Vertex{39, 3, 0}, Vertex{20, 29, 0}}});
+    // a sliver along the whole top edge
+    triangles.push_back({{Vertex{0, 29.5, 0}, Vertex{40, 29.5, 0}, Vertex{20, 29.6, 0}}});
+
+    std::vector<BBox2D> queries = {
+        box(0, 0, 1.5, 0.5),
+        box(25, 15, 26, 16),
+        box(0, 29.55, 0.1, 29.58),
+        box(39.9, 29.4, 41, 29.45),
+    };
+
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<double> coord(-5, 45);
+    std::uniform_real_distribution<double> extent(0, 8);
+    for(int i = 0; i < 200; i++)
+    {
+        const double x = coord(gen);
+        const double y = coord(gen);
+        queries.push_back(box(x, y, x + extent(gen), y + extent(gen)));
+    }
+    check_find_triangles(triangles, queries);
+}
+
+TEST_CASE("tile maker grid finds triangles of meshes without width or height", "[tntn]")
+{
+    std::vector<Triangle> vertical;
+    std::vector<Triangle> horizontal;
+    for(int i = 0; i < 50; i++)
+    {
+        vertical.push_back({{Vertex{5, i, 0}, Vertex{5, i + 1, 0}, Vertex{5, i + 0.5, 1}}});
+        horizontal.push_back({{Vertex{i, 5, 0}, Vertex{i + 1, 5, 0}, Vertex{i + 0.5, 5, 1}}});
+    }
+    const std::vector<Triangle> point = {{{Vertex{5, 5, 0}, Vertex{5, 5, 1}, Vertex{5, 5, 2}}}};
+
+    const std::vector<BBox2D> queries = {
+        box(0, 0, 10, 10),
+        box(4, 20.5, 6, 30.5),
+        box(20.5, 4, 30.5, 6),
+        box(5, 5, 5, 5),
+        box(-10, -10, 4.9, 4.9),
+        box(5.1, 5.1, 100, 100),
+        box(-100, -100, 100, 100),
+    };
+    check_find_triangles(vertical, queries);
+    check_find_triangles(horizontal, queries);
+    check_find_triangles(point, queries);
+}
+
+} // namespace unittests
+} // namespace tntn
@@ -0,0 +1,346 @@
+#include "catch.hpp"
+
+#include "tntn/TileStore.h"
+#include "tntn/endianness.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/scope_exit.hpp>
+
+namespace tntn {
+namespace unittests {
+
+static std::string tile_payload(int zoom, int tx, int ty)
+{
+    return std::to_string(zoom) + "/" + std::to_string(tx) + "/" + std::to_string(ty) +
+        std::string(tx % 7, '.');
+}
+
+static bool write_payload(TileSink& sink, int zoom, int tx, int ty, const std::string& payload)
+{
+    return sink.write_tile(zoom,
+                           tx,
+                           ty,
+                           reinterpret_cast<const unsigned char*>(payload.data()),
+                           payload.size());
+}
+
+TEST_CASE("tile archive round trip from several threads", "[tntn]")
+{
+    auto archive_path =
+        boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    BOOST_SCOPE_EXIT(&archive_path) { boost::filesystem::remove(archive_path); }
+    BOOST_SCOPE_EXIT_END
+
+    {
+        // small batches to exercise the appends
+        ArchiveTileSink sink(100);
+        REQUIRE(sink.open(archive_path.string()));
+
+        std::vector<std::thread> threads;
+        for(int zoom = 0; zoom < 4; zoom++)
+        {
+            threads.emplace_back([&sink, zoom]() {
+                for(int tx = 0; tx < (1 << zoom); tx++)
+                {
+                    for(int ty = 0; ty < (1 << zoom); ty++)
+                    {
+                        write_payload(sink, zoom, tx, ty, tile_payload(zoom, tx, ty));
+                    }
+                }
+            });
+        }
+        for(auto& t : threads)
+        {
+            t.join();
+        }
+
+        // rewritten tiles keep the last version
+        REQUIRE(write_payload(sink, 2, 1, 1, "replaced"));
+        REQUIRE(sink.finish());
+    }
+
+    TileArchive archive;
+    REQUIRE(archive.open(archive_path.string()));
+    CHECK(archive.tile_count() == 1 + 4 + 16 + 64);
+
+    for(int zoom = 0; zoom < 4; zoom++)
+    {
+        for(int tx = 0; tx < (1 << zoom); tx++)
+        {
+            for(int ty = 0; ty < (1 << zoom); ty++)
+            {
+                const unsigned char* data = nullptr;
+                size_t size = 0;
+                REQUIRE(archive.find_tile(zoom, tx, ty, data, size));
+                const std::string expected =
+                    zoom == 2 && tx == 1 && ty == 1 ? "replaced" : tile_payload(zoom, tx, ty);
+                CHECK(std::string(reinterpret_cast<const char*>(data), size) == expected);
+            }
+        }
+    }
+
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    CHECK(!archive.find_tile(4, 0, 0, data, size));
+    CHECK(!archive.find_tile(1, 2, 0, data, size));
+
+    size_t visited = 0;
+    int last_zoom = 0;
+    archive.for_each_tile([&](int zoom, int tx, int ty, const unsigned char* d, size_t s) {
+        CHECK(zoom >= last_zoom);
+        last_zoom = zoom;
+        visited++;
+    });
+    CHECK(visited == archive.tile_count());
+}
+
+TEST_CASE("tile archive rejects incomplete files", "[tntn]")
+{
+    auto archive_path =
+        boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    BOOST_SCOPE_EXIT(&archive_path) { boost::filesystem::remove(archive_path); }
+    BOOST_SCOPE_EXIT_END
+
+    ArchiveTileSink sink;
+    REQUIRE(sink.open(archive_path.string()));
+    REQUIRE(write_payload(sink, 0, 0, 0, "tile"));
+
+    // the index is only written by finish()
+    TileArchive archive;
+    CHECK(!archive.open(archive_path.string()));
+
+    REQUIRE(sink.finish());
+    CHECK(archive.open(archive_path.string()));
+    CHECK(archive.tile_count() == 1);
+}
+
+TEST_CASE("tile archive of an aborted sink is rejected", "[tntn]")
+{
+    auto archive_path =
+        boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    BOOST_SCOPE_EXIT(&archive_path) { boost::filesystem::remove(archive_path); }
+    BOOST_SCOPE_EXIT_END
+
+    {
+        // small batches, so tiles reach the file before the sink is destroyed
+        ArchiveTileSink sink(1);
+        REQUIRE(sink.open(archive_path.string()));
+        REQUIRE(write_payload(sink, 0, 0, 0, "tile"));
+        REQUIRE(write_payload(sink, 1, 0, 0, "tile"));
+    }
+
+    REQUIRE(boost::filesystem::file_size(archive_path) > 0);
+    TileArchive archive;
+    CHECK(!archive.open(archive_path.string()));
+}
+
+// overwrites bytes of a file in place
+static void patch_file(const boost::filesystem::path& path,
+                       const size_t offset,
+                       const unsigned char* data,
+                       const size_t size)
+{
+    std::fstream f(path.string(), std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(offset);
+    f.write(reinterpret_cast<const char*>(data), size);
+}
+
+TEST_CASE("tile archive rejects corrupt footers and index entries", "[tntn]")
+{
+    auto archive_path =
+        boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    BOOST_SCOPE_EXIT(&archive_path) { boost::filesystem::remove(archive_path); }
+    BOOST_SCOPE_EXIT_END
+
+    auto write_archive = [&]() {
+        ArchiveTileSink sink;
+        REQUIRE(sink.open(archive_path.string()));
+        REQUIRE(write_payload(sink, 0, 0, 0, "tile"));
+        REQUIRE(sink.finish());
+    };
+
+    // header, "tile", one index entry of 24 bytes, footer of 24 bytes
+    const size_t index_offset = 12 + 4;
+    const size_t footer_offset = index_offset + 24;
+    unsigned char value[8];
+
+    write_archive();
+    REQUIRE(boost::filesystem::file_size(archive_path) == footer_offset + 24);
+    {
+        TileArchive valid;
+        REQUIRE(valid.open(archive_path.string()));
+    }
+
+    TileArchive archive;
+
+    SECTION("tile count that wraps the index size around")
+    {
+        // 1 + 2^61 entries of 24 bytes wrap around to the size of a single entry
+        store_little_endian((uint64_t(1) << 61) + 1, value);
+        patch_file(archive_path, footer_offset + 8, value, 8);
+        CHECK(!archive.open(archive_path.string()));
+    }
+
+    SECTION("index offset past the end of the file")
+    {
+        store_little_endian(uint64_t(-8), value);
+        patch_file(archive_path, footer_offset, value, 8);
+        CHECK(!archive.open(archive_path.string()));
+    }
+
+    SECTION("tile offset that wraps around with the tile size")
+    {
+        store_little_endian(~uint64_t(0), value);
+        patch_file(archive_path, index_offset + 12, value, 8);
+        CHECK(!archive.open(archive_path.string()));
+    }
+
+    SECTION("truncated footer")
+    {
+        boost::filesystem::resize_file(archive_path, footer_offset + 20);
+        CHECK(!archive.open(archive_path.string()));
+    }
+}
+
+TEST_CASE("directory tile sink writes one file per tile", "[tntn]")
+{
+    auto basedir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    BOOST_SCOPE_EXIT(&basedir) { boost::filesystem::remove_all(basedir); }
+    BOOST_SCOPE_EXIT_END
+
+    DirectoryTileSink sink(basedir.string(), "terrain");
+    REQUIRE(write_payload(sink, 3, 2, 5, "tile"));
+    REQUIRE(sink.finish());
+
+    const auto tile_path = basedir / "3" / "2" / "5.terrain";
+    REQUIRE(boost::filesystem::exists(tile_path));
+    CHECK(boost::filesystem::file_size(tile_path) == 4);
+}
+
+namespace {
+
+// slow in-memory sink, remembers every tile
+class RecordingTileSink : public TileSink
+{
+  public:
+    std::mutex mutex;
+    std::map<std::tuple<int, int, int>, std::string> tiles;
+    std::atomic<int> fail_after{-1};
+    bool finished = false;
+
+    bool write_tile(int zoom, int tx, int ty, const unsigned char* data, size_t size) override
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        std::lock_guard<std::mutex> lock(mutex);
+        if(fail_after == 0)
+        {
+            return false;
+        }
+        fail_after--;
+        tiles[std::make_tuple(zoom, tx, ty)] = std::string(data, data + size);
+        return true;
+    }
+
+    bool finish() override
+    {
+        finished = true;
+        return true;
+    }
+};
+
+} // namespace
+
+TEST_CASE("async tile sink hands all tiles to its target", "[tntn]")
+{
+    auto target = std::make_unique<RecordingTileSink>();
+    RecordingTileSink& recorded = *target;
+
+    // a tiny queue forces the producers to wait for the writers
+    AsyncTileSink sink(std::move(target), 2, 64);
+
+    std::atomic<int> rejected(0);
+    std::vector<std::thread> threads;
+    for(int zoom = 0; zoom < 4; zoom++)
+    {
+        threads.emplace_back([&sink, &rejected, zoom]() {
+            for(int tx = 0; tx < (1 << zoom); tx++)
+            {
+                for(int ty = 0; ty < (1 << zoom); ty++)
+                {
+                    if(!write_payload(sink, zoom, tx, ty, tile_payload(zoom, tx, ty)))
+                    {
+                        rejected++;
+                    }
+                }
+            }
+        });
+    }
+    for(auto& t : threads)
+    {
+        t.join();
+    }
+
+    CHECK(rejected == 0);
+    REQUIRE(sink.finish());
+    CHECK(recorded.finished);
+
+    REQUIRE(recorded.tiles.size() == 1 + 4 + 16 + 64);
+    for(const auto& tile : recorded.tiles)
+    {
+        const int zoom = std::get<0>(tile.first);
+        const int tx = std::get<1>(tile.first);
+        const int ty = std::get<2>(tile.first);
+        CHECK(tile.second == tile_payload(zoom, tx, ty));
+    }
+}
+
+TEST_CASE("async tile sink reports failed writes", "[tntn]")
+{
+    auto target = std::make_unique<RecordingTileSink>();
+    target->fail_after = 3;
+
+    AsyncTileSink sink(std::move(target));
+
+    bool accepted_all = true;
+    for(int tx = 0; tx < 100 && accepted_all; tx++)
+    {
+        accepted_all = write_payload(sink, 10, tx, 0, tile_payload(10, tx, 0));
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+
+    CHECK(!accepted_all);
+    CHECK(!sink.finish());
+}
+
+TEST_CASE("async tile sink destroyed without finish leaves its target unfinished", "[tntn]")
+{
+    auto archive_path =
+        boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    BOOST_SCOPE_EXIT(&archive_path) { boost::filesystem::remove(archive_path); }
+    BOOST_SCOPE_EXIT_END
+
+    {
+        auto archive = std::make_unique<ArchiveTileSink>(1);
+        REQUIRE(archive->open(archive_path.string()));
+        AsyncTileSink sink(std::move(archive), 2);
+        for(int tx = 0; tx < 10; tx++)
+        {
+            REQUIRE(write_payload(sink, 4, tx, 0, tile_payload(4, tx, 0)));
+        }
+    }
+
+    TileArchive archive;
+    CHECK(!archive.open(archive_path.string()));
+}
+
+} // namespace unittests
+} // namespace tntn
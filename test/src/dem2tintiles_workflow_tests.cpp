@@ -0,0 +1,165 @@
+#include "catch.hpp"
+
+#include "tntn/dem2tintiles_workflow.h"
+#include "tntn/MeshWriter.h"
+#include "tntn/Raster.h"
+#include "tntn/RasterSource.h"
+#include "tntn/TileStore.h"
+
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace tntn {
+namespace unittests {
+
+typedef std::tuple<int, int, int> TileKey;
+
+// keeps the tiles written from any thread in memory,
+// fails or throws on the tile fail_tile if it is set
+class MemoryTileSink : public TileSink
+{
+  public:
+    enum class Failure
+    {
+        none,
+        error,
+        exception
+    };
+
+    MemoryTileSink(Failure failure = Failure::none, TileKey fail_tile = TileKey())
+        : m_failure(failure), m_fail_tile(fail_tile)
+    {
+    }
+
+    bool write_tile(int zoom, int tx, int ty, const unsigned char* data, size_t size) override
+    {
+        const TileKey key(zoom, tx, ty);
+        if(m_failure != Failure::none && key == m_fail_tile)
+        {
+            if(m_failure == Failure::exception)
+            {
+                throw std::runtime_error("tile sink failure");
+            }
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_writes++;
+        m_tiles[key].assign(data, data + size);
+        return true;
+    }
+
+    bool finish() override { return true; }
+
+    const std::map<TileKey, std::vector<unsigned char>>& tiles() const { return m_tiles; }
+    int writes() const { return m_writes; }
+
+  private:
+    Failure m_failure;
+    TileKey m_fail_tile;
+    std::mutex m_mutex;
+    std::map<TileKey, std::vector<unsigned char>> m_tiles;
+    int m_writes = 0;
+};
+
+// 10km x 8km of smooth terrain, a few partitions of one tile each at zoom 13
+static std::shared_ptr<RasterDouble> make_workflow_test_raster()
+{
+    const int w = 1000;
+    const int h = 800;
+    auto raster = std::make_shared<RasterDouble>(w, h);
+    raster->set_pos_x(1000.5);
+    raster->set_pos_y(-2000.25);
+    raster->set_cell_size(10);
+    raster->set_no_data_value(-9999);
+    for(int r = 0; r < h; r++)
+    {
+        for(int c = 0; c < w; c++)
+        {
+            raster->value(r, c) = 200 + 150 * std::sin(c * 0.013) * std::cos(r * 0.021);
+        }
+    }
+    return raster;
+}
+
+TEST_CASE("tiles of a zoom level are the same on one and on several threads", "[tntn]")
+{
+    const int zoom = 13;
+    MemoryRasterSource source(make_workflow_test_raster());
+    const auto partitions = create_partitions_for_zoom_level(source, zoom);
+    REQUIRE(partitions.size() > 4);
+
+    // every tile of every partition, partitions cover disjoint tile ranges
+    std::set<TileKey> expected_tiles;
+    for(const auto& part : partitions)
+    {
+        for(int tx = part.tmin.x; tx <= part.tmax.x; tx++)
+        {
+            for(int ty = part.tmin.y; ty <= part.tmax.y; ty++)
+            {
+                CHECK(expected_tiles.insert(TileKey(zoom, tx, ty)).second);
+            }
+        }
+    }
+
+    std::unique_ptr<MeshWriter> mesh_writer(new QuantizedMeshWriter());
+
+    MemoryTileSink single;
+    REQUIRE(create_tiles_for_zoom_level(
+        source, partitions, zoom, single, 8, "dense", *mesh_writer, 1));
+
+    std::set<TileKey> written_tiles;
+    for(const auto& tile : single.tiles())
+    {
+        written_tiles.insert(tile.first);
+        CHECK(!tile.second.empty());
+    }
+    CHECK(written_tiles == expected_tiles);
+    CHECK(single.writes() == static_cast<int>(expected_tiles.size()));
+
+    for(const int num_threads : {2, 3, 16})
+    {
+        MemoryTileSink threaded;
+        REQUIRE(create_tiles_for_zoom_level(
+            source, partitions, zoom, threaded, 8, "dense", *mesh_writer, num_threads));
+        CHECK(threaded.writes() == single.writes());
+        CHECK(threaded.tiles() == single.tiles());
+    }
+}
+
+TEST_CASE("a failing partition fails the threaded zoom level", "[tntn]")
+{
+    const int zoom = 13;
+    MemoryRasterSource source(make_workflow_test_raster());
+    const auto partitions = create_partitions_for_zoom_level(source, zoom);
+    REQUIRE(partitions.size() > 4);
+
+    std::unique_ptr<MeshWriter> mesh_writer(new QuantizedMeshWriter());
+
+    // a tile of a partition in the middle, so that other workers are still busy
+    const Partition& failing = partitions[partitions.size() / 2];
+    const TileKey fail_tile(zoom, failing.tmin.x, failing.tmin.y);
+
+    for(const int num_threads : {1, 4})
+    {
+        MemoryTileSink sink(MemoryTileSink::Failure::error, fail_tile);
+        CHECK_FALSE(create_tiles_for_zoom_level(
+            source, partitions, zoom, sink, 8, "dense", *mesh_writer, num_threads));
+        CHECK(sink.tiles().count(fail_tile) == 0);
+    }
+
+    // worker threads turn exceptions into a failure instead of terminating
+    MemoryTileSink sink(MemoryTileSink::Failure::exception, fail_tile);
+    CHECK_FALSE(
+        create_tiles_for_zoom_level(source, partitions, zoom, sink, 8, "dense", *mesh_writer, 4));
+    CHECK(sink.tiles().count(fail_tile) == 0);
+}
+
+} // namespace unittests
+} // namespace tntn
@@ -3,6 +3,10 @@
 #include "tntn/raster_tools.h"
 #include "tntn/Raster.h"
 
+#include <cmath>
+#include <limits>
+#include <random>
+
 namespace tntn {
 namespace unittests {
 
@@ -28,5 +32,142 @@ TEST_CASE("sample_nearest_valid_avg works", "[tntn]")
     CHECK(avg_sample == (3 + 6 + 12 + 24) / 4.0);
 }
 
+static RasterDouble make_filter_test_raster(int w, int h)
+{
+    RasterDouble raster(w, h);
+    raster.set_no_data_value(-9999);
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> height(-50, 400);
+    std::uniform_int_distribution<int> hole(0, 199);
+    for(int r = 0; r < h; r++)
+    {
+        for(int c = 0; c < w; c++)
+        {
+            const int kind = hole(rng);
+            raster.value(r, c) = kind < 5 ? -9999 : kind == 5 ? NAN : height(rng);
+        }
+    }
+    return raster;
+}
+
+// the naive 2D window loop of max_filter
+static RasterDouble reference_max_filter(const RasterDouble& src,
+                                         int size,
+                                         double pos,
+                                         double factor)
+{
+    const int w = src.get_width();
+    const int h = src.get_height();
+    const int s2 = size / 2;
+
+    RasterDouble dst(w, h);
+    dst.set_all(dst.get_no_data_value());
+    for(int r = s2; r < h - s2; r++)
+    {
+        for(int c = s2; c < w - s2; c++)
+        {
+            double max = -std::numeric_limits<double>::max();
+            for(int i = 0; i < size; i++)
+            {
+                for(int j = 0; j < size; j++)
+                {
+                    if(src.value(r + i - s2, c + j - s2) > max)
+                    {
+                        max = src.value(r + i - s2, c + j - s2);
+                    }
+                }
+            }
+            if(src.value(r, c) >= max * factor)
+            {
+                dst.value(r, c) = pos;
+            }
+        }
+    }
+    return dst;
+}
+
+static bool same_value(const double a, const double b, const double eps = 0)
+{
+    return (std::isnan(a) && std::isnan(b)) || std::abs(a - b) <= eps;
+}
+
+TEST_CASE("max_filter matches the naive window maximum", "[tntn]")
+{
+    const RasterDouble src = make_filter_test_raster(83, 61);
+    const int w = static_cast<int>(src.get_width());
+    const int h = static_cast<int>(src.get_height());
+
+    for(int size : {1, 3, 5, 9})
+    {
+        for(double factor : {0.9, 1.0})
+        {
+            const RasterDouble expected = reference_max_filter(src, size, 1.0, factor);
+            for(int threads : {1, 3})
+            {
+                const RasterDouble actual =
+                    raster_tools::max_filter(src, size, 1.0, factor, threads);
+                REQUIRE(actual.get_width() == expected.get_width());
+                REQUIRE(actual.get_height() == expected.get_height());
+                for(int r = 0; r < h; r++)
+                {
+                    for(int c = 0; c < w; c++)
+                    {
+                        REQUIRE(actual.value(r, c) == expected.value(r, c));
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("separable convolution_filter matches the 2D kernel", "[tntn]")
+{
+    RasterDouble base = make_filter_test_raster(70, 52);
+    // filters accept views, the result must not depend on the stride
+    const RasterDouble src = base.view(3, 2, 60, 45);
+    const int w = static_cast<int>(src.get_width());
+    const int h = static_cast<int>(src.get_height());
+
+    const std::vector<double> row_kernel = {0.1, 0.2, 0.4, 0.2, 0.1};
+    const std::vector<double> column_kernel = {0.05, 0.25, 0.4, 0.25, 0.05};
+
+    std::vector<double> kernel;
+    for(double k_row : column_kernel)
+    {
+        for(double k_column : row_kernel)
+        {
+            kernel.push_back(k_row * k_column);
+        }
+    }
+
+    for(int threads : {1, 4})
+    {
+        const RasterDouble full = raster_tools::convolution_filter(src, kernel, 5, threads);
+        const RasterDouble separable =
+            raster_tools::convolution_filter(src, row_kernel, column_kernel, threads);
+
+        REQUIRE(separable.get_width() == src.get_width());
+        REQUIRE(separable.get_height() == src.get_height());
+        CHECK(separable.get_no_data_value() == src.get_no_data_value());
+        for(int r = 0; r < h; r++)
+        {
+            for(int c = 0; c < w; c++)
+            {
+                const bool border = c < 2 || c >= w - 2 || r < 2 || r >= h - 2;
+                if(border)
+                {
+                    REQUIRE(separable.value(r, c) == src.get_no_data_value());
+                }
+                else
+                {
+                    // sums are added up in a different order
+                    REQUIRE(same_value(separable.value(r, c), full.value(r, c), 1e-9));
+                }
+            }
+        }
+    }
+}
+
 } // namespace unittests
 } // namespace tntn
@@ -2,13 +2,19 @@
 
 #include <algorithm>
 #include <cmath>
+#include <functional>
 #include <random>
 
 #include "tntn/TerraMesh.h"
+#include "tntn/DelaunayMesh.h"
+#include "tntn/TerraUtils.h"
 #include "tntn/geometrix.h"
 #include "tntn/SurfacePoints.h"
 #include "tntn/terra_meshing.h"
+#include "tntn/zemlya_meshing.h"
 #include "tntn/MeshIO.h"
+#include "tntn/raster_tools.h"
+#include "tntn/dem2tintiles_workflow.h"
 
 namespace tntn {
 namespace unittests {
@@ -23,6 +29,316 @@ TEST_CASE("terra ccw works", "[tntn]")
     CHECK(!terra::ccw(a, c, b));
 }
 
+template<typename Store>
+static void check_quad_edge_store()
+{
+    const terra::Point2D a(0, 0);
+    const terra::Point2D b(1, 0);
+    const terra::Point2D c(1, 1);
+
+    Store edges;
+    const terra::qe_ptr e = edges.make_edge();
+    const terra::qe_ptr f = edges.make_edge();
+    CHECK(e != f);
+
+    CHECK(edges.Sym(edges.Sym(e)) == e);
+    CHECK(edges.Rot(edges.Rot(e)) == edges.Sym(e));
+    CHECK(edges.Rot(edges.invRot(e)) == e);
+    CHECK(edges.invRot(edges.Rot(e)) == e);
+
+    // a new edge only touches itself
+    CHECK(edges.Onext(e) == e);
+    CHECK(edges.Lnext(e) == edges.Sym(e));
+    CHECK(!edges.Lface(e));
+
+    const typename Store::vertex_ref va = edges.add_vertex(a);
+    const typename Store::vertex_ref vb = edges.add_vertex(b);
+    const typename Store::vertex_ref vc = edges.add_vertex(c);
+    edges.set_end_points(e, va, vb);
+    edges.set_end_points(f, vb, vc);
+    CHECK(edges.Org(e) == a);
+    CHECK(edges.Dest(e) == b);
+    CHECK(edges.Org(edges.Sym(e)) == b);
+    CHECK(edges.dest_vertex(e) == edges.org_vertex(f));
+
+    // join e and f at b
+    edges.splice(edges.Sym(e), f);
+    CHECK(edges.Onext(f) == edges.Sym(e));
+    CHECK(edges.Onext(edges.Sym(e)) == f);
+    CHECK(edges.Lnext(e) == f);
+    CHECK(edges.Lprev(f) == e);
+
+    // splice is its own inverse
+    edges.splice(edges.Sym(e), f);
+    CHECK(edges.Onext(f) == f);
+    CHECK(edges.Onext(edges.Sym(e)) == edges.Sym(e));
+
+    edges.recycle_edge(f);
+    CHECK(!edges.is_live(f));
+    CHECK(edges.is_live(e));
+    CHECK(edges.stats().live == 1);
+    CHECK(edges.make_edge() == f);
+}
+
+TEST_CASE("terra quad-edge stores rotate and splice edges", "[tntn]")
+{
+    check_quad_edge_store<terra::QuadEdgePool>();
+    check_quad_edge_store<terra::QuadEdgeArrays>();
+}
+
+TEST_CASE("terra CandidateList keeps one entry per triangle", "[tntn]")
+{
+    std::vector<terra::dt_ptr> triangles;
+    for(uint32_t i = 0; i < 50; i++)
+    {
+        triangles.push_back(terra::dt_ptr(i));
+    }
+
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> dist(0, 100);
+
+    terra::CandidateList candidates;
+    std::vector<double> latest(triangles.size(), 0);
+    for(int round = 0; round < 5; round++)
+    {
+        for(size_t i = 0; i < triangles.size(); i++)
+        {
+            terra::Candidate c;
+            c.importance = dist(gen);
+            c.token = static_cast<int>(i);
+            c.triangle = triangles[i];
+            latest[i] = c.importance;
+            candidates.push_back(c);
+        }
+    }
+
+    CHECK(candidates.size() == triangles.size());
+    CHECK(candidates.stats().replaced == 4 * triangles.size());
+    CHECK(candidates.stats().peak_size == triangles.size());
+
+    std::vector<double> expected = latest;
+    std::sort(expected.begin(), expected.end(), std::greater<double>());
+
+    for(const double importance : expected)
+    {
+        const terra::Candidate c = candidates.grab_greatest();
+        CHECK(c.importance == importance);
+        CHECK(latest[c.token] == importance);
+    }
+    CHECK(candidates.empty());
+}
+
+TEST_CASE("terra CandidateList removes entries of single triangles", "[tntn]")
+{
+    std::vector<terra::dt_ptr> triangles;
+    for(uint32_t i = 0; i < 20; i++)
+    {
+        triangles.push_back(terra::dt_ptr(i));
+    }
+
+    terra::CandidateList candidates;
+    for(size_t i = 0; i < triangles.size(); i++)
+    {
+        terra::Candidate c;
+        c.importance = static_cast<double>((i * 7) % 20);
+        c.token = static_cast<int>(i);
+        c.triangle = triangles[i];
+        candidates.push_back(c);
+    }
+
+    for(size_t i = 0; i < triangles.size(); i += 3)
+    {
+        candidates.remove(triangles[i]);
+    }
+    // removing twice is harmless
+    candidates.remove(triangles[0]);
+
+    std::vector<double> expected;
+    for(size_t i = 0; i < triangles.size(); i++)
+    {
+        if(i % 3 != 0)
+        {
+            expected.push_back(static_cast<double>((i * 7) % 20));
+        }
+    }
+    std::sort(expected.begin(), expected.end(), std::greater<double>());
+
+    REQUIRE(candidates.size() == expected.size());
+    for(const double importance : expected)
+    {
+        const terra::Candidate c = candidates.grab_greatest();
+        CHECK(c.importance == importance);
+        CHECK(c.token % 3 != 0);
+    }
+    CHECK(candidates.empty());
+}
+
+TEST_CASE("terra MinMaxPyramid never claims a deviation below the threshold wrongly", "[tntn]")
+{
+    const int w = 70;
+    const int h = 37;
+    const double no_data_value = -9999;
+
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<double> noise(-0.25, 0.25);
+    std::uniform_int_distribution<int> flag(0, 49);
+
+    Raster<double> raster(w, h);
+    raster.set_no_data_value(no_data_value);
+    for(int y = 0; y < h; y++)
+    {
+        for(int x = 0; x < w; x++)
+        {
+            raster.value(y, x) = 0.01 * x - 0.02 * y + noise(gen);
+            if(flag(gen) == 0)
+            {
+                raster.value(y, x) = no_data_value;
+            }
+        }
+    }
+
+    terra::MinMaxPyramid bounds;
+    bounds.build(raster, no_data_value);
+
+    terra::Plane plane;
+    plane.a = 0.01;
+    plane.b = -0.02;
+    plane.c = 0;
+
+    // the whole raster is within 0.25 of the plane, blocks prove it once they are small enough
+    CHECK(bounds.deviation_below(plane, 0, 0, w - 1, h - 1, 0.6));
+    CHECK(!bounds.deviation_below(plane, 0, 0, w - 1, h - 1, 0.1));
+
+    std::uniform_int_distribution<int> px(0, w - 1);
+    std::uniform_int_distribution<int> py(0, h - 1);
+    std::uniform_real_distribution<double> threshold(0.2, 2.0);
+    int proven = 0;
+    for(int run = 0; run < 500; run++)
+    {
+        int x0 = px(gen);
+        int x1 = px(gen);
+        int y0 = py(gen);
+        int y1 = py(gen);
+        if(x0 > x1) std::swap(x0, x1);
+        if(y0 > y1) std::swap(y0, y1);
+        plane.c = noise(gen);
+        const double t = threshold(gen);
+
+        double max_deviation = 0;
+        for(int y = y0; y <= y1; y++)
+        {
+            for(int x = x0; x <= x1; x++)
+            {
+                const double z = raster.value(y, x);
+                if(z != no_data_value)
+                {
+                    max_deviation = std::max(max_deviation, std::fabs(z - plane.eval(x, y)));
+                }
+            }
+        }
+
+        if(bounds.deviation_below(plane, x0, y0, x1, y1, t))
+        {
+            REQUIRE(max_deviation < t);
+            proven++;
+        }
+    }
+    CHECK(proven > 0);
+
+    // blocks without data don't constrain anything
+    Raster<double> empty(w, h);
+    empty.set_all(no_data_value);
+    bounds.build(empty, no_data_value);
+    CHECK(bounds.deviation_below(plane, 0, 0, w - 1, h - 1, 0.0001));
+}
+
+TEST_CASE("terra DelaunayMesh exports shared corners once", "[tntn]")
+{
+    terra::DelaunayMesh dm;
+    dm.init_mesh(BBox2D(glm::dvec2(0, 0), glm::dvec2(4, 3)));
+
+    std::vector<glm::ivec2> points;
+    std::vector<Face> faces;
+    dm.export_indexed(points, faces);
+
+    // row-major order
+    REQUIRE(points.size() == 4);
+    CHECK(points[0] == glm::ivec2(0, 0));
+    CHECK(points[1] == glm::ivec2(4, 0));
+    CHECK(points[2] == glm::ivec2(0, 3));
+    CHECK(points[3] == glm::ivec2(4, 3));
+
+    REQUIRE(faces.size() == 2);
+    for(const Face& f : faces)
+    {
+        REQUIRE(f[0] < points.size());
+        REQUIRE(f[1] < points.size());
+        REQUIRE(f[2] < points.size());
+        CHECK(f[0] != f[1]);
+        CHECK(f[1] != f[2]);
+        CHECK(f[0] != f[2]);
+        CHECK(!terra::ccw(points[f[0]], points[f[1]], points[f[2]]));
+    }
+}
+
+TEST_CASE("terra DelaunayMesh hint grid doesn't change the triangulation", "[tntn]")
+{
+    std::vector<glm::dvec2> inserted;
+    for(int y = 0; y <= 150; y++)
+    {
+        for(int x = 0; x <= 200; x++)
+        {
+            // the corners are already in the mesh
+            if((x == 0 || x == 200) && (y == 0 || y == 150))
+            {
+                continue;
+            }
+            inserted.emplace_back(x, y);
+        }
+    }
+    std::mt19937 gen(3);
+    std::shuffle(inserted.begin(), inserted.end(), gen);
+    inserted.resize(3000);
+
+    terra::DelaunayMesh plain;
+    terra::DelaunayMesh hinted;
+    for(terra::DelaunayMesh* dm : {&plain, &hinted})
+    {
+        dm->init_mesh(
+            glm::dvec2(0, 0), glm::dvec2(0, 150), glm::dvec2(200, 150), glm::dvec2(200, 0));
+    }
+    hinted.enable_hint_grid(8.0);
+
+    for(const glm::dvec2& p : inserted)
+    {
+        plain.insert(p, terra::dt_ptr());
+        hinted.insert(p, terra::dt_ptr());
+    }
+
+    std::vector<glm::ivec2> plain_points;
+    std::vector<Face> plain_faces;
+    plain.export_indexed(plain_points, plain_faces);
+    std::vector<glm::ivec2> hinted_points;
+    std::vector<Face> hinted_faces;
+    hinted.export_indexed(hinted_points, hinted_faces);
+
+    for(std::vector<Face>* faces : {&plain_faces, &hinted_faces})
+    {
+        for(Face& f : *faces)
+        {
+            while(f[0] > f[1] || f[0] > f[2])
+            {
+                f = {{f[1], f[2], f[0]}};
+            }
+        }
+        std::sort(faces->begin(), faces->end());
+    }
+
+    CHECK(plain_points.size() == inserted.size() + 4);
+    CHECK(hinted_points == plain_points);
+    CHECK(hinted_faces == plain_faces);
+}
+
 TEST_CASE("terra meshing on artificial terrain", "[tntn]")
 {
     auto terrain_fn = [](int x, int y) -> double { return sin(x) * sin(y); };
@@ -215,5 +531,239 @@ TEST_CASE("terra meshing on 2x2 raster with missing point", "[tntn]")
     //write_mesh_as_obj("terrain.obj", *mesh);
 }
 
+template<typename T>
+static std::unique_ptr<Raster<T>> make_integer_terrain(const int w, const int h)
+{
+    auto raster = std::make_unique<Raster<T>>(w, h);
+    raster->set_no_data_value(-9999);
+    raster->set_cell_size(5);
+    for(int y = 0; y < h; y++)
+    {
+        for(int x = 0; x < w; x++)
+        {
+            raster->value(y, x) = static_cast<T>(std::round(300 * sin(x * 0.05) * cos(y * 0.07)));
+        }
+    }
+    raster->value(h / 2, w / 3) = -9999;
+    return raster;
+}
+
+static void require_same_mesh(Mesh& a, Mesh& b)
+{
+    a.generate_decomposed();
+    b.generate_decomposed();
+    REQUIRE(a.vertices().distance() == b.vertices().distance());
+    REQUIRE(a.faces().distance() == b.faces().distance());
+    REQUIRE(std::equal(a.vertices().begin, a.vertices().end, b.vertices().begin));
+    REQUIRE(std::equal(a.faces().begin, a.faces().end, b.faces().begin));
+}
+
+TEST_CASE("terra and zemlya mesh float and int16 rasters like double rasters", "[tntn]")
+{
+    const int w = 60;
+    const int h = 45;
+
+    auto mesh_double = generate_tin_terra(make_integer_terrain<double>(w, h), 2.0);
+    auto mesh_float = generate_tin_terra(make_integer_terrain<float>(w, h), 2.0);
+    auto mesh_int16 = generate_tin_terra(make_integer_terrain<int16_t>(w, h), 2.0);
+    REQUIRE(mesh_double != nullptr);
+    CHECK(mesh_double->check_tin_properties());
+    require_same_mesh(*mesh_double, *mesh_float);
+    require_same_mesh(*mesh_double, *mesh_int16);
+
+    auto zemlya_double = generate_tin_zemlya(make_integer_terrain<double>(w, h), 2.0);
+    auto zemlya_int16 = generate_tin_zemlya(make_integer_terrain<int16_t>(w, h), 2.0);
+    REQUIRE(zemlya_double != nullptr);
+    require_same_mesh(*zemlya_double, *zemlya_int16);
+}
+
+template<typename T>
+static std::unique_ptr<Raster<T>> make_terrain_with_corner_hole(const int w, const int h)
+{
+    auto raster = make_integer_terrain<T>(w, h);
+    raster->value(0, 0) = -9999;
+    raster->value(0, 1) = 1;
+    raster->value(1, 0) = 2;
+    raster->value(1, 1) = 2;
+    return raster;
+}
+
+TEST_CASE("terra and zemlya mesh int16 rasters like double rasters with fractional fills",
+          "[tntn]")
+{
+    const int w = 50;
+    const int h = 40;
+
+    // the filled corner gets a mean int16 can't hold
+    const auto probe = make_terrain_with_corner_hole<double>(w, h);
+    const double fill = raster_tools::sample_nearest_valid_avg(*probe, 0, 0);
+    REQUIRE(fill != std::round(fill));
+
+    auto mesh_double = generate_tin_terra(make_terrain_with_corner_hole<double>(w, h), 2.0);
+    auto mesh_float = generate_tin_terra(make_terrain_with_corner_hole<float>(w, h), 2.0);
+    auto mesh_int16 = generate_tin_terra(make_terrain_with_corner_hole<int16_t>(w, h), 2.0);
+    REQUIRE(mesh_double != nullptr);
+    require_same_mesh(*mesh_double, *mesh_float);
+    require_same_mesh(*mesh_double, *mesh_int16);
+
+    auto zemlya_double = generate_tin_zemlya(make_terrain_with_corner_hole<double>(w, h), 2.0);
+    auto zemlya_int16 = generate_tin_zemlya(make_terrain_with_corner_hole<int16_t>(w, h), 2.0);
+    REQUIRE(zemlya_double != nullptr);
+    require_same_mesh(*zemlya_double, *zemlya_int16);
+
+    auto meshes_double =
+        generate_tins_terra(make_terrain_with_corner_hole<double>(w, h), {8.0, 2.0});
+    auto meshes_int16 =
+        generate_tins_terra(make_terrain_with_corner_hole<int16_t>(w, h), {8.0, 2.0});
+    REQUIRE(meshes_double.size() == meshes_int16.size());
+    for(size_t i = 0; i < meshes_double.size(); i++)
+    {
+        require_same_mesh(*meshes_double[i], *meshes_int16[i]);
+    }
+}
+
+// faces rotated to start at their smallest index, in ascending order
+static std::vector<Face> sorted_faces(const Mesh& mesh)
+{
+    std::vector<Face> faces(mesh.faces().begin, mesh.faces().end);
+    for(Face& f : faces)
+    {
+        while(f[0] > f[1] || f[0] > f[2])
+        {
+            f = {{f[1], f[2], f[0]}};
+        }
+    }
+    std::sort(faces.begin(), faces.end());
+    return faces;
+}
+
+TEST_CASE("terra progressive run cut at several thresholds", "[tntn]")
+{
+    const int w = 80;
+    const int h = 64;
+
+    auto meshes = generate_tins_terra(make_integer_terrain<int16_t>(w, h), {16.0, 2.0, 6.0});
+    REQUIRE(meshes.size() == 3);
+    for(const auto& mesh : meshes)
+    {
+        REQUIRE(mesh != nullptr);
+        CHECK(mesh->check_tin_properties());
+    }
+
+    // the finest threshold is the full run
+    auto fine = generate_tin_terra(make_integer_terrain<int16_t>(w, h), 2.0);
+    require_same_mesh(*fine, *meshes[1]);
+
+    // coarser thresholds keep the points a run with that threshold inserts,
+    // the replayed triangulation may list the faces in another order
+    auto coarse = generate_tin_terra(make_integer_terrain<int16_t>(w, h), 16.0);
+    coarse->generate_decomposed();
+    meshes[0]->generate_decomposed();
+    REQUIRE(coarse->vertices().distance() == meshes[0]->vertices().distance());
+    CHECK(std::equal(
+        coarse->vertices().begin, coarse->vertices().end, meshes[0]->vertices().begin));
+    CHECK(sorted_faces(*coarse) == sorted_faces(*meshes[0]));
+
+    CHECK(meshes[0]->vertices().distance() < meshes[2]->vertices().distance());
+    CHECK(meshes[2]->vertices().distance() < meshes[1]->vertices().distance());
+}
+
+TEST_CASE("terra progressive run keeps fewer vertices at coarser zoom levels", "[tntn]")
+{
+    // a given max error is the threshold of the finest zoom level only
+    const auto max_errors = progressive_max_errors(10, 13, 1.0);
+    REQUIRE(max_errors == std::vector<double>({8.0, 4.0, 2.0, 1.0}));
+
+    auto meshes = generate_tins_terra(make_integer_terrain<int16_t>(80, 64), max_errors);
+    REQUIRE(meshes.size() == max_errors.size());
+    REQUIRE(meshes[0] != nullptr);
+    for(size_t i = 1; i < meshes.size(); i++)
+    {
+        REQUIRE(meshes[i] != nullptr);
+        CHECK(meshes[i - 1]->vertices().distance() < meshes[i]->vertices().distance());
+    }
+}
+
+template<typename T>
+static void check_scan_line_kernels(const terra::ScanLineKernel kernel)
+{
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> value(-50, 50);
+    std::uniform_int_distribution<int> flag(0, 9);
+
+    const int w = 73;
+    const double no_data_value = -9999;
+    std::vector<T> z(w);
+    std::vector<char> used(w);
+
+    terra::Plane plane;
+    plane.a = 0.5;
+    plane.b = -0.25;
+    plane.c = 3;
+
+    for(int run = 0; run < 200; run++)
+    {
+        for(int x = 0; x < w; x++)
+        {
+            // coarse values provoke ties between pixels
+            z[x] = static_cast<T>(value(gen) / 4 * 4);
+            used[x] = flag(gen) == 0;
+            if(flag(gen) == 0)
+            {
+                z[x] = static_cast<T>(no_data_value);
+            }
+        }
+        if(run % 2 == 0)
+        {
+            plane.a = 0;
+            plane.b = 0;
+        }
+        else
+        {
+            plane.a = 0.5;
+            plane.b = -0.25;
+        }
+
+        for(int startx = 0; startx < 12; startx++)
+        {
+            const int endx = w - 1 - run % 13;
+            const int y = run % 7;
+            const auto expected = terra::scan_line_maximum(z.data(),
+                                                           used.data(),
+                                                           startx,
+                                                           endx,
+                                                           y,
+                                                           plane,
+                                                           no_data_value,
+                                                           terra::ScanLineKernel::Scalar);
+            const auto actual = terra::scan_line_maximum(
+                z.data(), used.data(), startx, endx, y, plane, no_data_value, kernel);
+            REQUIRE(actual.x == expected.x);
+            REQUIRE(actual.deviation == expected.deviation);
+        }
+    }
+}
+
+TEST_CASE("terra scan line kernels pick the same pixel as the scalar scan", "[tntn]")
+{
+    std::vector<terra::ScanLineKernel> kernels = {terra::ScanLineKernel::Scalar};
+    const auto detected = terra::detect_scan_line_kernel();
+    if(detected != terra::ScanLineKernel::Scalar)
+    {
+        kernels.push_back(terra::ScanLineKernel::SSE41);
+    }
+    if(detected == terra::ScanLineKernel::AVX2)
+    {
+        kernels.push_back(terra::ScanLineKernel::AVX2);
+    }
+
+    for(const auto kernel : kernels)
+    {
+        check_scan_line_kernels<double>(kernel);
+        check_scan_line_kernels<float>(kernel);
+        check_scan_line_kernels<int16_t>(kernel);
+    }
+}
+
 } // namespace unittests
 } // namespace tntn